@@ -1,6 +1,8 @@
 #include <boost/mpi.hpp>
 #include "GromacsHook.h"
 #include "Snapshot.h"
+#include <algorithm>
+#include <numeric>
 
 using namespace boost;
 
@@ -58,63 +60,105 @@ namespace SSAGES
 		double potenergy,
 		double kb)
 	{
-		// Resize vectors.
-		auto& pos = snapshot_->GetPositions();
-		pos.resize(natoms);
-		auto& vel = snapshot_->GetVelocities();
-		vel.resize(natoms);
-		auto& frc = snapshot_->GetForces();
-		frc.resize(natoms);
-		auto& mass = snapshot_->GetMasses();
-		mass.resize(natoms);
-		auto& ids = snapshot_->GetAtomIDs();
-		ids.resize(natoms);
-		auto& typs = snapshot_->GetAtomTypes();
-		typs.resize(natoms);
+		// Gromacs internally indexes atoms starting from 0.
+		auto gmxid = [indices](int i) { 
+			return indices != nullptr ? indices[i] + 1 : i + 1; 
+		};
+
+		// Count the cached atoms which are still local. Atoms only 
+		// migrate on repartitioning, so the cache is usually complete.
+		int nvalid = 0;
+		if(!IsFullSync())
+		{
+			for(size_t i = 0; i < engineids_.size(); ++i)
+			{
+				auto k = engineidx_[i];
+				if(k < natoms && gmxid(k) == engineids_[i])
+					++nvalid;
+			}
+		}
 
 		// Reduce temperature/pressure/energy.
 		auto& comm = snapshot_->GetCommunicator();
 
 		// Atom weighted averages for temperature. Potential energy is extensive.
 		// NOTE: pressure is just wrong.
-		int ntot = 0;
+		int counts[2] = {natoms, nvalid};
 		temperature *= natoms;
-		MPI_Allreduce(&natoms, &ntot, 1, MPI_INT, MPI_SUM, comm);
+		MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_INT, MPI_SUM, comm);
 		MPI_Allreduce(MPI_IN_PLACE, &temperature, 1, MPI_DOUBLE, MPI_SUM, comm);
 		MPI_Allreduce(MPI_IN_PLACE, &potenergy, 1, MPI_DOUBLE, MPI_SUM, comm);
+		int ntot = counts[0];
 		temperature /= ntot;
 
+		// Select the local atoms to synchronize. Unless all atoms are 
+		// needed, the list is rebuilt only if a required atom moved.
+		const auto& syncids = GetSyncIDs();
+		if(IsFullSync())
+		{
+			engineidx_.resize(natoms);
+			engineids_.resize(natoms);
+			std::iota(engineidx_.begin(), engineidx_.end(), 0);
+			for(int i = 0; i < natoms; ++i)
+				engineids_[i] = gmxid(i);
+		}
+		else if(counts[1] != static_cast<int>(syncids.size()))
+		{
+			engineidx_.clear();
+			engineids_.clear();
+			for(int i = 0; i < natoms; ++i)
+			{
+				if(std::binary_search(syncids.begin(), syncids.end(), gmxid(i)))
+				{
+					engineidx_.push_back(i);
+					engineids_.push_back(gmxid(i));
+				}
+			}
+		}
+
+		int n = engineidx_.size();
+
+		// Resize vectors.
+		auto& pos = snapshot_->GetPositions();
+		pos.resize(n);
+		auto& vel = snapshot_->GetVelocities();
+		vel.resize(n);
+		auto& frc = snapshot_->GetForces();
+		frc.resize(n);
+		auto& mass = snapshot_->GetMasses();
+		mass.resize(n);
+		auto& ids = snapshot_->GetAtomIDs();
+		ids.resize(n);
+		auto& typs = snapshot_->GetAtomTypes();
+		typs.resize(n);
+
 		// Load em up.
 		snapshot_->SetIteration(iteration);
 		snapshot_->SetTemperature(temperature);
 		snapshot_->SetEnergy(potenergy);
 		snapshot_->SetKb(kb);
-		snapshot_->SetNumAtoms(natoms);
+		snapshot_->SetNumAtoms(n);
 
-		for(int i = 0; i < natoms; ++i)
+		for(int i = 0; i < n; ++i)
 		{
-			// Gromacs internally indexes atoms starting from 0.
-			if(indices != nullptr)
-				ids[i] = indices[i] + 1;
-			else
-				ids[i] = i + 1;
-			typs[i] = types[i];
-
-			mass[i] = masses[i];
-			mass[i] = masses[i];
-			mass[i] = masses[i];
-
-			pos[i][0] = positions[i][0];
-			pos[i][1] = positions[i][1];
-			pos[i][2] = positions[i][2];
-
-			vel[i][0] = velocities[i][0];
-			vel[i][1] = velocities[i][1];
-			vel[i][2] = velocities[i][2];
-
-			frc[i][0] = forces[i][0];
-			frc[i][1] = forces[i][1];
-			frc[i][2] = forces[i][2];			
+			auto k = engineidx_[i];
+
+			ids[i] = gmxid(k);
+			typs[i] = types[k];
+
+			mass[i] = masses[k];
+
+			pos[i][0] = positions[k][0];
+			pos[i][1] = positions[k][1];
+			pos[i][2] = positions[k][2];
+
+			vel[i][0] = velocities[k][0];
+			vel[i][1] = velocities[k][1];
+			vel[i][2] = velocities[k][2];
+
+			frc[i][0] = forces[k][0];
+			frc[i][1] = forces[k][1];
+			frc[i][2] = forces[k][2];			
 		}
 		
 		Matrix3 H;
@@ -123,11 +167,14 @@ namespace SSAGES
 		     boxmat[2][0], boxmat[2][1], boxmat[2][2];
 		snapshot_->SetHMatrix(H);
 		snapshot_->SetVirial(Matrix3::Zero());
+
+		// Refresh atom ID lookup.
+		snapshot_->UpdateIndexMap();
 	}
 
  	template<typename T>
 	void GromacsHook::PushToGromacs(
-		int natoms,
+		int,
 		int* indices, 
 		int* types,
 		T masses[],
@@ -144,30 +191,50 @@ namespace SSAGES
 		const auto& typs = snapshot_->GetAtomTypes();
 		const auto& vir = snapshot_->GetVirial();
 
-		for(int i = 0; i < natoms; ++i)
-		{
-			// Gromacs internally indexes atoms starting from 0.
-			if(indices != nullptr)
-				indices[i] = ids[i] - 1;
-			
-			types[i] = typs[i];
-
-			masses[i] = mass[i];
-			masses[i] = mass[i];
-			masses[i] = mass[i];
-
-			positions[i][0] = pos[i][0];
-			positions[i][1] = pos[i][1];
-			positions[i][2] = pos[i][2];
-
-			velocities[i][0] = vel[i][0];
-			velocities[i][1] = vel[i][1];
-			velocities[i][2] = vel[i][2];
-
-			forces[i][0] = frc[i][0];
-			forces[i][1] = frc[i][1];
-			forces[i][2] = frc[i][2];
-		}
+		// Only the atoms pulled in PullToSSAGES are pushed back, and only 
+		// the fields which were modified.
+		// The atom list is that of the preceding pull within the same step.
+		auto nsync = engineidx_.size();
+
+		// Gromacs internally indexes atoms starting from 0.
+		if(indices != nullptr && snapshot_->HasChanged(Snapshot::AtomIDs))
+			for(size_t i = 0; i < nsync; ++i)
+				indices[engineidx_[i]] = ids[i] - 1;
+		
+		if(snapshot_->HasChanged(Snapshot::AtomTypes))
+			for(size_t i = 0; i < nsync; ++i)
+				types[engineidx_[i]] = typs[i];
+
+		if(snapshot_->HasChanged(Snapshot::Masses))
+			for(size_t i = 0; i < nsync; ++i)
+				masses[engineidx_[i]] = mass[i];
+
+		if(snapshot_->HasChanged(Snapshot::Positions))
+			for(size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				positions[k][0] = pos[i][0];
+				positions[k][1] = pos[i][1];
+				positions[k][2] = pos[i][2];
+			}
+
+		if(snapshot_->HasChanged(Snapshot::Velocities))
+			for(size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				velocities[k][0] = vel[i][0];
+				velocities[k][1] = vel[i][1];
+				velocities[k][2] = vel[i][2];
+			}
+
+		if(snapshot_->HasChanged(Snapshot::Forces))
+			for(size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				forces[k][0] = frc[i][0];
+				forces[k][1] = frc[i][1];
+				forces[k][2] = frc[i][2];
+			}
 
 		virial[0][0] += vir(0,0);
 		virial[0][1] += vir(0,1);
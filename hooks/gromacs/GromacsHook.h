@@ -4,6 +4,7 @@
 
 #include "Hook.h"
 #include <functional>
+#include <vector>
 
 namespace SSAGES
 {
@@ -14,7 +15,11 @@ namespace SSAGES
 
 		int niterations_;
 
-		GromacsHook() : gmxpush_(), gmxpull_(), niterations_(0)
+		// Local Gromacs indices and IDs of the atoms in the snapshot.
+		std::vector<int> engineidx_, engineids_;
+
+		GromacsHook() : gmxpush_(), gmxpull_(), niterations_(0), 
+		engineidx_(), engineids_()
 		{} 
 
 	protected: 
@@ -23,7 +23,7 @@ using namespace boost;
 namespace LAMMPS_NS
 {
 	FixSSAGES::FixSSAGES(LAMMPS *lmp, int narg, char **arg) : 
-	Fix(lmp, narg, arg), Hook()
+	Fix(lmp, narg, arg), Hook(), thermo_(EventListener::AllThermo)
 	{
 		const char* idtemp = "thermo_temp";
 		int itemp = modify->find_compute(idtemp);
@@ -64,20 +64,47 @@ namespace LAMMPS_NS
 		auto& flags = snapshot_->GetImageFlags();
 		flags.resize(n);
 
+		thermo_ = EventListener::AllThermo;
 		SyncToSnapshot();
 		Hook::PreSimulationHook();
 	}
 
 	void FixSSAGES::post_force(int)
 	{
+		// Skip synchronization if nothing happens at this step. The 
+		// iteration is still needed by observers.
+		if(!IsActive(update->ntimestep))
+		{
+			RequestEnergy();
+			snapshot_->SetIteration(update->ntimestep);
+			return;
+		}
+
+		thermo_ = GetThermoNeeds(update->ntimestep);
 		SyncToSnapshot();
 		Hook::PostIntegrationHook();
 	}
 
+	void FixSSAGES::RequestEnergy()
+	{
+		// LAMMPS only tallies energies on steps that were requested in 
+		// advance. Ask for the next step if it needs the energy and for 
+		// the last step, which is synchronized again in post_run.
+		auto next = update->ntimestep + 1;
+		if((GetThermoNeeds(next) & EventListener::Energy) || next == update->laststep)
+			peid_->addstep(next);
+	}
+
 	void FixSSAGES::post_run()
 	{
+		thermo_ = EventListener::AllThermo;
 		SyncToSnapshot();
 		Hook::PostSimulationHook();
+
+		// LAMMPS may free its arrays after the run.
+		snapshot_->GetPositions().Detach();
+		snapshot_->GetVelocities().Detach();
+		snapshot_->GetForces().Detach();
 	}
 
 	void FixSSAGES::end_of_step()
@@ -106,14 +133,50 @@ namespace LAMMPS_NS
 		// change.
 		const auto* atom_ = atom;
 
-		auto n = atom->nlocal;
+		// Select the local atoms to synchronize. Only the atoms required 
+		// by SSAGES are copied if possible. This needs an atom map.
+		engineidx_.clear();
+		bool identity = IsFullSync() || atom_->map_style == 0;
+		if(identity)
+		{
+			engineidx_.resize(atom_->nlocal);
+			std::iota(engineidx_.begin(), engineidx_.end(), 0);
+		}
+		else
+		{
+			for(auto& id : GetSyncIDs())
+			{
+				auto k = atom->map(id);
+				if(k >= 0 && k < atom_->nlocal)
+					engineidx_.push_back(k);
+			}
+		}
+
+		int n = engineidx_.size();
 
+		// When all local atoms are synchronized the snapshot views the 
+		// LAMMPS position, velocity and force arrays directly. These are 
+		// contiguous xyz doubles but may be reallocated between steps, so 
+		// they are mapped anew on every call.
 		auto& pos = snapshot_->GetPositions();
-		pos.resize(n);
 		auto& vel = snapshot_->GetVelocities();
-		vel.resize(n);
 		auto& frc = snapshot_->GetForces();
-		frc.resize(n);
+		if(identity)
+		{
+			pos.Map(n ? atom->x[0] : nullptr, n);
+			vel.Map(n ? atom->v[0] : nullptr, n);
+			frc.Map(n ? atom->f[0] : nullptr, n);
+		}
+		else
+		{
+			pos.Unmap();
+			pos.resize(n);
+			vel.Unmap();
+			vel.resize(n);
+			frc.Unmap();
+			frc.resize(n);
+		}
+
 		auto& masses = snapshot_->GetMasses();
 		masses.resize(n);
 		auto& flags = snapshot_->GetImageFlags();
@@ -129,30 +192,36 @@ namespace LAMMPS_NS
 		auto& charges = snapshot_->GetCharges();
 		charges.resize(n);
 
-		// Thermo properties:
-		if (!(tempid_->invoked_flag & INVOKED_SCALAR)) 
+		// Thermo properties are only acquired when requested. The total 
+		// energy includes the kinetic part, so it needs the temperature.
+		if(thermo_ & (EventListener::Temperature | EventListener::Energy))
 		{
-      		tempid_->compute_scalar();
-      		tempid_->invoked_flag |= INVOKED_SCALAR;
-    	}
-		snapshot_->SetTemperature(tempid_->scalar);
-		//tempid_->addstep(update->ntimestep + 1);
-		
-		//Energy
-		double etot = 0;
+			if (!(tempid_->invoked_flag & INVOKED_SCALAR)) 
+			{
+				tempid_->compute_scalar();
+				tempid_->invoked_flag |= INVOKED_SCALAR;
+			}
+			snapshot_->SetTemperature(tempid_->scalar);
+		}
 
-		// Get potential energy.
-		peid_->compute_scalar();
-		peid_->invoked_flag |= INVOKED_SCALAR;
-		etot += peid_->scalar;
-		peid_->addstep(update->ntimestep + 1);
+		if(thermo_ & EventListener::Energy)
+		{
+			double etot = 0;
+
+			// Get potential energy.
+			peid_->compute_scalar();
+			peid_->invoked_flag |= INVOKED_SCALAR;
+			etot += peid_->scalar;
 
-		// Compute kinetic energy.
-		double ekin = 0.5 * tempid_->scalar * tempid_->dof  * force->boltz;
-		etot += ekin;
+			// Compute kinetic energy.
+			double ekin = 0.5 * tempid_->scalar * tempid_->dof  * force->boltz;
+			etot += ekin;
 
-		// Store in snapshot.
-		snapshot_->SetEnergy(etot/atom->natoms);
+			// Store in snapshot.
+			snapshot_->SetEnergy(etot/atom->natoms);
+		}
+
+		RequestEnergy();
 		snapshot_->SetIteration(update->ntimestep);
 		snapshot_->SetDielectric(force->dielectric);
 		snapshot_->Setqqrd2e(force->qqrd2e);
@@ -187,40 +256,52 @@ namespace LAMMPS_NS
 		// Zero the virial - we are only interested in accumulation.
 		snapshot_->SetVirial(Matrix3::Zero());
 
+		// Copy coordinates unless they are mapped.
+		if(!identity)
+			for (int i = 0; i < n; ++i)
+			{
+				auto k = engineidx_[i];
+
+				pos[i][0] = atom_->x[k][0]; //x
+				pos[i][1] = atom_->x[k][1]; //y
+				pos[i][2] = atom_->x[k][2]; //z
+				
+				frc[i][0] = atom_->f[k][0]; //force->x
+				frc[i][1] = atom_->f[k][1]; //force->y
+				frc[i][2] = atom_->f[k][2]; //force->z
+				
+				vel[i][0] = atom_->v[k][0];
+				vel[i][1] = atom_->v[k][1];
+				vel[i][2] = atom_->v[k][2];
+			}
+
 		// First we sync local data, then gather.
 		// we gather data across all processors.
 		for (int i = 0; i < n; ++i)
 		{
-			pos[i][0] = atom_->x[i][0]; //x
-			pos[i][1] = atom_->x[i][1]; //y
-			pos[i][2] = atom_->x[i][2]; //z
-			
-			frc[i][0] = atom_->f[i][0]; //force->x
-			frc[i][1] = atom_->f[i][1]; //force->y
-			frc[i][2] = atom_->f[i][2]; //force->z
+			auto k = engineidx_[i];
 
 			if(atom_->rmass_flag)
-				masses[i] = atom_->rmass[i];
+				masses[i] = atom_->rmass[k];
 			else
-				masses[i] = atom_->mass[atom_->type[i]];
-			
-			vel[i][0] = atom_->v[i][0];
-			vel[i][1] = atom_->v[i][1];
-			vel[i][2] = atom_->v[i][2];
+				masses[i] = atom_->mass[atom_->type[k]];
 
 			// Image flags. 
-			flags[i][0] = (atom_->image[i] & IMGMASK) - IMGMAX;;
-			flags[i][1] = (atom_->image[i] >> IMGBITS & IMGMASK) - IMGMAX;
-			flags[i][2] = (atom_->image[i] >> IMG2BITS) - IMGMAX;
+			flags[i][0] = (atom_->image[k] & IMGMASK) - IMGMAX;;
+			flags[i][1] = (atom_->image[k] >> IMGBITS & IMGMASK) - IMGMAX;
+			flags[i][2] = (atom_->image[k] >> IMG2BITS) - IMGMAX;
 
-			ids[i] = atom_->tag[i];
-			types[i] = atom_->type[i];
+			ids[i] = atom_->tag[k];
+			types[i] = atom_->type[k];
 
 			if(atom_->q_flag)
-				charges[i] = atom_->q[i];
+				charges[i] = atom_->q[k];
 			else
 				charges[i] = 0;
 		}
+
+		// Refresh atom ID lookup.
+		snapshot_->UpdateIndexMap();
 	}
 
 	void FixSSAGES::SyncToEngine() //put Snapshot values -> LAMMPS
@@ -240,28 +321,54 @@ namespace LAMMPS_NS
 		const auto& ids = snapshot_->GetAtomIDs();
 		const auto& types = snapshot_->GetAtomTypes();
 
-		for (int i = 0; i < atom->nlocal; ++i)
-		{
-			atom->x[i][0] = pos[i][0]; //x 
-			atom->x[i][1] = pos[i][1]; //y
-			atom->x[i][2] = pos[i][2]; //z
-			atom->f[i][0] = frc[i][0]; //force->x
-			atom->f[i][1] = frc[i][1]; //force->y
-			atom->f[i][2] = frc[i][2]; //force->z
-			atom->v[i][0] = vel[i][0]; //velocity->x
-			atom->v[i][1] = vel[i][1]; //velocity->y
-			atom->v[i][2] = vel[i][2]; //velocity->z
-			atom->tag[i] = ids[i];
-			atom->type[i] = types[i];
+		// Only the atoms pulled in SyncToSnapshot are pushed back, and 
+		// only the fields which were modified. Mapped fields were 
+		// written in place.
+		auto nsync = engineidx_.size();
+		if(!pos.IsMapped() && snapshot_->HasChanged(Snapshot::Positions))
+			for (size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				atom->x[k][0] = pos[i][0]; //x 
+				atom->x[k][1] = pos[i][1]; //y
+				atom->x[k][2] = pos[i][2]; //z
+			}
+
+		if(!frc.IsMapped() && snapshot_->HasChanged(Snapshot::Forces))
+			for (size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				atom->f[k][0] = frc[i][0]; //force->x
+				atom->f[k][1] = frc[i][1]; //force->y
+				atom->f[k][2] = frc[i][2]; //force->z
+			}
+
+		if(!vel.IsMapped() && snapshot_->HasChanged(Snapshot::Velocities))
+			for (size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				atom->v[k][0] = vel[i][0]; //velocity->x
+				atom->v[k][1] = vel[i][1]; //velocity->y
+				atom->v[k][2] = vel[i][2]; //velocity->z
+			}
+
+		if(snapshot_->HasChanged(Snapshot::AtomIDs | Snapshot::AtomTypes))
+			for (size_t i = 0; i < nsync; ++i)
+			{
+				auto k = engineidx_[i];
+				atom->tag[k] = ids[i];
+				atom->type[k] = types[i];
+			}
 			
-			if(atom->q_flag)
-				atom->q[i] = charges[i];
+		if(atom->q_flag && snapshot_->HasChanged(Snapshot::Charges))
+			for (size_t i = 0; i < nsync; ++i)
+				atom->q[engineidx_[i]] = charges[i];
 			
-			// Current masses can only be changed if using
-			// per atom masses in lammps
-			if(atom->rmass_flag)
-				atom->rmass[i] = masses[i];			
-		}
+		// Current masses can only be changed if using
+		// per atom masses in lammps
+		if(atom->rmass_flag && snapshot_->HasChanged(Snapshot::Masses))
+			for (size_t i = 0; i < nsync; ++i)
+				atom->rmass[engineidx_[i]] = masses[i];
 
 		// Update the virial (negative contribution to box). 
 		const auto& vir = snapshot_->GetVirial();
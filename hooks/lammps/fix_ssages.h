@@ -8,6 +8,7 @@ FixStyle(ssages,FixSSAGES)
 
 #include "fix.h"
 #include "Hook.h"
+#include <vector>
 
 
 namespace LAMMPS_NS
@@ -22,6 +23,15 @@ namespace LAMMPS_NS
 		// Compute IDs.
 		class Compute *tempid_, *peid_;
 
+		// Local LAMMPS indices of the atoms in the snapshot.
+		std::vector<int> engineidx_;
+
+		// Thermodynamic quantities to acquire on the next sync.
+		unsigned thermo_;
+
+		// Ask LAMMPS to tally the energy at the next step if needed.
+		void RequestEnergy();
+
 	protected:
 		// Implementation of the SyncToEngine interface.
 		void SyncToEngine() override;
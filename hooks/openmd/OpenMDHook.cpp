@@ -5,39 +5,62 @@
 #include "brains/Thermo.hpp"
 #include "utils/PhysicalConstants.hpp"
 #include "primitives/Molecule.hpp"
+#include <algorithm>
 
 using namespace OpenMD;
 
 namespace SSAGES
 {
-	void OpenMDHook::SyncToEngine() 
+	void OpenMDHook::CollectAtoms()
 	{
-		const auto& pos = snapshot_->GetPositions();
-		const auto& vel = snapshot_->GetVelocities();
-		const auto& frc = snapshot_->GetForces();
-		const auto& mass = snapshot_->GetMasses();
-		const auto& ids = snapshot_->GetAtomIDs();
-		
-		// Loop through and set atom properties.
-		size_t index = 0;
+		// OpenMD does not migrate atoms between processors, so a subset 
+		// only needs to be collected once. 
+		if(cached_ && !IsFullSync())
+			return;
+
+		const auto& syncids = GetSyncIDs();
+		atoms_.clear();
 		SimInfo::MoleculeIterator i;
     	Molecule::AtomIterator  j;
 		for (auto* mol = siminfo_->beginMolecule(i); mol != NULL; mol = siminfo_->nextMolecule(i)) 
 		{
       		for (auto* atom = mol->beginAtom(j); atom != NULL; atom = mol->nextAtom(j)) 
       		{
-      			atom->setMass(mass[index]);
-      			atom->setPos({pos[index][0], pos[index][1], pos[index][2]});
-      			atom->setVel({vel[index][0], vel[index][1], vel[index][2]});
-      			atom->setFrc({frc[index][0], frc[index][1], frc[index][2]});
-      			++index;
+      			if(IsFullSync() || std::binary_search(syncids.begin(), syncids.end(), atom->getGlobalIndex()))
+      				atoms_.push_back(atom);
       		}
       	}
+
+      	cached_ = !IsFullSync();
+	}
+
+	void OpenMDHook::SyncToEngine() 
+	{
+		const auto& pos = snapshot_->GetPositions();
+		const auto& vel = snapshot_->GetVelocities();
+		const auto& frc = snapshot_->GetForces();
+		const auto& mass = snapshot_->GetMasses();
+		
+		// Loop through and set the modified properties of the atoms 
+		// collected in SyncToSnapshot.
+		bool setmass = snapshot_->HasChanged(Snapshot::Masses);
+		bool setpos = snapshot_->HasChanged(Snapshot::Positions);
+		bool setvel = snapshot_->HasChanged(Snapshot::Velocities);
+		bool setfrc = snapshot_->HasChanged(Snapshot::Forces);
+		for (size_t index = 0; index < atoms_.size(); ++index) 
+		{
+			auto* atom = atoms_[index];
+			if(setmass) atom->setMass(mass[index]);
+			if(setpos) atom->setPos({pos[index][0], pos[index][1], pos[index][2]});
+			if(setvel) atom->setVel({vel[index][0], vel[index][1], vel[index][2]});
+			if(setfrc) atom->setFrc({frc[index][0], frc[index][1], frc[index][2]});
+		}
 	}
 
 	void OpenMDHook::SyncToSnapshot()
 	{
-		auto natoms = siminfo_->getNGlobalAtoms();
+		CollectAtoms();
+		auto natoms = atoms_.size();
 
 		// Resize vectors.
 		auto& pos = snapshot_->GetPositions();
@@ -67,34 +90,29 @@ namespace SSAGES
 
 		// Loop through and get atom properties.
 		size_t index = 0;
-		SimInfo::MoleculeIterator i;
-    	Molecule::AtomIterator  j;
-		for (auto* mol = siminfo_->beginMolecule(i); mol != NULL; mol = siminfo_->nextMolecule(i)) 
+		for (auto* atom : atoms_) 
 		{
-      		for (auto* atom = mol->beginAtom(j); atom != NULL; atom = mol->nextAtom(j)) 
-      		{
-        		auto v = atom->getVel();
-        		auto p = atom->getPos();
-        		auto f = atom->getFrc();
+        	auto v = atom->getVel();
+        	auto p = atom->getPos();
+        	auto f = atom->getFrc();
 
-        		//TODO: Get integer type of stunt double.
-        		ids[index] = atom->getGlobalIndex();
-        		mass[index] = atom->getMass();
+        	//TODO: Get integer type of stunt double.
+        	ids[index] = atom->getGlobalIndex();
+        	mass[index] = atom->getMass();
 
-        		pos[index][0] = p[0];
-        		pos[index][1] = p[1];
-        		pos[index][2] = p[2];
+        	pos[index][0] = p[0];
+        	pos[index][1] = p[1];
+        	pos[index][2] = p[2];
 
-        		vel[index][0] = v[0];
-        		vel[index][1] = v[1];
-        		vel[index][2] = v[2];
+        	vel[index][0] = v[0];
+        	vel[index][1] = v[1];
+        	vel[index][2] = v[2];
 
-        		frc[index][0] = f[0];
-        		frc[index][1] = f[1];
-        		frc[index][2] = f[2];
+        	frc[index][0] = f[0];
+        	frc[index][1] = f[1];
+        	frc[index][2] = f[2];
 
-        		++index;
-        	}
+        	++index;
         }
 
         auto Homd = osnap->getHmat();
@@ -112,6 +130,9 @@ namespace SSAGES
         typs.resize(index);
         snapshot_->SetNumAtoms(index);
 
+		// Refresh atom ID lookup.
+		snapshot_->UpdateIndexMap();
+
 		Hook::PostStepHook();
 	}
 }
\ No newline at end of file
@@ -7,6 +7,12 @@
 
 #include "Hook.h"
 #include "brains/SimInfo.hpp"
+#include <vector>
+
+namespace OpenMD
+{
+	class Atom;
+}
 
 namespace SSAGES
 {
@@ -15,8 +21,15 @@ namespace SSAGES
 	private:
 		OpenMD::SimInfo* siminfo_;
 
+		// Atoms in the snapshot, and whether they are a cached subset.
+		std::vector<OpenMD::Atom*> atoms_;
+		bool cached_;
+
+		// Collect the atoms to synchronize.
+		void CollectAtoms();
+
 		// Private constructor to enforce singleton.
-		OpenMDHook() {}
+		OpenMDHook() : siminfo_(nullptr), atoms_(), cached_(false) {}
 	
 	protected: 
 		// Implementation of the SyncToEngine interface.
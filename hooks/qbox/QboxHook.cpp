@@ -193,6 +193,9 @@ namespace SSAGES
 				snapshot_->SetHMatrix(H);
 			}
 		}
+
+		// Refresh atom ID lookup.
+		snapshot_->UpdateIndexMap();
 	}
 
 	void QboxHook::SyncToEngine()
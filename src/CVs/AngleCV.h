@@ -36,6 +36,12 @@ namespace SSAGES
 		//! Vector of 3 atom ID's of interest.
 		Label atomids_;
 
+		//! Local indices of the atoms, -1 if not local.
+		std::array<int, 3> indices_;
+
+		//! CommPlan segment holding the atom positions.
+		size_t handle_;
+
 	public:
 
 		//! Constructor.
@@ -49,7 +55,7 @@ namespace SSAGES
 		 * \todo Bounds needs to be an input and periodic boundary conditions
 		 */
 		AngleCV(int atomid1, int atomid2, int atomid3) :
-		atomids_({atomid1, atomid2, atomid3})
+		atomids_({atomid1, atomid2, atomid3}), indices_(), handle_(0)
 		{
 			bounds_ = {{0,M_PI}};
 		}
@@ -76,36 +82,65 @@ namespace SSAGES
 				});	
 		}
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
 		{
-			// Get data from snapshot. 
-			auto n = snapshot.GetNumAtoms();
-			const auto& pos = snapshot.GetPositions();
-			auto& comm = snapshot.GetCommunicator();
-
-			// Initialize gradient.
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
-
-			Vector3 xi{0, 0, 0}, xj{0, 0, 0}, xk{0, 0, 0};
-
-			auto iindex = snapshot.GetLocalIndex(atomids_[0]);
-			auto jindex = snapshot.GetLocalIndex(atomids_[1]);
-			auto kindex = snapshot.GetLocalIndex(atomids_[2]);
+			EvaluateStaged(snapshot);
+		}
 
-			if(iindex != -1) xi = pos[iindex];
-			if(jindex != -1) xj = pos[jindex];
-			if(kindex != -1) xk = pos[kindex];
+		//! Get the number of communication rounds.
+		/*!
+		 * \return One round to collect the three atom positions.
+		 */
+		int GetCommStages() const override { return 1; }
 
-			// By performing a reduce, we actually collect all. This can 
-			// be converted to a more intelligent allgater on rank then bcast. 
-			MPI_Allreduce(MPI_IN_PLACE, xi.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, xj.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, xk.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			if(stage == 0)
+			{
+				// Get data from snapshot. 
+				auto n = snapshot.GetNumAtoms();
+				const auto& pos = snapshot.GetPositions();
+
+				// Initialize gradient.
+				ClearGradient(n);
+
+				// Positions are collected by a sum, with each atom 
+				// contributed by the rank that owns it. 
+				handle_ = plan.ReserveSum(9);
+				auto* x = plan.Local(handle_);
+				for(int i = 0; i < 3; ++i)
+				{
+					indices_[i] = snapshot.GetLocalIndex(atomids_[i]);
+					if(indices_[i] != -1)
+						std::copy(pos[indices_[i]].data(), pos[indices_[i]].data() + 3, x + 3*i);
+				}
+				return;
+			}
+
+			auto* x = plan.Result(handle_);
+			Vector3 xi{x[0], x[1], x[2]}, xj{x[3], x[4], x[5]}, xk{x[6], x[7], x[8]};
+			auto iindex = indices_[0], jindex = indices_[1], kindex = indices_[2];
 
 			// Two vectors
 			auto rij = snapshot.ApplyMinimumImage(xi - xj);
@@ -120,14 +155,13 @@ namespace SSAGES
 			// Calculate gradients
 			auto prefactor = -1.0/(sqrt(1. - dotP/(nrij*nrkj))*nrij*nrkj);
 
-			Vector3 gradi{0, 0, 0}, gradk{0, 0, 0};
-			if(iindex != -1) gradi = prefactor*(rkj - dotP*rij/(nrij*nrij));
-			if(kindex != -1) gradk = prefactor*(rij - dotP*rkj/(nrkj*nrkj));
-			MPI_Allreduce(MPI_IN_PLACE, gradi.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, gradk.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			if(iindex != -1) grad_[iindex] = gradi;	
-			if(kindex != -1) grad_[kindex] = gradk;
-			if(jindex != -1) grad_[jindex] = -gradi - gradk;
+			// Every rank knows all positions, so the outer gradients 
+			// need no further communication.
+			Vector3 gradi = prefactor*(rkj - dotP*rij/(nrij*nrij));
+			Vector3 gradk = prefactor*(rij - dotP*rkj/(nrkj*nrkj));
+			if(iindex != -1) AddGradient(iindex, gradi);
+			if(kindex != -1) AddGradient(kindex, gradk);
+			if(jindex != -1) AddGradient(jindex, -gradi - gradk);
 		}
 
 		//! Serialize this CV for restart purposes.
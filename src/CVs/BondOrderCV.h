@@ -0,0 +1,755 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "CVs/MultiCollectiveVariable.h"
+#include "CVs/SwitchingFunction.h"
+#include "Drivers/DriverException.h"
+#include "Utility/NeighborList.h"
+#include "Utility/SphericalHarmonics.h"
+
+namespace SSAGES
+{
+	enum BondOrder
+	{
+		Q4 = 0, // Global Steinhardt Q4
+		Q6 = 1, // Global Steinhardt Q6
+		q4 = 2, // Mean local q4
+		q6 = 3, // Mean local q6
+		aq4 = 4, // Mean averaged local q4
+		aq6 = 5, // Mean averaged local q6
+		nsolid = 6, // Number of solid-like atoms
+		density = 7 // Mean number of neighbors
+	};
+
+	//! Collective variable on Steinhardt bond-order parameters.
+	/*!
+	 * Bond-order parameters of a group of atoms, with neighbors weighted
+	 * by a switching function \f$ w_{ij} \f$. For each atom,
+	 * \f$ q_{lm}(i) = \sum_j w_{ij} Y_{lm}(\hat{\mathbf{r}}_{ij}) / N_i \f$
+	 * with \f$ N_i = \sum_j w_{ij} \f$. The components are
+	 *
+	 * * Q4, Q6: global order \f$ Q_l \f$ of all bonds in the group.
+	 * * q4, q6: local \f$ q_l(i) \f$, averaged over the group.
+	 * * aq4, aq6: \f$ q_l(i) \f$ of Lechner and Dellago, whose
+	 *   \f$ q_{lm} \f$ are averaged over the atom and its neighbors,
+	 *   averaged over the group.
+	 * * nsolid: number of solid-like atoms. Two atoms are bonded if the
+	 *   normalized dot product of their \f$ q_{6m} \f$ exceeds a threshold,
+	 *   and an atom is solid-like if it has enough bonds. Both thresholds
+	 *   are smoothed by Fermi functions.
+	 * * density: mean \f$ N_i \f$, the local density around an atom.
+	 *
+	 * Positions of the group are gathered on all processors in a single
+	 * communication round. Every processor then finds the neighbors with a
+	 * cell list and computes the parameters, but only applies gradients to
+	 * the atoms it owns. Harmonics and switching function are evaluated in
+	 * batches over all pairs.
+	 *
+	 * Several components can be requested at once and share the neighbor
+	 * list and harmonics.
+	 *
+	 * \ingroup CVs
+	 */
+	class BondOrderCV : public MultiCollectiveVariable
+	{
+	private:
+		//! Harmonics of one degree and the quantities built from them.
+		struct Degree
+		{
+			SphericalHarmonics sh; //!< Harmonics.
+			int M; //!< Number of components.
+			double c; //!< Prefactor 4 pi/(2l+1) of the norm.
+			bool used; //!< \c TRUE if a requested component needs the degree.
+			std::vector<double> Y, dx, dy, dz; //!< Harmonics of each pair and their gradients, by component.
+			std::vector<double> q; //!< q_lm of each atom, by atom.
+			std::vector<double> ql; //!< q_l of each atom.
+			std::vector<double> a; //!< Averaged q_lm of each atom, by atom.
+			std::vector<double> al; //!< Averaged q_l of each atom.
+			std::vector<double> T; //!< Sum of the bond harmonics.
+			std::vector<double> barS; //!< Adjoint of the weighted harmonic sums.
+			std::vector<double> barq; //!< Adjoint of q_lm.
+
+			//! Constructor.
+			Degree(int l) :
+			sh(l), M(2*l + 1), c(4.*std::acos(-1.)/(2*l + 1)), used(false),
+			Y(), dx(), dy(), dz(), q(), ql(), a(), al(), T(), barS(), barq()
+			{}
+		};
+
+		Label atomids_; //!< IDs of the atoms.
+		SwitchingFunction sf_; //!< Switching function defining the neighbors.
+		double dthresh_; //!< Threshold of the bond dot product.
+		double dwidth_; //!< Width of the bond threshold.
+		double nthresh_; //!< Threshold of the number of bonds.
+		double nwidth_; //!< Width of the solid threshold.
+
+		Label idx_; //!< Local index of each atom, -1 if not local.
+		size_t handle_; //!< Pending CommPlan segment.
+		NeighborList nlist_; //!< Pairs within the switching function cutoff.
+		std::vector<Vector3> pos_; //!< Positions of all atoms.
+
+		// Pairs within the cutoff, i < j.
+		std::vector<int> pi_, pj_; //!< Atoms of each pair.
+		std::vector<double> rx_, ry_, rz_; //!< Separations.
+		std::vector<double> r2_; //!< Squared distances.
+		std::vector<double> ux_, uy_, uz_; //!< Bond directions.
+		std::vector<double> rinv_; //!< Inverse distances.
+		std::vector<double> w_, dfr_; //!< Weights and their derivatives over distance.
+
+		std::vector<double> nb_; //!< Weighted number of neighbors of each atom.
+		Degree d4_, d6_; //!< Harmonics of degree 4 and 6.
+
+		// Solid-like atoms.
+		std::vector<double> u_; //!< Normalized q_6m of each atom.
+		std::vector<double> qn_; //!< Norm of q_6m of each atom.
+		std::vector<double> sd_, dsd_; //!< Bond function of each pair and its derivative.
+		std::vector<double> xi_; //!< Number of bonds of each atom.
+
+		// Adjoints of one component.
+		std::vector<double> barN_; //!< Adjoint of the number of neighbors.
+		std::vector<double> dFdw_; //!< Explicit derivative with respect to the weights.
+		std::vector<double> baru_; //!< Adjoint of the normalized q_6m.
+		std::vector<Vector3> grad_; //!< Gradient on each atom.
+
+		//! Fermi function and its derivative.
+		static double Fermi(double x, double x0, double width, double& df)
+		{
+			auto s = 1./(1. + std::exp(-(x - x0)/width));
+			df = s*(1. - s)/width;
+			return s;
+		}
+
+		//! Find the pairs and evaluate weights and harmonics.
+		void Pairs(const Snapshot& snapshot)
+		{
+			auto n = pos_.size();
+			pi_.clear();
+			pj_.clear();
+			rx_.clear();
+			ry_.clear();
+			rz_.clear();
+			r2_.clear();
+
+			const auto rc2 = sf_.IsTruncated() ? sf_.GetCutoff()*sf_.GetCutoff() : 
+			                 std::numeric_limits<double>::max();
+			auto pair = [&](int i, int j)
+			{
+				Vector3 rij = pos_[i] - pos_[j];
+				snapshot.ApplyMinimumImage(&rij);
+				auto r2 = rij.squaredNorm();
+				if(r2 > rc2 || r2 == 0)
+					return;
+
+				pi_.push_back(i);
+				pj_.push_back(j);
+				rx_.push_back(rij[0]);
+				ry_.push_back(rij[1]);
+				rz_.push_back(rij[2]);
+				r2_.push_back(r2);
+			};
+
+			// Visit all pairs unless the switching function is truncated.
+			if(sf_.IsTruncated())
+			{
+				nlist_.Update(snapshot, pos_);
+				for(auto& p : nlist_.GetPairs())
+					pair(p.first, p.second);
+			}
+			else
+			{
+				for(size_t i = 0; i < n; ++i)
+					for(size_t j = i + 1; j < n; ++j)
+						pair(i, j);
+			}
+
+			auto np = pi_.size();
+			w_.resize(np);
+			dfr_.resize(np);
+			sf_.Evaluate(r2_.data(), np, w_.data(), dfr_.data());
+
+			rinv_.resize(np);
+			ux_.resize(np);
+			uy_.resize(np);
+			uz_.resize(np);
+			for(size_t p = 0; p < np; ++p)
+			{
+				rinv_[p] = 1./std::sqrt(r2_[p]);
+				ux_[p] = rx_[p]*rinv_[p];
+				uy_[p] = ry_[p]*rinv_[p];
+				uz_[p] = rz_[p]*rinv_[p];
+			}
+
+			nb_.assign(n, 0);
+			for(size_t p = 0; p < np; ++p)
+			{
+				nb_[pi_[p]] += w_[p];
+				nb_[pj_[p]] += w_[p];
+			}
+		}
+
+		//! Compute the local parameters of one degree.
+		void Local(Degree& d, bool averaged)
+		{
+			auto n = pos_.size(), np = pi_.size();
+			auto M = d.M;
+
+			d.Y.resize(M*np);
+			d.dx.resize(M*np);
+			d.dy.resize(M*np);
+			d.dz.resize(M*np);
+			d.sh.Evaluate(np, ux_.data(), uy_.data(), uz_.data(),
+			              d.Y.data(), d.dx.data(), d.dy.data(), d.dz.data());
+
+			// Even harmonics are the same seen from either atom.
+			d.q.assign(n*M, 0);
+			for(size_t p = 0; p < np; ++p)
+				for(int m = 0; m < M; ++m)
+				{
+					auto v = w_[p]*d.Y[m*np + p];
+					d.q[pi_[p]*M + m] += v;
+					d.q[pj_[p]*M + m] += v;
+				}
+
+			d.T.assign(M, 0);
+			d.ql.assign(n, 0);
+			for(size_t i = 0; i < n; ++i)
+			{
+				auto* qi = &d.q[i*M];
+				for(int m = 0; m < M; ++m)
+					d.T[m] += qi[m];
+
+				if(nb_[i] == 0)
+					continue;
+
+				double sum = 0;
+				for(int m = 0; m < M; ++m)
+				{
+					qi[m] /= nb_[i];
+					sum += qi[m]*qi[m];
+				}
+				d.ql[i] = std::sqrt(d.c*sum);
+			}
+
+			if(!averaged)
+				return;
+
+			d.a = d.q;
+			for(size_t p = 0; p < np; ++p)
+			{
+				auto* ai = &d.a[pi_[p]*M];
+				auto* aj = &d.a[pj_[p]*M];
+				const auto* qi = &d.q[pi_[p]*M];
+				const auto* qj = &d.q[pj_[p]*M];
+				for(int m = 0; m < M; ++m)
+				{
+					ai[m] += w_[p]*qj[m];
+					aj[m] += w_[p]*qi[m];
+				}
+			}
+
+			d.al.assign(n, 0);
+			for(size_t i = 0; i < n; ++i)
+			{
+				auto* ai = &d.a[i*M];
+				double sum = 0;
+				for(int m = 0; m < M; ++m)
+				{
+					ai[m] /= 1. + nb_[i];
+					sum += ai[m]*ai[m];
+				}
+				d.al[i] = std::sqrt(d.c*sum);
+			}
+		}
+
+		//! Count the solid-like atoms.
+		double Solid()
+		{
+			auto n = pos_.size(), np = pi_.size();
+			const int M = d6_.M;
+
+			u_.assign(n*M, 0);
+			qn_.assign(n, 0);
+			for(size_t i = 0; i < n; ++i)
+			{
+				qn_[i] = d6_.ql[i]/std::sqrt(d6_.c);
+				if(qn_[i] == 0)
+					continue;
+				for(int m = 0; m < M; ++m)
+					u_[i*M + m] = d6_.q[i*M + m]/qn_[i];
+			}
+
+			sd_.resize(np);
+			dsd_.resize(np);
+			xi_.assign(n, 0);
+			for(size_t p = 0; p < np; ++p)
+			{
+				const auto* ui = &u_[pi_[p]*M];
+				const auto* uj = &u_[pj_[p]*M];
+				double dot = 0;
+				for(int m = 0; m < M; ++m)
+					dot += ui[m]*uj[m];
+
+				sd_[p] = Fermi(dot, dthresh_, dwidth_, dsd_[p]);
+				xi_[pi_[p]] += w_[p]*sd_[p];
+				xi_[pj_[p]] += w_[p]*sd_[p];
+			}
+
+			double ns = 0, ds;
+			for(size_t i = 0; i < n; ++i)
+				ns += Fermi(xi_[i], nthresh_, nwidth_, ds);
+			return ns;
+		}
+
+		//! Turn adjoints of q_lm into adjoints of the weighted sums.
+		void Unnormalize(Degree& d)
+		{
+			auto n = pos_.size();
+			auto M = d.M;
+			for(size_t i = 0; i < n; ++i)
+			{
+				if(nb_[i] == 0)
+					continue;
+
+				const auto* qi = &d.q[i*M];
+				const auto* bq = &d.barq[i*M];
+				double dot = 0;
+				for(int m = 0; m < M; ++m)
+				{
+					d.barS[i*M + m] += bq[m]/nb_[i];
+					dot += bq[m]*qi[m];
+				}
+				barN_[i] -= dot/nb_[i];
+			}
+		}
+
+		//! Clear the adjoints ahead of a component.
+		void ClearAdjoints()
+		{
+			auto n = pos_.size();
+			barN_.assign(n, 0);
+			dFdw_.assign(pi_.size(), 0);
+			for(auto* d : {&d4_, &d6_})
+			{
+				d->barS.assign(n*d->M, 0);
+				d->barq.assign(n*d->M, 0);
+			}
+		}
+
+		//! Set the adjoints of the global parameter.
+		double Global(Degree& d)
+		{
+			auto n = pos_.size();
+			auto M = d.M;
+			double ntot = 0;
+			for(auto& nb : nb_)
+				ntot += nb;
+			if(ntot == 0)
+				return 0;
+
+			double sum = 0;
+			for(int m = 0; m < M; ++m)
+				sum += d.T[m]*d.T[m];
+			auto Q = std::sqrt(d.c*sum)/ntot;
+			if(Q == 0)
+				return 0;
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				for(int m = 0; m < M; ++m)
+					d.barS[i*M + m] = d.c*d.T[m]/(Q*ntot*ntot);
+				barN_[i] = -Q/ntot;
+			}
+			return Q;
+		}
+
+		//! Set the adjoints of the mean local parameter.
+		double MeanLocal(Degree& d)
+		{
+			auto n = pos_.size();
+			auto M = d.M;
+			double mean = 0;
+			for(size_t i = 0; i < n; ++i)
+			{
+				mean += d.ql[i]/n;
+				if(d.ql[i] == 0)
+					continue;
+				for(int m = 0; m < M; ++m)
+					d.barq[i*M + m] = d.c*d.q[i*M + m]/(n*d.ql[i]);
+			}
+
+			Unnormalize(d);
+			return mean;
+		}
+
+		//! Set the adjoints of the mean averaged parameter.
+		double MeanAveraged(Degree& d)
+		{
+			auto n = pos_.size(), np = pi_.size();
+			auto M = d.M;
+
+			// Adjoint of the average before division by 1 + N_i.
+			std::vector<double> barA(n*M, 0);
+			double mean = 0;
+			for(size_t i = 0; i < n; ++i)
+			{
+				mean += d.al[i]/n;
+				if(d.al[i] == 0)
+					continue;
+
+				double dot = 0;
+				for(int m = 0; m < M; ++m)
+				{
+					auto ba = d.c*d.a[i*M + m]/(n*d.al[i]);
+					barA[i*M + m] = ba/(1. + nb_[i]);
+					dot += ba*d.a[i*M + m];
+				}
+				barN_[i] -= dot/(1. + nb_[i]);
+			}
+
+			d.barq = barA;
+			for(size_t p = 0; p < np; ++p)
+			{
+				const auto* bi = &barA[pi_[p]*M];
+				const auto* bj = &barA[pj_[p]*M];
+				const auto* qi = &d.q[pi_[p]*M];
+				const auto* qj = &d.q[pj_[p]*M];
+				auto* bqi = &d.barq[pi_[p]*M];
+				auto* bqj = &d.barq[pj_[p]*M];
+				double dw = 0;
+				for(int m = 0; m < M; ++m)
+				{
+					bqj[m] += w_[p]*bi[m];
+					bqi[m] += w_[p]*bj[m];
+					dw += bi[m]*qj[m] + bj[m]*qi[m];
+				}
+				dFdw_[p] += dw;
+			}
+
+			Unnormalize(d);
+			return mean;
+		}
+
+		//! Set the adjoints of the number of solid-like atoms.
+		void SolidAdjoints()
+		{
+			auto n = pos_.size(), np = pi_.size();
+			const int M = d6_.M;
+
+			std::vector<double> barxi(n);
+			for(size_t i = 0; i < n; ++i)
+				Fermi(xi_[i], nthresh_, nwidth_, barxi[i]);
+
+			baru_.assign(n*M, 0);
+			for(size_t p = 0; p < np; ++p)
+			{
+				auto i = pi_[p], j = pj_[p];
+				auto bx = barxi[i] + barxi[j];
+				dFdw_[p] += bx*sd_[p];
+
+				auto bd = bx*w_[p]*dsd_[p];
+				for(int m = 0; m < M; ++m)
+				{
+					baru_[i*M + m] += bd*u_[j*M + m];
+					baru_[j*M + m] += bd*u_[i*M + m];
+				}
+			}
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				if(qn_[i] == 0)
+					continue;
+
+				const auto* ui = &u_[i*M];
+				const auto* bu = &baru_[i*M];
+				double dot = 0;
+				for(int m = 0; m < M; ++m)
+					dot += bu[m]*ui[m];
+				for(int m = 0; m < M; ++m)
+					d6_.barq[i*M + m] = (bu[m] - ui[m]*dot)/qn_[i];
+			}
+
+			Unnormalize(d6_);
+		}
+
+		//! Propagate the adjoints to the positions.
+		/*!
+		 * \param c Component.
+		 * \param box \c TRUE to compute the box gradient.
+		 */
+		void Backpropagate(size_t c, bool box)
+		{
+			auto n = pos_.size(), np = pi_.size();
+			grad_.assign(n, Vector3::Zero());
+			auto& boxgrad = cboxgrads_[c];
+
+			for(size_t p = 0; p < np; ++p)
+			{
+				auto i = pi_[p], j = pj_[p];
+				if(!box && idx_[i] == -1 && idx_[j] == -1)
+					continue;
+
+				auto dw = dFdw_[p] + barN_[i] + barN_[j];
+				Vector3 dY = Vector3::Zero();
+				for(auto* d : {&d4_, &d6_})
+				{
+					if(!d->used)
+						continue;
+
+					auto M = d->M;
+					const auto* bi = &d->barS[i*M];
+					const auto* bj = &d->barS[j*M];
+					for(int m = 0; m < M; ++m)
+					{
+						auto bs = bi[m] + bj[m];
+						auto k = m*np + p;
+						dw += bs*d->Y[k];
+						dY += bs*Vector3{d->dx[k], d->dy[k], d->dz[k]};
+					}
+				}
+
+				Vector3 rij{rx_[p], ry_[p], rz_[p]};
+				Vector3 g = dw*dfr_[p]*rij + w_[p]*rinv_[p]*dY;
+				grad_[i] += g;
+				grad_[j] -= g;
+				if(box)
+					boxgrad += g*rij.transpose();
+			}
+
+			for(size_t i = 0; i < n; ++i)
+				if(idx_[i] != -1)
+					AddComponentGradient(c, idx_[i], grad_[i]);
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param atomids IDs of the atoms.
+		 * \param sf Switching function defining the neighbors.
+		 * \param components Components to compute. The first one is the
+		 *        value of this CV.
+		 * \param skin Verlet skin of the neighbor list.
+		 * \param dthresh Threshold of the bond dot product.
+		 * \param dwidth Width of the bond threshold.
+		 * \param nthresh Number of bonds of a solid-like atom.
+		 * \param nwidth Width of the solid threshold.
+		 *
+		 * Construct a BondOrderCV.
+		 *
+		 */
+		BondOrderCV(const Label& atomids, SwitchingFunction&& sf, const std::vector<size_t>& components,
+		            double skin = 0, double dthresh = 0.7, double dwidth = 0.05,
+		            double nthresh = 6.5, double nwidth = 0.25) :
+		MultiCollectiveVariable(8, components), atomids_(atomids), sf_(sf),
+		dthresh_(dthresh), dwidth_(dwidth), nthresh_(nthresh), nwidth_(nwidth),
+		idx_(), handle_(0), nlist_(sf_.GetCutoff(), skin), pos_(),
+		pi_(), pj_(), rx_(), ry_(), rz_(), r2_(), ux_(), uy_(), uz_(), rinv_(), w_(), dfr_(),
+		nb_(), d4_(4), d6_(6), u_(), qn_(), sd_(), dsd_(), xi_(),
+		barN_(), dFdw_(), baru_(), grad_()
+		{
+			d4_.used = IsEnabled(Q4) || IsEnabled(q4) || IsEnabled(aq4);
+			d6_.used = IsEnabled(Q6) || IsEnabled(q6) || IsEnabled(aq6) || IsEnabled(nsolid);
+		}
+
+		//! \copydoc MultiCollectiveVariable::GetNumComponents()
+		size_t GetNumComponents() const override { return 8; }
+
+		//! \copydoc MultiCollectiveVariable::GetComponentName()
+		std::string GetComponentName(size_t c) const override
+		{
+			static const char* names[] = {
+				"Q4", "Q6", "q4", "q6", "aq4", "aq6", "nsolid", "density"
+			};
+			return names[c];
+		}
+
+		//! Initialize necessary variables.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Initialize(const Snapshot& snapshot) override
+		{
+			using std::to_string;
+
+			auto n = atomids_.size();
+
+			// Make sure atom ID's are on at least one processor.
+			std::vector<int> found(n, 0);
+			for(size_t i = 0; i < n; ++i)
+			{
+				if(snapshot.GetLocalIndex(atomids_[i]) != -1)
+					found[i] = 1;
+			}
+
+			MPI_Allreduce(MPI_IN_PLACE, found.data(), n, MPI_INT, MPI_SUM, snapshot.GetCommunicator());
+			unsigned ntot = std::accumulate(found.begin(), found.end(), 0, std::plus<int>());
+			if(ntot != n)
+				throw BuildException({
+					"BondOrderCV: Expected to find " +
+					to_string(n) +
+					" atoms, but only found " +
+					to_string(ntot) + "."
+				});
+		}
+
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
+
+		//! Evaluate the CV.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Evaluate(const Snapshot& snapshot) override
+		{
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return One round to collect the positions.
+		 */
+		int GetCommStages() const override { return 1; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			auto n = atomids_.size();
+
+			if(stage == 0)
+			{
+				// Collect the positions on all processors, each atom in
+				// its slot within the group.
+				const auto& positions = snapshot.GetPositions();
+				handle_ = plan.ReserveSum(3*n);
+				auto* pos = plan.Local(handle_);
+				idx_.resize(n);
+				for(size_t i = 0; i < n; ++i)
+				{
+					idx_[i] = snapshot.GetLocalIndex(atomids_[i]);
+					if(idx_[i] != -1)
+					{
+						auto& p = positions[idx_[i]];
+						pos[3*i+0] = p[0];
+						pos[3*i+1] = p[1];
+						pos[3*i+2] = p[2];
+					}
+				}
+				return;
+			}
+
+			auto* gpos = plan.Result(handle_);
+			pos_.resize(n);
+			for(size_t i = 0; i < n; ++i)
+				pos_[i] = {gpos[3*i], gpos[3*i+1], gpos[3*i+2]};
+
+			ClearComponents(snapshot.GetNumAtoms());
+			Pairs(snapshot);
+			if(d4_.used)
+				Local(d4_, IsEnabled(aq4));
+			if(d6_.used)
+				Local(d6_, IsEnabled(aq6));
+
+			// Every processor visits all pairs, so only one of them
+			// contributes to the box gradient.
+			bool box = snapshot.GetCommunicator().rank() == 0;
+			for(size_t c = 0; c < GetNumComponents(); ++c)
+			{
+				if(!IsEnabled(c))
+					continue;
+
+				ClearAdjoints();
+				switch(c)
+				{
+					case Q4:
+						cvals_[c] = Global(d4_);
+						break;
+					case Q6:
+						cvals_[c] = Global(d6_);
+						break;
+					case q4:
+						cvals_[c] = MeanLocal(d4_);
+						break;
+					case q6:
+						cvals_[c] = MeanLocal(d6_);
+						break;
+					case aq4:
+						cvals_[c] = MeanAveraged(d4_);
+						break;
+					case aq6:
+						cvals_[c] = MeanAveraged(d6_);
+						break;
+					case nsolid:
+						cvals_[c] = Solid();
+						SolidAdjoints();
+						break;
+					case density:
+						for(size_t i = 0; i < n; ++i)
+						{
+							cvals_[c] += nb_[i]/n;
+							barN_[i] = 1./n;
+						}
+						break;
+				}
+
+				Backpropagate(c, box);
+			}
+
+			SelectComponent();
+		}
+
+		//! Serialize a single component for restart purposes.
+		/*!
+		 * \param c Component.
+		 * \param json JSON value
+		 */
+		void SerializeComponent(size_t c, Json::Value& json) const override
+		{
+			json["type"] = "BondOrder";
+
+			for(auto& id : atomids_)
+				json["atom_ids"].append(id);
+
+			sf_.Serialize(json["switching"]);
+			json["skin"] = nlist_.GetSkin();
+			json["bond_threshold"] = dthresh_;
+			json["bond_width"] = dwidth_;
+			json["solid_threshold"] = nthresh_;
+			json["solid_width"] = nwidth_;
+
+			for(auto& bound: bounds_)
+				json["bounds"].append(bound);
+
+			json["component"] = GetComponentName(c);
+		}
+	};
+}
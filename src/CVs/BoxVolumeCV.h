@@ -41,6 +41,15 @@ namespace SSAGES
         {
         }
 
+        //! Get the IDs of the atoms the CV depends on.
+        /*!
+         * \return \c TRUE, the box volume depends on no atom.
+         */
+        bool GetAtomSet(Label&) const override
+        {
+            return true;
+        }
+
         //! Evaluate the CV. 
         /*!
          * \param snapshot Current simulation snapshot.
@@ -49,8 +58,7 @@ namespace SSAGES
         {
             // Fill empty gradient. 
 			auto n = snapshot.GetNumAtoms();
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
+			ClearGradient(n);
 
             val_ = snapshot.GetVolume();
             if(snapshot.GetCommunicator().rank() == 0)
@@ -22,6 +22,7 @@
 
 #include "CollectiveVariable.h"
 #include "json/json.h"
+#include <algorithm>
 #include "schema.h"
 #include "../Drivers/DriverException.h"
 #include "../Validator/ObjectRequirement.h"
@@ -33,9 +34,13 @@
 #include "AngleCV.h"
 #include "GyrationTensorCV.h"
 #include "RMSDCV.h"
+#include "PathCV.h"
 #include "RouseModeCV.h"
+#include "MultiCollectiveVariable.h"
 #include "CoordinationNumberCV.h"
+#include "BondOrderCV.h"
 #include "BoxVolumeCV.h"
+#include "CombinationCV.h"
 
 using namespace Json;
 
@@ -206,25 +211,26 @@ namespace SSAGES
 			for(auto& s : json["atom_ids"])
 				atomids.push_back(s.asInt());
 
-			GyrationTensor component = Rg;
-			auto comp = json["component"].asString();
-			
-			if(comp == "Rg")
-				component = Rg; 
-			else if(comp == "principal1")
-				component = principal1;
-			else if(comp == "principal2")
-				component = principal2;
-			else if(comp == "principal3")
-				component = principal3;
-			else if(comp == "asphericity")
-				component = asphericity;
-			else if(comp == "acylindricity")
-				component = acylindricity;
-			else if(comp == "shapeaniso")
-				component = shapeaniso;
-
-			auto* c = new GyrationTensorCV(atomids, component);
+			// Components by name. The first one is the value of the CV,
+			// the others are added as views by the list builder.
+			std::vector<std::string> names;
+			if(json.isMember("component"))
+				names.push_back(json["component"].asString());
+			for(auto& s : json["components"])
+				names.push_back(s.asString());
+
+			if(names.empty())
+				throw BuildException({path + ": At least one of \"component\" or \"components\" must be specified."});
+
+			const std::vector<std::string> all = {
+				"Rg", "principal1", "principal2", "principal3", 
+				"asphericity", "acylindricity", "shapeaniso"
+			};
+			std::vector<size_t> components;
+			for(auto& name : names)
+				components.push_back(std::find(all.begin(), all.end(), name) - all.begin());
+
+			auto* c = new GyrationTensorCV(atomids, components);
 			cv = static_cast<CollectiveVariable*>(c);
 		}
 		else if(type == "RMSD")
@@ -240,12 +246,49 @@ namespace SSAGES
 			std::vector<int> atomids;
 			for(auto& s : json["atom ids"])
 				atomids.push_back(s.asInt());
-			auto reference = json.get("reference"," ").asString(); 
 
-			auto* c = new RMSDCV(atomids, reference, json.get("use_range", false).asBool());
+			std::vector<std::string> references;
+			if(json.isMember("reference"))
+				references.push_back(json["reference"].asString());
+			for(auto& s : json["references"])
+				references.push_back(s.asString());
+
+			if(references.empty())
+				throw BuildException({path + ": At least one of \"reference\" or \"references\" must be specified."});
+
+			auto* c = new RMSDCV(atomids, references, json.get("use_range", false).asBool());
 			
 			cv = static_cast<CollectiveVariable*>(c);
 		}
+		else if(type == "Path")
+		{
+			reader.parse(JsonSchema::PathCV, schema);
+			validator.Parse(schema, path);
+
+			// Validate inputs.
+			validator.Validate(json, path);
+			if(validator.HasErrors())
+				throw BuildException(validator.GetErrors());
+
+			std::vector<int> atomids;
+			for(auto& s : json["atom ids"])
+				atomids.push_back(s.asInt());
+
+			std::vector<std::string> frames;
+			for(auto& s : json["frames"])
+				frames.push_back(s.asString());
+
+			auto component = json.get("component", "s").asString() == "z" ? PathDistance : PathProgress;
+
+			auto* c = new PathCV(
+				atomids, frames, 
+				json["lambda"].asDouble(), 
+				component, 
+				json.get("neighbors", 0).asUInt(), 
+				json.get("refresh", 100).asUInt()
+			);
+			cv = static_cast<CollectiveVariable*>(c);
+		}
 		else if(type == "RouseMode")
 		{
 			reader.parse(JsonSchema::RouseModeCV, schema);
@@ -263,9 +306,16 @@ namespace SSAGES
 					groups.back().push_back(id.asInt());
 				}
 			}
-			auto mode = json.get("mode",0).asInt();
+			std::vector<size_t> modes;
+			if(json.isMember("mode"))
+				modes.push_back(json["mode"].asUInt());
+			for(auto& m : json["modes"])
+				modes.push_back(m.asUInt());
+
+			if(modes.empty())
+				throw BuildException({path + ": At least one of \"mode\" or \"modes\" must be specified."});
 
-			auto* c = new RouseModeCV( groups, mode);
+			auto* c = new RouseModeCV( groups, modes);
 			
 			cv = static_cast<CollectiveVariable*>(c);
 		}
@@ -287,7 +337,54 @@ namespace SSAGES
 			for(auto& s : json["group2"])
 				group2.push_back(s.asInt());
 			
-			auto* c = new CoordinationNumberCV(group1, group2, SwitchingFunction::Build(json["switching"]));
+			auto* c = new CoordinationNumberCV(
+				group1, group2, 
+				SwitchingFunction::Build(json["switching"]), 
+				json.get("skin", 0).asDouble()
+			);
+			cv = static_cast<CollectiveVariable*>(c);
+		}
+		else if(type == "BondOrder")
+		{
+			reader.parse(JsonSchema::BondOrderCV, schema);
+			validator.Parse(schema, path);
+
+			// Validate inputs.
+			validator.Validate(json, path);
+			if(validator.HasErrors())
+				throw BuildException(validator.GetErrors());
+
+			std::vector<int> atomids;
+			for(auto& s : json["atom_ids"])
+				atomids.push_back(s.asInt());
+
+			// Components by name, as for the gyration tensor.
+			std::vector<std::string> names;
+			if(json.isMember("component"))
+				names.push_back(json["component"].asString());
+			for(auto& s : json["components"])
+				names.push_back(s.asString());
+
+			if(names.empty())
+				throw BuildException({path + ": At least one of \"component\" or \"components\" must be specified."});
+
+			const std::vector<std::string> all = {
+				"Q4", "Q6", "q4", "q6", "aq4", "aq6", "nsolid", "density"
+			};
+			std::vector<size_t> components;
+			for(auto& name : names)
+				components.push_back(std::find(all.begin(), all.end(), name) - all.begin());
+
+			auto* c = new BondOrderCV(
+				atomids, 
+				SwitchingFunction::Build(json["switching"]), 
+				components,
+				json.get("skin", 0).asDouble(),
+				json.get("bond_threshold", 0.7).asDouble(),
+				json.get("bond_width", 0.05).asDouble(),
+				json.get("solid_threshold", 6.5).asDouble(),
+				json.get("solid_width", 0.25).asDouble()
+			);
 			cv = static_cast<CollectiveVariable*>(c);
 		}
 		else if(type == "BoxVolume")
@@ -303,11 +400,65 @@ namespace SSAGES
 			auto* c = new BoxVolumeCV();
 			cv = static_cast<CollectiveVariable*>(c);
 		}
+		else if(type == "Combination")
+		{
+			reader.parse(JsonSchema::CombinationCV, schema);
+			validator.Parse(schema, path);
+
+			// Validate inputs.
+			validator.Validate(json, path);
+			if(validator.HasErrors())
+				throw BuildException(validator.GetErrors());
+
+			auto form = json["form"].asString();
+			auto ncvs = json["cvs"].size();
+			if(form == "quotient" && ncvs != 2)
+				throw BuildException({path + ": A quotient requires exactly two CVs."});
+			if(form == "polynomial" && ncvs != 1)
+				throw BuildException({path + ": A polynomial requires exactly one CV."});
+
+			std::vector<double> coeffs;
+			for(auto& c : json["coefficients"])
+				coeffs.push_back(c.asDouble());
+
+			if(form == "linear" && coeffs.empty())
+				coeffs.assign(ncvs, 1.);
+			if(form == "linear" && coeffs.size() != ncvs)
+				throw BuildException({path + ": Expected one coefficient per CV."});
+			if(form == "polynomial" && coeffs.empty())
+				throw BuildException({path + ": A polynomial requires coefficients."});
+
+			// The combination owns its CVs.
+			CVList cvs;
+			try
+			{
+				for(size_t i = 0; i < ncvs; ++i)
+					cvs.push_back(BuildCV(json["cvs"][static_cast<int>(i)], path + "/cvs/" + std::to_string(i)));
+			}
+			catch(...)
+			{
+				for(auto& c : cvs)
+					delete c;
+				throw;
+			}
+
+			auto scale = json.get("scale", 1.).asDouble();
+			if(form == "linear")
+				cv = new CombinationCV<LinearForm>(cvs, {coeffs, json.get("constant", 0.).asDouble()});
+			else if(form == "product")
+				cv = new CombinationCV<ProductForm>(cvs, {scale});
+			else if(form == "quotient")
+				cv = new CombinationCV<QuotientForm>(cvs, {scale});
+			else
+				cv = new CombinationCV<PolynomialForm>(cvs, {coeffs});
+		}
 		else
 		{
 			throw BuildException({path + ": Unknown CV type specified."+type+" is not a valid type!"});
 		}
 
+		cv->SetStride(json.get("stride", 1).asUInt(), json.get("impulse", true).asBool());
+
 		return cv;
 	}
 
@@ -331,7 +482,20 @@ namespace SSAGES
 		int i = 0;
 		for(auto& m : json)
 		{
-			cvlist.push_back(BuildCV(m, path + "/" + std::to_string(i)));
+			auto* cv = BuildCV(m, path + "/" + std::to_string(i));
+			cvlist.push_back(cv);
+
+			// Further components of multi-output CVs follow as views.
+			if(auto* multi = dynamic_cast<MultiCollectiveVariable*>(cv))
+			{
+				const auto& components = multi->GetComponents();
+				for(size_t j = 1; j < components.size(); ++j)
+				{
+					auto* view = new ComponentCV(multi, components[j]);
+					view->SetStride(multi->GetStride(), multi->IsImpulse());
+					cvlist.push_back(view);
+				}
+			}
 			++i;
 		}
 	}
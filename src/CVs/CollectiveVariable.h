@@ -23,7 +23,10 @@
 
 #include "../Snapshot.h"
 #include "../JSON/Serializable.h"
+#include "../Utility/CommPlan.h"
+#include "../Utility/ExpressionCache.h"
 #include "types.h"
+#include <algorithm>
 #include <vector>
 
 // Forward declare.
@@ -33,15 +36,253 @@ namespace Json {
 
 namespace SSAGES
 {
+	//! Sparse gradient of a collective variable.
+	/*!
+	 * \ingroup CVs
+	 *
+	 * Holds dCV/dxi only for the local atoms a CV depends on, stored as 
+	 * parallel lists of local atom indices and gradient vectors. An atom 
+	 * may appear more than once, in which case its entries add up.
+	 */
+	struct SparseGradient
+	{
+		//! Local atom indices.
+		Label indices;
+
+		//! Gradient dCV/dxi of each entry.
+		std::vector<Vector3> values;
+
+		//! Number of entries.
+		size_t size() const { return indices.size(); }
+
+		//! Remove all entries, keeping the allocated storage.
+		void clear()
+		{
+			indices.clear();
+			values.clear();
+		}
+
+		//! Append an entry.
+		/*!
+		 * \param idx Local atom index.
+		 * \param grad Gradient with respect to that atom.
+		 */
+		void push_back(int idx, const Vector3& grad)
+		{
+			indices.push_back(idx);
+			values.push_back(grad);
+		}
+	};
+
+	//! Center of mass of a group of atoms, evaluated in CommPlan stages.
+	/*!
+	 * \ingroup CVs
+	 *
+	 * Splits Snapshot::CenterOfMass() into two communication rounds so
+	 * CVs can batch them with other collectives. Stage(0) reserves the
+	 * reference gather, Stage(1) the reduction of the mass weighted sums,
+	 * and Stage(2) reads the result.
+	 *
+	 * When the group is given by atom IDs and the snapshot has an 
+	 * ExpressionCache attached, the center of mass is requested from the 
+	 * cache instead, so CVs over the same group share one computation.
+	 */
+	struct GroupCenterOfMass
+	{
+		//! Local indices of the group atoms. Set before Stage(0).
+		Label indices;
+
+		//! Cache record of the group, or null if computed here.
+		const ExpressionCache::Group* cached = nullptr;
+
+		//! Unwrapping reference.
+		Vector3 ref;
+
+		//! Center of mass, valid after Stage(2).
+		Vector3 com;
+
+		//! Total mass, valid after Stage(2).
+		double mass;
+
+		//! Pending CommPlan segment.
+		size_t handle;
+
+		//! Perform a stage of the center of mass computation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage (0-2).
+		 * \param plan Communication plan.
+		 */
+		void Stage(const Snapshot& snapshot, int stage, CommPlan& plan)
+		{
+			cached = nullptr;
+			if(stage == 0)
+			{
+				handle = plan.ReserveGather(4);
+				snapshot.GetGroupReference(indices, plan.Local(handle));
+			}
+			else if(stage == 1)
+			{
+				ref = snapshot.SelectGroupReference(plan.Result(handle));
+				handle = plan.ReserveSum(4);
+				snapshot.GetGroupSums(indices, ref, plan.Local(handle));
+			}
+			else
+			{
+				auto* sums = plan.Result(handle);
+				mass = sums[3];
+				com = ref;
+				if(mass != 0)
+					com += Vector3{sums[0], sums[1], sums[2]}/mass;
+			}
+		}
+
+		//! Perform a stage of the center of mass computation of atom IDs.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param ids Atom IDs of the group.
+		 * \param stage Stage (0-2).
+		 * \param plan Communication plan.
+		 *
+		 * Looks up the local indices in Stage(0), then proceeds as above.
+		 */
+		void Stage(const Snapshot& snapshot, const Label& ids, int stage, CommPlan& plan)
+		{
+			auto* cache = snapshot.GetCache();
+			if(stage == 0)
+			{
+				if(cache)
+				{
+					cached = cache->RequestCenterOfMass(snapshot, ids);
+					indices = cached->indices;
+					return;
+				}
+
+				indices.clear();
+				snapshot.GetLocalIndices(ids, &indices);
+			}
+
+			if(!cached)
+				return Stage(snapshot, stage, plan);
+
+			if(stage == 2)
+			{
+				com = cached->com;
+				mass = cached->mass;
+			}
+		}
+	};
+
+	//! Centers of mass of several groups of atoms, evaluated in CommPlan stages.
+	/*!
+	 * \ingroup CVs
+	 *
+	 * Staged form of Snapshot::CentersOfMass(). All groups share one
+	 * reduction for the unwrapping references and one for the mass
+	 * weighted sums. The local indices are cached and only looked up
+	 * again when the snapshot index map changes.
+	 */
+	struct GroupCentersOfMass
+	{
+		//! Atom IDs of each group.
+		std::vector<Label> groups;
+
+		//! Local indices of each group, valid after Stage(0).
+		std::vector<Label> indices;
+
+		//! Local anchor index of each group, valid after Stage(0).
+		Label anchors;
+
+		//! Index map version the indices were looked up at.
+		size_t version = 0;
+
+		//! \c TRUE once the indices have been looked up.
+		bool cached = false;
+
+		//! Centers of mass, valid after Stage(2).
+		std::vector<Vector3> coms;
+
+		//! Total masses, valid after Stage(2).
+		std::vector<double> masses;
+
+		//! Pending CommPlan segment.
+		size_t handle = 0;
+
+		//! Perform a stage of the center of mass computation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage (0-2).
+		 * \param plan Communication plan.
+		 */
+		void Stage(const Snapshot& snapshot, int stage, CommPlan& plan)
+		{
+			auto ngroups = groups.size();
+			if(stage == 0)
+			{
+				auto v = snapshot.GetIndexMapVersion();
+				if(!cached || v != version)
+				{
+					snapshot.GetGroupIndices(groups, &indices, &anchors);
+					version = v;
+					cached = true;
+				}
+
+				handle = plan.ReserveSum(4*ngroups);
+				auto* slots = plan.Local(handle);
+				for(size_t i = 0; i < ngroups; ++i)
+					snapshot.GetAnchorReference(anchors[i], slots + 4*i);
+			}
+			else if(stage == 1)
+			{
+				coms.resize(ngroups);
+				auto* slots = plan.Result(handle);
+				for(size_t i = 0; i < ngroups; ++i)
+					coms[i] = Snapshot::SelectAnchorReference(slots + 4*i);
+
+				handle = plan.ReserveSum(4*ngroups);
+				auto* sums = plan.Local(handle);
+				for(size_t i = 0; i < ngroups; ++i)
+					snapshot.GetGroupSums(indices[i], coms[i], sums + 4*i);
+			}
+			else
+			{
+				masses.resize(ngroups);
+				auto* sums = plan.Result(handle);
+				for(size_t i = 0; i < ngroups; ++i, sums += 4)
+				{
+					masses[i] = sums[3];
+					if(masses[i] != 0)
+						coms[i] += Vector3{sums[0], sums[1], sums[2]}/masses[i];
+				}
+			}
+		}
+	};
+
 	//! Abstract class for a collective variable.
 	/*!
 	 * \ingroup CVs
 	 */
 	class CollectiveVariable: public Serializable
 	{
+	private:
+		//! Dense gradient, built on demand from the sparse gradient.
+		mutable std::vector<Vector3> grad_;
+
+		//! \c TRUE if the dense gradient is out of date.
+		mutable bool gradstale_;
+
+		//! Number of local atoms the gradient refers to.
+		size_t natoms_;
+
+		//! Number of steps between evaluations.
+		unsigned int stride_;
+
+		//! \c TRUE if biases are scaled by the stride.
+		bool impulse_;
+
 	protected:
-		//! Gradient vector dCv/dxi.
-		std::vector<Vector3> grad_;
+		//! Sparse gradient dCv/dxi.
+		SparseGradient sgrad_;
 
 		//! Gradient w.r.t box vectors dCv/dHij.
 		Matrix3 boxgrad_;
@@ -51,10 +292,63 @@ namespace SSAGES
 
 		//! Bounds on CV.
 		std::array<double, 2> bounds_;		
+
+		//! Clear the gradient ahead of an evaluation.
+		/*!
+		 * \param natoms Number of local atoms in the snapshot.
+		 *
+		 * Removes all gradient entries. Atoms that do not receive an entry 
+		 * through AddGradient() have a zero gradient.
+		 */
+		void ClearGradient(size_t natoms)
+		{
+			sgrad_.clear();
+			natoms_ = natoms;
+			gradstale_ = true;
+		}
+
+		//! Add a gradient contribution for a local atom.
+		/*!
+		 * \param idx Local atom index.
+		 * \param grad Contribution to dCv/dxi of that atom.
+		 */
+		void AddGradient(int idx, const Vector3& grad)
+		{
+			sgrad_.push_back(idx, grad);
+		}
+
+		//! Evaluate the CV stage by stage with a private CommPlan.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 *
+		 * Staged CVs implement Evaluate() through this function so they 
+		 * can also be evaluated on their own. The rounds of an attached 
+		 * ExpressionCache are run along with the plan.
+		 */
+		void EvaluateStaged(const Snapshot& snapshot)
+		{
+			CommPlan plan(snapshot.GetCommunicator());
+			auto* cache = snapshot.GetCache();
+			auto nstages = GetCommStages();
+			for(int s = 0; s <= nstages; ++s)
+			{
+				EvaluateStage(snapshot, s, plan);
+				if(s == nstages)
+					break;
+
+				if(cache)
+					cache->Prepare(snapshot, plan);
+				plan.Execute();
+				if(cache)
+					cache->Complete(plan);
+			}
+		}
+
 	public:
 		//! Constructor.
 		CollectiveVariable() : 
-		grad_(0), boxgrad_(Matrix3::Zero()), val_(0), bounds_{{0,0}}
+		grad_(0), gradstale_(false), natoms_(0), stride_(1), impulse_(true),
+		sgrad_(), boxgrad_(Matrix3::Zero()), val_(0), bounds_{{0,0}}
 		{}
 
 		//! Destructor.
@@ -78,6 +372,106 @@ namespace SSAGES
 		 */
 		virtual void Evaluate(const Snapshot& snapshot) = 0;
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c FALSE if the CV may depend on any atom.
+		 *
+		 * Called after Initialize(). Hooks use the combined set of all CVs 
+		 * to synchronize only the atoms that matter. A CV which returns 
+		 * \c FALSE forces synchronization of all atoms.
+		 */
+		virtual bool GetAtomSet(Label& /*ids*/) const { return false; }
+
+		//! Get the CV which performs the evaluation of this CV.
+		/*!
+		 * \return CV to evaluate in place of this one.
+		 *
+		 * Views on a component of a multi-output CV return the CV they 
+		 * view. The Hook evaluates every source once and then calls 
+		 * Collect() on all CVs.
+		 */
+		virtual CollectiveVariable* GetSource() { return this; }
+
+		//! Update the CV after its source has been evaluated.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		virtual void Collect(const Snapshot& /*snapshot*/) {}
+
+		//! Get the number of communication rounds of a staged evaluation.
+		/*!
+		 * \return Number of rounds, or zero if the CV is not staged.
+		 *
+		 * CVs which need collectives can split their evaluation into 
+		 * stages separated by CommPlan rounds. This lets the Hook fuse 
+		 * the communication of all CVs into one collective per round. 
+		 * CVs returning zero are evaluated through Evaluate().
+		 */
+		virtual int GetCommStages() const { return 0; }
+
+		//! Perform one stage of a staged evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage, from zero to GetCommStages().
+		 * \param plan Communication plan shared by all CVs.
+		 *
+		 * Stage s reads the results of the segments reserved in stage s-1 
+		 * and reserves the segments for the next round. The last stage 
+		 * only reads results and completes value and gradient.
+		 */
+		virtual void EvaluateStage(const Snapshot& /*snapshot*/, int /*stage*/, CommPlan& /*plan*/) {}
+
+		//! Set the evaluation stride.
+		/*!
+		 * \param stride Number of steps between evaluations.
+		 * \param impulse If \c TRUE, biases are scaled by the stride.
+		 *
+		 * Expensive CVs can be evaluated and biased only every few steps. 
+		 * With impulse scaling the bias force is multiplied by the stride 
+		 * on those steps, so the time-averaged force is unchanged. On all 
+		 * other steps the CV keeps its last value and is not biased.
+		 */
+		void SetStride(unsigned int stride, bool impulse = true)
+		{
+			stride_ = std::max(stride, 1u);
+			impulse_ = impulse;
+		}
+
+		//! Get the evaluation stride.
+		unsigned int GetStride() const { return stride_; }
+
+		//! Check whether biases are scaled by the stride.
+		bool IsImpulse() const { return impulse_; }
+
+		//! Check whether the CV is evaluated at an iteration.
+		/*!
+		 * \param iteration Current iteration.
+		 * \return \c TRUE if the iteration is a multiple of the stride.
+		 */
+		bool IsDue(int iteration) const { return iteration % static_cast<int>(stride_) == 0; }
+
+		//! Get the factor applied to biases of the CV.
+		/*!
+		 * \return Stride for impulse scaling, one otherwise.
+		 */
+		double GetBiasScale() const { return impulse_ ? stride_ : 1.; }
+
+		//! Serialize the evaluation stride.
+		/*!
+		 * \param json JSON value of the CV.
+		 *
+		 * Nothing is written for CVs evaluated every step.
+		 */
+		void SerializeStride(Json::Value& json) const
+		{
+			if(stride_ == 1)
+				return;
+
+			json["stride"] = stride_;
+			json["impulse"] = impulse_;
+		}
+
 		//! Get current value of the CV.
 		/*!
 		 * \return Current value of the CV.
@@ -117,17 +511,42 @@ namespace SSAGES
 			return location;
 		}
 
+		//! Get current sparse gradient of the CV.
+		/*!
+		 * \return Sparse per-atom gradient of the CV.
+		 *
+		 * Returns the non-zero entries of the CV gradient as local atom 
+		 * indices and dCV/dxi. Methods should prefer this over 
+		 * CollectiveVariable::GetGradient(), since its size only depends on 
+		 * the number of atoms involved in the CV.
+		 */
+		const SparseGradient& GetSparseGradient() const
+		{
+			return sgrad_;
+		}
+
 		//! Get current gradient of the CV.
 		/*!
 		 * \return Per-atom gradient of the CV.
 		 *
-		 * Returns the current value of the CV gradient. This should be an n
+		 * Returns the current value of the CV gradient. This is an n
 		 * length vector, where n is the number of atoms in the snapshot. Each
 		 * element in the vector is the derivative of the CV with respect to
 		 * the atom's coordinate (dCV/dxi).
+		 *
+		 * \note The dense gradient is assembled from the sparse gradient on 
+		 *       first access after an evaluation, which costs O(n).
 		 */
 		const std::vector<Vector3>& GetGradient() const
 		{
+			if(gradstale_)
+			{
+				grad_.assign(natoms_, Vector3{0,0,0});
+				for(size_t i = 0; i < sgrad_.size(); ++i)
+					grad_[sgrad_.indices[i]] += sgrad_.values[i];
+				gradstale_ = false;
+			}
+
 			return grad_;
 		}
 
@@ -0,0 +1,382 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "CollectiveVariable.h"
+#include "../Drivers/DriverException.h"
+#include <algorithm>
+
+namespace SSAGES
+{
+	//! Linear combination \f$ f = c_0 + \sum_i c_i x_i \f$ of CVs.
+	struct LinearForm
+	{
+		std::vector<double> coeffs; //!< Coefficient of each CV.
+		double constant; //!< Constant offset.
+
+		//! Name of the form.
+		static const char* Name() { return "linear"; }
+
+		//! Evaluate the form and its partial derivatives.
+		/*!
+		 * \param x Values of the CVs.
+		 * \param dfdx Partial derivatives, set on return.
+		 * \return Value of the form.
+		 */
+		double Evaluate(const std::vector<double>& x, std::vector<double>& dfdx) const
+		{
+			double f = constant;
+			for(size_t i = 0; i < x.size(); ++i)
+			{
+				f += coeffs[i]*x[i];
+				dfdx[i] = coeffs[i];
+			}
+			return f;
+		}
+
+		//! Serialize the parameters.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const
+		{
+			for(auto& c : coeffs)
+				json["coefficients"].append(c);
+			json["constant"] = constant;
+		}
+	};
+
+	//! Product \f$ f = a \prod_i x_i \f$ of CVs.
+	struct ProductForm
+	{
+		double scale; //!< Prefactor.
+
+		//! Name of the form.
+		static const char* Name() { return "product"; }
+
+		//! Evaluate the form and its partial derivatives.
+		/*!
+		 * \param x Values of the CVs.
+		 * \param dfdx Partial derivatives, set on return.
+		 * \return Value of the form.
+		 *
+		 * Derivatives are built from prefix and suffix products, so they
+		 * remain correct when a factor is zero.
+		 */
+		double Evaluate(const std::vector<double>& x, std::vector<double>& dfdx) const
+		{
+			auto n = x.size();
+			double p = scale;
+			for(size_t i = 0; i < n; ++i)
+			{
+				dfdx[i] = p;
+				p *= x[i];
+			}
+
+			double s = 1.;
+			for(size_t i = n; i-- > 0;)
+			{
+				dfdx[i] *= s;
+				s *= x[i];
+			}
+			return p;
+		}
+
+		//! Serialize the parameters.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const
+		{
+			json["scale"] = scale;
+		}
+	};
+
+	//! Quotient \f$ f = a x_0 / x_1 \f$ of two CVs.
+	struct QuotientForm
+	{
+		double scale; //!< Prefactor.
+
+		//! Name of the form.
+		static const char* Name() { return "quotient"; }
+
+		//! Evaluate the form and its partial derivatives.
+		/*!
+		 * \param x Values of the CVs.
+		 * \param dfdx Partial derivatives, set on return.
+		 * \return Value of the form.
+		 */
+		double Evaluate(const std::vector<double>& x, std::vector<double>& dfdx) const
+		{
+			auto inv = 1./x[1];
+			auto f = scale*x[0]*inv;
+			dfdx[0] = scale*inv;
+			dfdx[1] = -f*inv;
+			return f;
+		}
+
+		//! Serialize the parameters.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const
+		{
+			json["scale"] = scale;
+		}
+	};
+
+	//! Polynomial \f$ f = \sum_k a_k x^k \f$ of a single CV.
+	struct PolynomialForm
+	{
+		std::vector<double> coeffs; //!< Coefficients, lowest order first.
+
+		//! Name of the form.
+		static const char* Name() { return "polynomial"; }
+
+		//! Evaluate the form and its partial derivatives.
+		/*!
+		 * \param x Values of the CVs.
+		 * \param dfdx Partial derivatives, set on return.
+		 * \return Value of the form.
+		 *
+		 * Value and derivative are obtained in one Horner pass.
+		 */
+		double Evaluate(const std::vector<double>& x, std::vector<double>& dfdx) const
+		{
+			double f = 0, df = 0;
+			for(size_t k = coeffs.size(); k-- > 0;)
+			{
+				df = df*x[0] + f;
+				f = f*x[0] + coeffs[k];
+			}
+			dfdx[0] = df;
+			return f;
+		}
+
+		//! Serialize the parameters.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const
+		{
+			for(auto& c : coeffs)
+				json["coefficients"].append(c);
+		}
+	};
+
+	//! Collective variable combining other CVs algebraically.
+	/*!
+	 * \ingroup CVs
+	 *
+	 * The combination owns its CVs and evaluates them as part of its own
+	 * evaluation. If all of them are staged, their stages are forwarded,
+	 * so the combination costs no extra communication rounds. The value
+	 * and gradient follow from the chain rule,
+	 * \f$ \nabla f = \sum_i \partial f / \partial x_i \nabla x_i \f$,
+	 * assembled into a single sparse gradient.
+	 *
+	 * The algebraic form is supplied by CombinationCV.
+	 */
+	class CombinationCVBase : public CollectiveVariable
+	{
+	private:
+		//! Number of communication rounds, zero if a CV is not staged.
+		int nstages_;
+
+		//! Evaluate the form.
+		/*!
+		 * \return Value of the form at x_, with partial derivatives in dfdx_.
+		 */
+		virtual double EvaluateForm() = 0;
+
+		//! Combine values and gradients of the evaluated CVs.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Combine(const Snapshot& snapshot)
+		{
+			for(size_t i = 0; i < cvs_.size(); ++i)
+				x_[i] = cvs_[i]->GetValue();
+
+			val_ = EvaluateForm();
+
+			ClearGradient(snapshot.GetNumAtoms());
+			boxgrad_ = Matrix3::Zero();
+			for(size_t i = 0; i < cvs_.size(); ++i)
+			{
+				auto w = dfdx_[i];
+				if(w == 0)
+					continue;
+
+				const auto& g = cvs_[i]->GetSparseGradient();
+				for(size_t j = 0; j < g.size(); ++j)
+					AddGradient(g.indices[j], w*g.values[j]);
+				boxgrad_ += w*cvs_[i]->GetBoxGradient();
+			}
+		}
+
+	protected:
+		//! Combined CVs, owned by the combination.
+		CVList cvs_;
+
+		//! Values of the CVs.
+		std::vector<double> x_;
+
+		//! Partial derivatives of the form.
+		std::vector<double> dfdx_;
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param cvs CVs to combine. Ownership is transferred.
+		 */
+		CombinationCVBase(const CVList& cvs) :
+		nstages_(0), cvs_(cvs), x_(cvs.size(), 0), dfdx_(cvs.size(), 0)
+		{
+			for(auto& cv : cvs_)
+				nstages_ = std::max(nstages_, cv->GetCommStages());
+
+			for(auto& cv : cvs_)
+				if(cv->GetCommStages() == 0)
+					nstages_ = 0;
+		}
+
+		//! Initialize the combined CVs.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Initialize(const Snapshot& snapshot) override
+		{
+			for(auto& cv : cvs_)
+				cv->Initialize(snapshot);
+		}
+
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c FALSE if any combined CV may depend on any atom.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			bool known = true;
+			for(auto& cv : cvs_)
+				known = cv->GetAtomSet(ids) && known;
+			return known;
+		}
+
+		//! Evaluate the CV.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Evaluate(const Snapshot& snapshot) override
+		{
+			if(nstages_)
+				return EvaluateStaged(snapshot);
+
+			for(auto& cv : cvs_)
+				cv->Evaluate(snapshot);
+			Combine(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Largest number of rounds of the combined CVs, or zero
+		 *         if any of them is not staged.
+		 */
+		int GetCommStages() const override { return nstages_; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			for(auto& cv : cvs_)
+				if(stage <= cv->GetCommStages())
+					cv->EvaluateStage(snapshot, stage, plan);
+
+			if(stage == nstages_)
+				Combine(snapshot);
+		}
+
+		//! Get the combined CVs.
+		const CVList& GetCVs() const { return cvs_; }
+
+		//! Destructor.
+		virtual ~CombinationCVBase()
+		{
+			for(auto& cv : cvs_)
+				delete cv;
+		}
+	};
+
+	//! Collective variable combining other CVs through a given form.
+	/*!
+	 * \tparam Form Algebraic form, e.g. LinearForm or ProductForm.
+	 *
+	 * \ingroup CVs
+	 */
+	template<typename Form>
+	class CombinationCV : public CombinationCVBase
+	{
+	private:
+		//! Algebraic form.
+		Form form_;
+
+		//! \copydoc CombinationCVBase::EvaluateForm()
+		double EvaluateForm() override
+		{
+			return form_.Evaluate(x_, dfdx_);
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param cvs CVs to combine. Ownership is transferred.
+		 * \param form Algebraic form.
+		 */
+		CombinationCV(const CVList& cvs, const Form& form) :
+		CombinationCVBase(cvs), form_(form)
+		{}
+
+		//! Serialize this CV for restart purposes.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const override
+		{
+			json["type"] = "Combination";
+			json["form"] = Form::Name();
+			form_.Serialize(json);
+
+			for(auto& cv : cvs_)
+			{
+				Json::Value child;
+				cv->Serialize(child);
+				json["cvs"].append(child);
+			}
+
+			for(auto& bound : bounds_)
+				json["bounds"].append(bound);
+		}
+	};
+}
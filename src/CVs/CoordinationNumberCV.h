@@ -21,72 +21,21 @@
  #pragma once 
 
  #include "CVs/CollectiveVariable.h"
+ #include "CVs/SwitchingFunction.h"
  #include "Drivers/DriverException.h"
+ #include "Utility/NeighborList.h"
  
  namespace SSAGES
  {
-	class SwitchingFunction : public Serializable
-	{
-	private: 
-		double d0_; //!< Minimum linear shift value. 
-		double r0_; //!< Cutoff distance. 
-		int n_, m_; //!< Exponents of the switching function which controll the stiffness. 
-	public:
-		SwitchingFunction(double d0, double r0, int n, int m) : 
-		d0_(d0), r0_(r0), n_(n), m_(m) {}
-
-		//! Evaluate the switching function.
-		/*!
-		 * \param rij distance between two atoms. 
-		 * \param df Reference to variable which will store the gradient.
-		 * 
-		 * \return value of switching function. 
-		 */
-		double Evaluate(double rij, double& df) const
-		{
-			const auto xarg = (rij - d0_)/r0_;
-			const auto xn = std::pow(xarg, n_);
-			const auto xm = std::pow(xarg, m_);
-			const auto f = (1.-xn)/(1.-xm);
-			
-			df = f/(d0_-rij)*(n_*xn/(1.-xn)+m_*xm/(xm-1.));
-			return 	f;
-		}
-
-		//! Build SwitchingFunction from JSON value. 
-		/*!
-		 * \param json JSON value node. 
-		 * 
-		 * \return Pointer to new SwitchingFunction.
-		 */
-		static SwitchingFunction Build(const Json::Value& json)
-		{
-			return SwitchingFunction(
-			            json["d0"].asDouble(), 
-			            json["r0"].asDouble(), 
-						json["n"].asInt(), 
-						json["m"].asInt()
-					);
-		}
-
-		//! Serialize this CV for restart purposes.
-		/*!
-		 * \param json JSON value
-		 */
-		void Serialize(Json::Value& json) const override
-		{
-			json["d0"] = d0_;
-			json["r0"] = r0_;
-			json["n"] = n_;
-			json["m"] = m_;
-		}
-	};
-
     //! Collective variable on coordination number between two groups of atoms.
 	/*!
 	 * Collective variable on coordination number between two groups of atoms. 
      * To ensure a continuously differentiable function, there are various 
      * switching functions from which to choose from. 
+	 *
+	 * If the switching function is truncated, only pairs within its cutoff
+	 * are visited using a neighbor list. An optional Verlet skin allows the
+	 * list to be reused over several steps.
 	 *
 	 * \ingroup CVs
 	 */
@@ -97,17 +46,29 @@
 		Label group2_; //!< IDs of the second group of atoms. 
 		SwitchingFunction sf_; //!< Switching function used for coordination number.
 
+		Label idx1_; //!< Local indices of the first group.
+		Label slots1_; //!< Position within the first group of each local atom.
+		Label idx2_; //!< Local index of each atom in the second group, -1 if not local.
+		size_t handle_; //!< Pending CommPlan segment.
+
+		NeighborList nlist_; //!< Pairs within the switching function cutoff.
+		std::vector<Vector3> pos1_; //!< Positions of local first group atoms.
+		std::vector<Vector3> pos2_; //!< Positions of all second group atoms.
+
 	public:
 		//! Constructor.
 		/*!
 		 * \param group1 IDs of the first group of atoms. 
 		 * \param group2 IDs of the second group of atoms. 
+		 * \param sf Switching function.
+		 * \param skin Verlet skin of the neighbor list.
 		 *
 		 * Construct a CoordinationNumberCV.
 		 *
 		 */    
-		CoordinationNumberCV(const Label& group1, const Label& group2, SwitchingFunction&& sf) : 
-		group1_(group1), group2_(group2), sf_(sf)
+		CoordinationNumberCV(const Label& group1, const Label& group2, SwitchingFunction&& sf, double skin = 0) : 
+		group1_(group1), group2_(group2), sf_(sf), idx1_(), slots1_(), idx2_(), 
+		handle_(0), nlist_(sf_.GetCutoff(), skin), pos1_(), pos2_()
 		{
 		}
 
@@ -157,88 +118,173 @@
 				});			
 		}
 		
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), group1_.begin(), group1_.end());
+			ids.insert(ids.end(), group2_.begin(), group2_.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
 		{
-			// Get local atom indices.
-			std::vector<int> idx1, idx2;
-			snapshot.GetLocalIndices(group1_, &idx1);
-			snapshot.GetLocalIndices(group2_, &idx2);
-
-			// Get data from snapshot. 
-			auto n = snapshot.GetNumAtoms();
-			auto& atomids = snapshot.GetAtomIDs();
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return One round to collect the second group and one to sum the value.
+		 */
+		int GetCommStages() const override { return 2; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
 			auto& positions = snapshot.GetPositions();
+			auto n2 = group2_.size();
 
-			// Initialize gradient.
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
-			boxgrad_ = Matrix3::Zero();
-
-			// The nastiness begins. We essentially need to compute 
-			// pairwise distances between the atoms. For now, let's 
-			// gather the atomic coordinates of group2_
-			// on all relevant processors. Can be improved later. 
-			auto& comm = snapshot.GetCommunicator();
-			std::vector<int> pcounts(comm.size(), 0), icounts(comm.size(), 0); 
-			std::vector<int> pdispls(comm.size()+1, 0), idispls(comm.size()+1, 0); 
-			pcounts[comm.rank()] = 3*idx2.size();
-			icounts[comm.rank()] = idx2.size();
-
-			// Reduce counts.
-			MPI_Allreduce(MPI_IN_PLACE, pcounts.data(), pcounts.size(), MPI_INT, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, icounts.data(), icounts.size(), MPI_INT, MPI_SUM, comm);
-
-			std::partial_sum(pcounts.begin(), pcounts.end(), pdispls.begin() + 1);
-			std::partial_sum(icounts.begin(), icounts.end(), idispls.begin() + 1);
+			if(stage == 0)
+			{
+				// Get local atom indices. The neighbor list refers to 
+				// atoms by their position in the group.
+				Label slots;
+				idx1_.clear();
+				for(size_t i = 0; i < group1_.size(); ++i)
+				{
+					auto k = snapshot.GetLocalIndex(group1_[i]);
+					if(k != -1)
+					{
+						idx1_.push_back(k);
+						slots.push_back(i);
+					}
+				}
+
+				if(slots != slots1_)
+				{
+					slots1_.swap(slots);
+					nlist_.Invalidate();
+				}
+
+				// Initialize gradient.
+				ClearGradient(snapshot.GetNumAtoms());
+				boxgrad_ = Matrix3::Zero();
+
+				// The nastiness begins. We essentially need to compute 
+				// pairwise distances between the atoms. For now, let's 
+				// collect the atomic coordinates of group2_ on all 
+				// processors, each atom in its slot within the group.
+				handle_ = plan.ReserveSum(3*n2);
+				auto* pos = plan.Local(handle_);
+				idx2_.resize(n2);
+				for(size_t j = 0; j < n2; ++j)
+				{
+					idx2_[j] = snapshot.GetLocalIndex(group2_[j]);
+					if(idx2_[j] != -1)
+					{
+						auto& p = positions[idx2_[j]];
+						pos[3*j+0] = p[0];
+						pos[3*j+1] = p[1];
+						pos[3*j+2] = p[2];
+					}
+				}
+				return;
+			}
 			
-			// Fill up mass and position vectors.
-			std::vector<double> pos(3*idx2.size(), 0);
-			std::vector<int> ids(idx2.size(), 0);
-			for(size_t i = 0; i < idx2.size(); ++i)
+			if(stage == 2)
 			{
-				auto& idx = idx2[i];
-				auto& p = positions[idx];
-				pos[3*i+0] = p[0];
-				pos[3*i+1] = p[1];
-				pos[3*i+2] = p[2];
-				ids[i] = atomids[idx];
+				// Reduced value.
+				val_ = plan.Result(handle_)[0];
+				return;
 			}
 
-			// Create receiving vectors.
-			std::vector<double> gpos(pdispls.back(), 0);
-			std::vector<int> gids(idispls.back(), 0);
-			
-			// Gather data.
-			MPI_Allgatherv(pos.data(), pos.size(), MPI_DOUBLE, gpos.data(), pcounts.data(), pdispls.data(), MPI_DOUBLE, comm);
-			MPI_Allgatherv(ids.data(), ids.size(), MPI_INT, gids.data(), icounts.data(), idispls.data(), MPI_INT, comm);
+			auto* gpos = plan.Result(handle_);
+			auto n1 = idx1_.size();
+
+			pos1_.resize(n1);
+			for(size_t i = 0; i < n1; ++i)
+				pos1_[i] = positions[idx1_[i]];
+
+			pos2_.resize(n2);
+			for(size_t j = 0; j < n2; ++j)
+				pos2_[j] = {gpos[3*j], gpos[3*j+1], gpos[3*j+2]};
+
+			// Gradient accumulators for both groups.
+			std::vector<Vector3> grad1(n1, Vector3{0,0,0});
+			std::vector<Vector3> grad2(n2, Vector3{0,0,0});
 
-			val_ = 0;
-			double df = 0.;
-			for(auto& i : idx1)
+			// Pairs are evaluated in batches through the switching function.
+			const size_t nbatch = 256;
+			std::vector<Vector3> rij(nbatch);
+			std::vector<double> r2(nbatch), f(nbatch), dfr(nbatch);
+			std::vector<std::pair<int, int>> ij(nbatch);
+			size_t nb = 0;
+
+			double val = 0;
+			auto flush = [&]()
 			{
-				auto& p = positions[i];
-				for(size_t j = 0; j < group2_.size(); ++j)
+				sf_.Evaluate(r2.data(), nb, f.data(), dfr.data());
+				for(size_t k = 0; k < nb; ++k)
 				{
-					Vector3 rij = {p[0] - gpos[3*j], p[1] - gpos[3*j+1], p[2] - gpos[3*j+2]};
-					snapshot.ApplyMinimumImage(&rij);
-					auto r = rij.norm();
-					val_ +=  sf_.Evaluate(r, df);
+					Vector3 g = dfr[k]*rij[k];
+					val += f[k];
+					grad1[ij[k].first] += g;
+					grad2[ij[k].second] -= g;
+					boxgrad_ += g*rij[k].transpose();
+				}
+				nb = 0;
+			};
 
-					grad_[i] += df*rij/r;
-					boxgrad_ += df*rij/r*rij.transpose();
+			auto pair = [&](size_t i, size_t j)
+			{
+				rij[nb] = pos1_[i] - pos2_[j];
+				snapshot.ApplyMinimumImage(&rij[nb]);
+				r2[nb] = rij[nb].squaredNorm();
+				ij[nb] = {i, j};
+				if(++nb == nbatch)
+					flush();
+			};
 
-					auto lidx = snapshot.GetLocalIndex(gids[j]);
-					if(lidx != -1)
-						grad_[lidx] -= df*rij/r;
-				}
+			// Visit all pairs unless the switching function is truncated.
+			if(sf_.IsTruncated())
+			{
+				nlist_.Update(snapshot, pos1_, pos2_);
+				for(auto& p : nlist_.GetPairs())
+					pair(p.first, p.second);
+			}
+			else
+			{
+				for(size_t i = 0; i < n1; ++i)
+					for(size_t j = 0; j < n2; ++j)
+						pair(i, j);
+			}
+			flush();
+
+			for(size_t i = 0; i < n1; ++i)
+				AddGradient(idx1_[i], grad1[i]);
+
+			// Group 2 atoms owned by this processor.
+			for(size_t j = 0; j < n2; ++j)
+			{
+				if(idx2_[j] != -1)
+					AddGradient(idx2_[j], grad2[j]);
 			}
 			
 			// Reduce val. 
-			MPI_Allreduce(MPI_IN_PLACE, &val_, 1, MPI_DOUBLE, MPI_SUM, comm);
+			handle_ = plan.ReserveSum(1);
+			plan.Local(handle_)[0] = val;
 		}
 		
 		//! Serialize this CV for restart purposes.
@@ -20,7 +20,7 @@
 
 #pragma once 
 
-#include "CVs/CollectiveVariable.h"
+#include "CVs/MultiCollectiveVariable.h"
 #include "Drivers/DriverException.h"
 #include <Eigen/Eigenvalues>
 
@@ -43,13 +43,18 @@ namespace SSAGES
 	 * user selection, this will specify a principal moment, radius of gyration, 
 	 * or another shape descriptor.
 	 *
+	 * Several components can be requested at once. They share the center 
+	 * of mass, the gyration tensor and its eigendecomposition.
+	 *
 	 * \ingroup CVs
 	 */
-	class GyrationTensorCV : public CollectiveVariable
+	class GyrationTensorCV : public MultiCollectiveVariable
 	{
 	private:
 		Label atomids_; //!< IDs of the atoms used for calculation
-		GyrationTensor component_; //!< Component of gyration tensor to compute.
+		GroupCenterOfMass com_; //!< Center of mass of the atoms.
+		std::vector<Vector3> ris_; //!< Positions in the inertial frame.
+		size_t handle_; //!< CommPlan segment holding the gyration tensor.
 
 	public: 
 		//! Constructor.
@@ -61,10 +66,34 @@ namespace SSAGES
 		 *
 		 */
 		GyrationTensorCV(const Label& atomids, GyrationTensor component) :
-		atomids_(atomids), component_(component)
+		GyrationTensorCV(atomids, std::vector<size_t>{static_cast<size_t>(component)})
+		{
+		}
+
+		//! Constructor for several components.
+		/*!
+		 * \param atomids IDs of the atoms defining gyration tensor.
+		 * \param components Components to compute. The first one is the 
+		 *        value of this CV.
+		 */
+		GyrationTensorCV(const Label& atomids, const std::vector<size_t>& components) :
+		MultiCollectiveVariable(7, components), atomids_(atomids), com_(), ris_(), handle_(0)
 		{
 		}
 
+		//! \copydoc MultiCollectiveVariable::GetNumComponents()
+		size_t GetNumComponents() const override { return 7; }
+
+		//! \copydoc MultiCollectiveVariable::GetComponentName()
+		std::string GetComponentName(size_t c) const override
+		{
+			static const char* names[] = {
+				"Rg", "principal1", "principal2", "principal3", 
+				"asphericity", "acylindricity", "shapeaniso"
+			};
+			return names[c];
+		}
+
 		//! Initialize necessary variables.
 		/*!
 		 * \param snapshot Current simulation snapshot.
@@ -94,44 +123,76 @@ namespace SSAGES
 				});		
 		}		
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
+		{
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Two rounds for the center of mass and one for the gyration tensor.
+		 */
+		int GetCommStages() const override { return 3; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
 		{
 			using namespace Eigen; 
 
 			// Get local atom indices and compute COM. 
-			std::vector<int> idx;
-			snapshot.GetLocalIndices(atomids_, &idx);
+			if(stage < 3)
+				com_.Stage(snapshot, atomids_, stage, plan);
+			if(stage < 2)
+				return;
 
 			// Get data from snapshot. 
 			auto n = snapshot.GetNumAtoms();
 			const auto& masses = snapshot.GetMasses();
 			const auto& pos = snapshot.GetPositions();
+			const auto& idx = com_.indices;
+			auto masstot = com_.mass;
+			auto& ris = ris_;
 
-			// Initialize gradient.
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
-			
-			// Compute total and center of mass.
-			auto masstot = snapshot.TotalMass(idx);
-			Vector3 com = snapshot.CenterOfMass(idx, masstot);
-
-			// Gyration tensor and temporary vector to store positions in inertial frame. 
-			Matrix3 S = Matrix3::Zero();
-			std::vector<Vector3> ris; 
-			ris.reserve(idx.size());
-			for(auto& i : idx)
+			if(stage == 2)
 			{
-				ris.emplace_back(snapshot.ApplyMinimumImage(pos[i] - com));
-				S.noalias() += masses[i]*ris.back()*ris.back().transpose();
+				// Gyration tensor and temporary vector to store positions in inertial frame. 
+				handle_ = plan.ReserveSum(9);
+				Map<Matrix3> S(plan.Local(handle_));
+				ris.clear();
+				ris.reserve(idx.size());
+				for(auto& i : idx)
+				{
+					ris.emplace_back(snapshot.ApplyMinimumImage(pos[i] - com_.com));
+					S.noalias() += masses[i]*ris.back()*ris.back().transpose();
+				}
+				return;
 			}
 
-			// Reduce gyration tensor across processors and normalize.
-			MPI_Allreduce(MPI_IN_PLACE, S.data(), S.size(), MPI_DOUBLE, MPI_SUM, snapshot.GetCommunicator());
-			S /= masstot;
+			// Initialize gradients.
+			ClearComponents(n);
+
+			// Gyration tensor reduced across processors, normalized.
+			Matrix3 S = Map<const Matrix3>(plan.Result(handle_))/masstot;
 
 			// Perform EVD. The columns are the eigenvectors. 
 			// SelfAdjoint solver sorts in ascending order. 
@@ -148,63 +209,56 @@ namespace SSAGES
 			            n2 = eigvecs.col(1), 
 			            n3 = eigvecs.col(0);
 
+			auto l1_2 = l1*l1, l2_2 = l2*l2, l3_2 = l3*l3; 
+			auto sum = l1 + l2 + l3;
+			auto sqsum = l1_2 + l2_2 + l3_2;
+
+			cvals_[Rg] = l1 + l2 + l3;
+			cvals_[principal1] = l1;
+			cvals_[principal2] = l2;
+			cvals_[principal3] = l3;
+			cvals_[asphericity] = l1 - 0.5*(l2 + l3);
+			cvals_[acylindricity] = l2 - l3;
+			cvals_[shapeaniso] = 1.5*sqsum/(sum*sum) - 0.5;
+
 			// Compute gradient.
 			size_t j = 0;
-			val_ = 0;
 			for(auto& i : idx)
 			{
 				// Compute derivative of each eigenvalue and use combos in components. 
-				auto dl1 = 2.*masses[i]/masstot*(1.-masses[i]/masstot)*ris[j].dot(n1)*n1;
-				auto dl2 = 2.*masses[i]/masstot*(1.-masses[i]/masstot)*ris[j].dot(n2)*n2;
-				auto dl3 = 2.*masses[i]/masstot*(1.-masses[i]/masstot)*ris[j].dot(n3)*n3;
+				Vector3 dl1 = 2.*masses[i]/masstot*(1.-masses[i]/masstot)*ris[j].dot(n1)*n1;
+				Vector3 dl2 = 2.*masses[i]/masstot*(1.-masses[i]/masstot)*ris[j].dot(n2)*n2;
+				Vector3 dl3 = 2.*masses[i]/masstot*(1.-masses[i]/masstot)*ris[j].dot(n3)*n3;
 
-				// It is inefficient to keep reassigning val, but it's better than having two 
-				// switches, and the compiler will probably optimize it out anyways.
-				switch(component_)
-				{
-					case Rg:
-						grad_[i] = dl1 + dl2 + dl3;
-						val_ = l1 + l2 + l3; 
-						break;
-					case principal1:
-						grad_[i] = dl1;
-						val_ = l1;
-						break;
-					case principal2:
-						grad_[i] = dl2;
-						val_ = l2;
-						break;
-					case principal3:
-						grad_[i] = dl3;
-						val_ = l3;
-						break;
-					case asphericity:
-						grad_[i] = dl1 - 0.5*(dl2 + dl3);
-						val_ = l1 - 0.5*(l2 + l3);
-						break;
-					case acylindricity:
-						grad_[i] = dl2 - dl3;
-						val_ = l2 - l3; 
-						break;
-					case shapeaniso:
-						auto l1_2 = l1*l1, l2_2 = l2*l2, l3_2 = l3*l3; 
-						auto sum = l1 + l2 + l3;
-						auto sqsum = l1_2 + l2_2 + l3_2;
-						grad_[i] = 3.*(l1*dl1+l2*dl2+l3*dl3)/(sum*sum) - 
-						           3.*sqsum*(dl1+dl2+dl3)/(sum*sum*sum);
-						val_ = 1.5*sqsum/(sum*sum) - 0.5;
-						break;
-				}
+				if(IsEnabled(Rg))
+					AddComponentGradient(Rg, i, dl1 + dl2 + dl3);
+				if(IsEnabled(principal1))
+					AddComponentGradient(principal1, i, dl1);
+				if(IsEnabled(principal2))
+					AddComponentGradient(principal2, i, dl2);
+				if(IsEnabled(principal3))
+					AddComponentGradient(principal3, i, dl3);
+				if(IsEnabled(asphericity))
+					AddComponentGradient(asphericity, i, dl1 - 0.5*(dl2 + dl3));
+				if(IsEnabled(acylindricity))
+					AddComponentGradient(acylindricity, i, dl2 - dl3);
+				if(IsEnabled(shapeaniso))
+					AddComponentGradient(shapeaniso, i, 
+						3.*(l1*dl1+l2*dl2+l3*dl3)/(sum*sum) - 
+						3.*sqsum*(dl1+dl2+dl3)/(sum*sum*sum));
 
 				++j;
 			}
+
+			SelectComponent();
 		}
 
-		//! Serialize this CV for restart purposes.
+		//! Serialize a single component for restart purposes.
 		/*!
+		 * \param c Component.
 		 * \param json JSON value
 		 */
-		virtual void Serialize(Json::Value& json) const override
+		void SerializeComponent(size_t c, Json::Value& json) const override
 		{
 			json["type"] = "GyrationTensor"; 
 
@@ -214,31 +268,7 @@ namespace SSAGES
 			for(auto& bound: bounds_)
 				json["bounds"].append(bound);
 
-			switch(component_)
-			{
-				case Rg:
-					json["component"] = "Rg";
-					break;
-				case principal1:
-					json["component"] = "principal1"; 
-					break;
-				case principal2:
-					json["component"] = "principal2";
-					break;
-				case principal3:
-					json["component"] = "principal3";
-					break;
-				case asphericity:
-					json["component"] = "asphericity"; 
-					break;
-				case acylindricity:
-					json["component"] = "acylindricity";
-					break;
-				case shapeaniso:
-					json["component"] = "shapeaniso";
-					break;
-			}
+			json["component"] = GetComponentName(c);
 		}
-
 	};
-}
\ No newline at end of file
+}
@@ -60,7 +60,9 @@ namespace SSAGES
 		{
 			// Initialize gradient
 			auto n = snapshot.GetPositions().size();
-			grad_.resize(n, usergrad_);
+			ClearGradient(n);
+			for(size_t i = 0; i < n; ++i)
+				AddGradient(i, usergrad_);
 		}
 
 		//! Evaluate the CV.
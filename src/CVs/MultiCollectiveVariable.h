@@ -0,0 +1,267 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "CollectiveVariable.h"
+#include "../Drivers/DriverException.h"
+#include <string>
+
+namespace SSAGES
+{
+	//! Collective variable computing several scalar components at once.
+	/*!
+	 * \ingroup CVs
+	 *
+	 * One evaluation produces a value and a gradient for every enabled 
+	 * component. The CV itself reports its primary component, so it can be 
+	 * used like any other CV. Further components are exposed to methods 
+	 * through ComponentCV views, which share the evaluation.
+	 *
+	 * Derived classes call ClearComponents() at the start of an 
+	 * evaluation, fill in the enabled components and finish with 
+	 * SelectComponent().
+	 */
+	class MultiCollectiveVariable : public CollectiveVariable
+	{
+	private:
+		//! \c TRUE for components which need to be computed.
+		std::vector<char> enabled_;
+
+	protected:
+		//! Requested components. The first is reported by this CV.
+		std::vector<size_t> components_;
+
+		//! Value of each component.
+		std::vector<double> cvals_;
+
+		//! Sparse gradient of each component.
+		std::vector<SparseGradient> cgrads_;
+
+		//! Box gradient of each component.
+		std::vector<Matrix3> cboxgrads_;
+
+		//! Reset all components ahead of an evaluation.
+		/*!
+		 * \param natoms Number of local atoms in the snapshot.
+		 */
+		void ClearComponents(size_t natoms)
+		{
+			auto n = GetNumComponents();
+			cvals_.assign(n, 0);
+			cgrads_.resize(n);
+			for(auto& g : cgrads_)
+				g.clear();
+			cboxgrads_.assign(n, Matrix3::Zero());
+			ClearGradient(natoms);
+		}
+
+		//! Add a gradient contribution to a component.
+		/*!
+		 * \param c Component.
+		 * \param idx Local atom index.
+		 * \param grad Contribution to dCv/dxi of that atom.
+		 */
+		void AddComponentGradient(size_t c, int idx, const Vector3& grad)
+		{
+			cgrads_[c].push_back(idx, grad);
+		}
+
+		//! Report the primary component as the value of this CV.
+		void SelectComponent()
+		{
+			auto c = components_[0];
+			val_ = cvals_[c];
+			boxgrad_ = cboxgrads_[c];
+			const auto& g = cgrads_[c];
+			for(size_t i = 0; i < g.size(); ++i)
+				AddGradient(g.indices[i], g.values[i]);
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param ncomponents Number of available components.
+		 * \param components Requested components, the primary one first.
+		 */
+		MultiCollectiveVariable(size_t ncomponents, const std::vector<size_t>& components) :
+		enabled_(ncomponents, 0), components_(components), cvals_(), cgrads_(), cboxgrads_()
+		{
+			if(components_.empty())
+				throw BuildException({"At least one component must be requested."});
+
+			for(auto& c : components_)
+				EnableComponent(c);
+		}
+
+		//! Get the number of available components.
+		virtual size_t GetNumComponents() const = 0;
+
+		//! Get the name of a component.
+		/*!
+		 * \param c Component.
+		 * \return Name of the component.
+		 */
+		virtual std::string GetComponentName(size_t c) const = 0;
+
+		//! Serialize the CV as if it only reported one component.
+		/*!
+		 * \param c Component.
+		 * \param json JSON value
+		 */
+		virtual void SerializeComponent(size_t c, Json::Value& json) const = 0;
+
+		//! Serialize this CV for restart purposes.
+		/*!
+		 * \param json JSON value
+		 *
+		 * Additional components are serialized by their views.
+		 */
+		void Serialize(Json::Value& json) const override
+		{
+			SerializeComponent(components_[0], json);
+		}
+
+		//! Request that a component is computed.
+		/*!
+		 * \param c Component.
+		 */
+		void EnableComponent(size_t c)
+		{
+			if(c >= enabled_.size())
+				throw BuildException({"Component " + std::to_string(c) + " is out of range."});
+			enabled_[c] = 1;
+		}
+
+		//! Check whether a component is computed.
+		/*!
+		 * \param c Component.
+		 * \return \c TRUE if the component is computed on evaluation.
+		 */
+		bool IsEnabled(size_t c) const { return enabled_[c] != 0; }
+
+		//! Get the requested components.
+		/*!
+		 * \return Components, starting with the one reported by this CV.
+		 */
+		const std::vector<size_t>& GetComponents() const { return components_; }
+
+		//! Get the value of a component.
+		/*!
+		 * \param c Component.
+		 * \return Value from the last evaluation, zero if not enabled.
+		 */
+		double GetComponentValue(size_t c) const { return cvals_[c]; }
+
+		//! Get the sparse gradient of a component.
+		/*!
+		 * \param c Component.
+		 * \return Gradient from the last evaluation, empty if not enabled.
+		 */
+		const SparseGradient& GetComponentGradient(size_t c) const { return cgrads_[c]; }
+
+		//! Get the box gradient of a component.
+		/*!
+		 * \param c Component.
+		 * \return Box gradient from the last evaluation.
+		 */
+		const Matrix3& GetComponentBoxGradient(size_t c) const { return cboxgrads_[c]; }
+	};
+
+	//! Scalar view on a component of a multi-output CV.
+	/*!
+	 * \ingroup CVs
+	 *
+	 * The view does not compute anything. The Hook evaluates the source 
+	 * once per step and then lets every view collect its component.
+	 * Evaluated on its own, the view evaluates the source first.
+	 */
+	class ComponentCV : public CollectiveVariable
+	{
+	private:
+		MultiCollectiveVariable* source_; //!< CV computing the component.
+		size_t component_; //!< Component.
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param source CV computing the component. Must outlive the view.
+		 * \param component Component.
+		 */
+		ComponentCV(MultiCollectiveVariable* source, size_t component) :
+		source_(source), component_(component)
+		{
+			source_->EnableComponent(component_);
+		}
+
+		//! Initialize the source.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Initialize(const Snapshot& snapshot) override
+		{
+			source_->Initialize(snapshot);
+		}
+
+		//! Evaluate the source and collect the component.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Evaluate(const Snapshot& snapshot) override
+		{
+			source_->Evaluate(snapshot);
+			Collect(snapshot);
+		}
+
+		//! \copydoc CollectiveVariable::GetSource()
+		CollectiveVariable* GetSource() override { return source_; }
+
+		//! Copy the component from the evaluated source.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Collect(const Snapshot& snapshot) override
+		{
+			val_ = source_->GetComponentValue(component_);
+			boxgrad_ = source_->GetComponentBoxGradient(component_);
+			ClearGradient(snapshot.GetNumAtoms());
+			const auto& g = source_->GetComponentGradient(component_);
+			for(size_t i = 0; i < g.size(); ++i)
+				AddGradient(g.indices[i], g.values[i]);
+		}
+
+		//! \copydoc CollectiveVariable::GetAtomSet()
+		bool GetAtomSet(Label& ids) const override
+		{
+			return source_->GetAtomSet(ids);
+		}
+
+		//! Get the viewed component.
+		size_t GetComponent() const { return component_; }
+
+		//! Serialize the component as a CV of its own.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const override
+		{
+			source_->SerializeComponent(component_, json);
+		}
+	};
+}
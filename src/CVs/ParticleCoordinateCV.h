@@ -44,6 +44,9 @@ namespace SSAGES
 		//! Index of dimension.
 	 	Dimension dim_;
 
+		//! Center of mass of the atoms.
+		GroupCenterOfMass com_;
+
 	public:
 		//! Constructor.
 		/*!
@@ -56,7 +59,7 @@ namespace SSAGES
 		 * \todo Bounds needs to be an input.
 		 */	 	
 		ParticleCoordinateCV(const Label& atomids, Dimension dim) : 
-		atomids_(atomids), dim_(dim)
+		atomids_(atomids), dim_(dim), com_()
 		{}
 
 		//! Initialize necessary variables.
@@ -88,27 +91,54 @@ namespace SSAGES
 				});			
 		}
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
+		{
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Two rounds for the center of mass.
+		 */
+		int GetCommStages() const override { return 2; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
 		{
 			// Get local atom indices and compute COM. 
-			std::vector<int> idx;
-			snapshot.GetLocalIndices(atomids_, &idx);
+			com_.Stage(snapshot, atomids_, stage, plan);
+			if(stage < GetCommStages())
+				return;
 
 			// Get data from snapshot. 
 			auto n = snapshot.GetNumAtoms();
 			const auto& masses = snapshot.GetMasses();
+			const auto& idx = com_.indices;
+			const auto& com = com_.com;
+			auto masstot = com_.mass;
 
 			// Initialize gradient.
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
-			
-			// Compute total and center of mass.
-			auto masstot = snapshot.TotalMass(idx);
-			Vector3 com = snapshot.CenterOfMass(idx, masstot);
+			ClearGradient(n);
 
 			// Assign CV value. 
 			switch(dim_)
@@ -127,9 +157,11 @@ namespace SSAGES
 			// Assign gradient to appropriate atoms.
 			for(auto& id : idx)
 			{
-				grad_[id][0] = (dim_ == Dimension::x) ? masses[id]/masstot : 0;
-				grad_[id][1] = (dim_ == Dimension::y) ? masses[id]/masstot : 0;
-				grad_[id][2] = (dim_ == Dimension::z) ? masses[id]/masstot : 0;
+				AddGradient(id, {
+					(dim_ == Dimension::x) ? masses[id]/masstot : 0,
+					(dim_ == Dimension::y) ? masses[id]/masstot : 0,
+					(dim_ == Dimension::z) ? masses[id]/masstot : 0
+				});
 			}
 		}
 
@@ -44,6 +44,9 @@ namespace SSAGES
 		//! Each dimension determines if it is applied by the CV.
 		Bool3 dim_; 
 
+		GroupCenterOfMass com1_; //!< Center of mass of group 1.
+		GroupCenterOfMass com2_; //!< Center of mass of group 2.
+
 	public:
 		//! Constructor
 		/*!
@@ -55,7 +58,7 @@ namespace SSAGES
 		 * \todo bounds needs to be an input.
 		 */
 		ParticleSeparationCV(const Label& group1, const Label& group2) : 
-		group1_(group1), group2_(group2), dim_{true, true, true}
+		group1_(group1), group2_(group2), dim_{true, true, true}, com1_(), com2_()
 		{}
 
 		//! Constructor
@@ -71,7 +74,7 @@ namespace SSAGES
 		 * \todo bounds needs to be an input.
 		 */
 		ParticleSeparationCV(const Label& group1, const Label& group2, bool fixx, bool fixy, bool fixz) : 
-		group1_(group1), group2_(group2), dim_{fixx, fixy, fixz}
+		group1_(group1), group2_(group2), dim_{fixx, fixy, fixz}, com1_(), com2_()
 		{}
 
 		//! Initialize necessary variables.
@@ -120,46 +123,72 @@ namespace SSAGES
 				});			
 		}
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), group1_.begin(), group1_.end());
+			ids.insert(ids.end(), group2_.begin(), group2_.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
 		{
-			// Get local atom indices.
-			std::vector<int> idx1, idx2;
-			snapshot.GetLocalIndices(group1_, &idx1);
-			snapshot.GetLocalIndices(group2_, &idx2);
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Two rounds for the group centers of mass.
+		 */
+		int GetCommStages() const override { return 2; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			// Get local atom indices and centers of mass.
+			com1_.Stage(snapshot, group1_, stage, plan);
+			com2_.Stage(snapshot, group2_, stage, plan);
+			if(stage < GetCommStages())
+				return;
 
 			// Get data from snapshot. 
 			auto n = snapshot.GetNumAtoms();
 			const auto& masses = snapshot.GetMasses();
+			auto mtot1 = com1_.mass;
+			auto mtot2 = com2_.mass;
 
 			// Initialize gradient.
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
+			ClearGradient(n);
 			boxgrad_ = Matrix3::Zero();
 
-			// Get centers of mass.
-			auto mtot1 = snapshot.TotalMass(idx1);		
-			auto mtot2 = snapshot.TotalMass(idx2);	
-			Vector3 com1 = snapshot.CenterOfMass(idx1, mtot1);
-			Vector3 com2 = snapshot.CenterOfMass(idx2, mtot2);
-
 			// Account for pbc. 
-			Vector3 rij = snapshot.ApplyMinimumImage(com1 - com2).cwiseProduct(dim_.cast<double>());
+			Vector3 rij = snapshot.ApplyMinimumImage(com1_.com - com2_.com).cwiseProduct(dim_.cast<double>());
 
 			// Compute gradient.
 			val_ = rij.norm();
 
-			for(auto& id : idx1)
+			for(auto& id : com1_.indices)
 			{
-				grad_[id] = rij/val_*masses[id]/mtot1;
-				boxgrad_ += grad_[id]*rij.transpose();
+				Vector3 g = rij/val_*masses[id]/mtot1;
+				AddGradient(id, g);
+				boxgrad_ += g*rij.transpose();
 			}
 			
-			for(auto& id : idx2)
-				grad_[id] = -rij/val_*masses[id]/mtot2;
+			for(auto& id : com2_.indices)
+				AddGradient(id, -rij/val_*masses[id]/mtot2);
 		}
 
 		//! Serialize this CV for restart purposes.
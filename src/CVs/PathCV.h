@@ -0,0 +1,413 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "RMSDCV.h"
+#include <algorithm>
+#include <cmath>
+
+namespace SSAGES
+{
+	enum PathComponent
+	{
+		PathProgress = 0, // Progress s along the path
+		PathDistance = 1 // Distance z from the path
+	};
+
+	//! Path collective variables.
+	/*!
+	 * Progress along and distance from a path of reference frames, as 
+	 * introduced by Branduardi, Gervasio and Parrinello, J. Chem. Phys. 
+	 * 126: 054103, 2007,
+	 *
+	 * \f[
+	 *     s = \frac{\sum_k k\, e^{-\lambda d_k}}{\sum_k e^{-\lambda d_k}}, 
+	 *     \qquad
+	 *     z = -\frac{1}{\lambda}\ln \sum_k e^{-\lambda d_k},
+	 * \f]
+	 *
+	 * where \f$d_k\f$ is the mean square deviation from frame k = 1..K after 
+	 * optimal superposition (see RMSDCV).
+	 *
+	 * Each rank packs the frame coordinates of its local atoms into 
+	 * contiguous arrays. The correlation matrices of all frames are computed 
+	 * in one pass over blocks of atoms and reduced in a single collective.
+	 *
+	 * With neighbor screening only the frames closest to the last full 
+	 * evaluation are considered. All frames are evaluated again every 
+	 * refresh evaluations.
+	 *
+	 * \ingroup CVs
+	 */
+	class PathCV : public CollectiveVariable
+	{
+	private:
+		Label atomids_; //!< IDs of the atoms used for the frame distances.
+		std::vector<std::string> frames_; //!< Frame structure files.
+		double lambda_; //!< Smoothing parameter.
+		PathComponent component_; //!< Component of the path CV to compute.
+		size_t neighbors_; //!< Number of frames to evaluate, zero for all.
+		size_t refresh_; //!< Evaluations between full evaluations.
+
+		std::vector<ReferenceStructure> refs_; //!< Frame structures.
+		std::vector<double> dists_; //!< Last known distance to each frame.
+		std::vector<size_t> active_; //!< Frames evaluated in this step.
+		size_t nevals_; //!< Number of evaluations.
+		double s_; //!< Progress along the path.
+		double z_; //!< Distance from the path.
+
+		GroupCenterOfMass com_; //!< Center of mass of the atoms.
+		Label slots_; //!< Position in atomids_ of each local atom.
+		Label packed_; //!< Slots the frames in y_ were packed for.
+		std::vector<double> x_; //!< Local positions relative to the COM, by component.
+		std::vector<double> y_; //!< Local frame coordinates, by frame and component.
+		size_t handle_; //!< CommPlan segment holding correlation matrices.
+
+		//! Pack the frame coordinates of the local atoms.
+		void PackFrames()
+		{
+			auto nloc = slots_.size();
+			y_.resize(3*nloc*refs_.size());
+			for(size_t k = 0; k < refs_.size(); ++k)
+				for(int r = 0; r < 3; ++r)
+				{
+					auto* y = y_.data() + (3*k + r)*nloc;
+					for(size_t t = 0; t < nloc; ++t)
+						y[t] = refs_[k].coords[slots_[t]][r];
+				}
+			packed_ = slots_;
+		}
+
+		//! Add the local correlation matrices of the active frames.
+		/*!
+		 * \param out Column-major 3x3 matrices, one per active frame.
+		 *
+		 * Atoms are processed in blocks which stay in cache while all 
+		 * frames are visited. Each block is accumulated over independent 
+		 * lanes so the inner loop vectorizes without reassociation.
+		 */
+		void Correlate(double* out) const
+		{
+			const size_t B = 512, L = 4;
+			auto nloc = slots_.size();
+			const auto* x0 = x_.data();
+			const auto* x1 = x0 + nloc;
+			const auto* x2 = x1 + nloc;
+
+			for(size_t b0 = 0; b0 < nloc; b0 += B)
+			{
+				auto b1 = std::min(nloc, b0 + B);
+				for(size_t a = 0; a < active_.size(); ++a)
+				{
+					const auto* y0 = y_.data() + 3*nloc*active_[a];
+					const auto* y1 = y0 + nloc;
+					const auto* y2 = y1 + nloc;
+
+					double acc[9][L] = {};
+					auto t = b0;
+					for(; t + L <= b1; t += L)
+						for(size_t l = 0; l < L; ++l)
+						{
+							acc[0][l] += y0[t+l]*x0[t+l];
+							acc[1][l] += y1[t+l]*x0[t+l];
+							acc[2][l] += y2[t+l]*x0[t+l];
+							acc[3][l] += y0[t+l]*x1[t+l];
+							acc[4][l] += y1[t+l]*x1[t+l];
+							acc[5][l] += y2[t+l]*x1[t+l];
+							acc[6][l] += y0[t+l]*x2[t+l];
+							acc[7][l] += y1[t+l]*x2[t+l];
+							acc[8][l] += y2[t+l]*x2[t+l];
+						}
+
+					for(; t < b1; ++t)
+					{
+						acc[0][0] += y0[t]*x0[t];
+						acc[1][0] += y1[t]*x0[t];
+						acc[2][0] += y2[t]*x0[t];
+						acc[3][0] += y0[t]*x1[t];
+						acc[4][0] += y1[t]*x1[t];
+						acc[5][0] += y2[t]*x1[t];
+						acc[6][0] += y0[t]*x2[t];
+						acc[7][0] += y1[t]*x2[t];
+						acc[8][0] += y2[t]*x2[t];
+					}
+
+					for(int i = 0; i < 9; ++i)
+						for(size_t l = 0; l < L; ++l)
+							out[9*a + i] += acc[i][l];
+				}
+			}
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param atomids IDs of the atoms defining the frame distances.
+		 * \param frames Frame structure files (XYZ format), in path order.
+		 * \param lambda Smoothing parameter.
+		 * \param component Component of the path CV to compute.
+		 * \param neighbors Number of closest frames to evaluate, zero for all.
+		 * \param refresh Evaluations between full evaluations.
+		 *
+		 * Construct a path CV.
+		 */
+		PathCV(const Label& atomids, const std::vector<std::string>& frames, double lambda, 
+		       PathComponent component, size_t neighbors = 0, size_t refresh = 100) :
+		atomids_(atomids), frames_(frames), lambda_(lambda), component_(component), 
+		neighbors_(neighbors), refresh_(refresh), refs_(), dists_(), active_(), nevals_(0), 
+		s_(0), z_(0), com_(), slots_(), packed_(), x_(), y_(), handle_(0)
+		{
+			if(frames_.size() < 2)
+				throw BuildException({"PathCV: At least two frames are required."});
+
+			if(lambda_ <= 0)
+				throw BuildException({"PathCV: Lambda must be positive."});
+
+			if(refresh_ == 0)
+				throw BuildException({"PathCV: Refresh interval must be positive."});
+		}
+
+		//! Initialize necessary variables.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Initialize(const Snapshot& snapshot) override
+		{
+			auto masses = ReferenceStructure::GatherMasses(snapshot, atomids_, "PathCV");
+
+			refs_.resize(frames_.size());
+			for(size_t k = 0; k < refs_.size(); ++k)
+				refs_[k].Load(frames_[k], masses);
+
+			dists_.assign(frames_.size(), 0);
+			packed_.clear();
+			nevals_ = 0;
+		}
+
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
+
+		//! Evaluate the CV.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Evaluate(const Snapshot& snapshot) override
+		{
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Two rounds for the center of mass and one for the 
+		 *         correlation matrices.
+		 */
+		int GetCommStages() const override { return 3; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			using namespace Eigen;
+
+			auto nframes = refs_.size();
+
+			// Local atoms and the frames to evaluate. The distances used
+			// for screening are identical on all ranks.
+			if(stage == 0)
+			{
+				com_.indices.clear();
+				slots_.clear();
+				for(size_t j = 0; j < atomids_.size(); ++j)
+				{
+					auto i = snapshot.GetLocalIndex(atomids_[j]);
+					if(i != -1)
+					{
+						com_.indices.push_back(i);
+						slots_.push_back(j);
+					}
+				}
+
+				if(slots_ != packed_ || y_.size() != 3*slots_.size()*nframes)
+					PackFrames();
+
+				active_.resize(nframes);
+				for(size_t k = 0; k < nframes; ++k)
+					active_[k] = k;
+
+				if(neighbors_ && neighbors_ < nframes && nevals_ % refresh_ != 0)
+				{
+					std::partial_sort(active_.begin(), active_.begin() + neighbors_, active_.end(), 
+						[this](size_t a, size_t b){ return dists_[a] < dists_[b]; });
+					active_.resize(neighbors_);
+					std::sort(active_.begin(), active_.end());
+				}
+			}
+
+			if(stage < 3)
+				com_.Stage(snapshot, stage, plan);
+			if(stage < 2)
+				return;
+
+			const auto& pos = snapshot.GetPositions();
+			const auto& idx = com_.indices;
+			auto nloc = idx.size();
+			auto nactive = active_.size();
+
+			// Local correlation matrices, inner product and coordinate sum. 
+			if(stage == 2)
+			{
+				handle_ = plan.ReserveSum(9*nactive + 4);
+				auto* local = plan.Local(handle_);
+				x_.resize(3*nloc);
+				for(size_t t = 0; t < nloc; ++t)
+				{
+					Vector3 x = snapshot.ApplyMinimumImage(pos[idx[t]] - com_.com);
+					x_[t] = x[0];
+					x_[nloc + t] = x[1];
+					x_[2*nloc + t] = x[2];
+					local[9*nactive] += x[0];
+					local[9*nactive + 1] += x[1];
+					local[9*nactive + 2] += x[2];
+					local[9*nactive + 3] += x.squaredNorm();
+				}
+				Correlate(local);
+				return;
+			}
+
+			ClearGradient(snapshot.GetNumAtoms());
+			boxgrad_ = Matrix3::Zero();
+			++nevals_;
+
+			auto* result = plan.Result(handle_);
+			Vector3 sum = Map<const Vector3>(result + 9*nactive);
+			auto norm = result[9*nactive + 3];
+			double n = atomids_.size();
+
+			// Frame distances. 
+			std::vector<double> d(nactive), lmax(nactive);
+			double dmin = std::numeric_limits<double>::infinity();
+			for(size_t a = 0; a < nactive; ++a)
+			{
+				auto k = active_[a];
+				Matrix3 S = Map<const Matrix3>(result + 9*a);
+				auto E0 = 0.5*(norm + refs_[k].norm);
+				lmax[a] = QCP::MaxEigenvalue(S, E0);
+				d[a] = dists_[k] = std::max(0., 2.*(E0 - lmax[a]))/n;
+				dmin = std::min(dmin, d[a]);
+			}
+
+			// Weights, shifted by the closest frame for stability.
+			std::vector<double> w(nactive);
+			double wsum = 0, ksum = 0;
+			for(size_t a = 0; a < nactive; ++a)
+			{
+				w[a] = std::exp(-lambda_*(d[a] - dmin));
+				wsum += w[a];
+				ksum += (active_[a] + 1)*w[a];
+			}
+
+			s_ = ksum/wsum;
+			z_ = dmin - std::log(wsum)/lambda_;
+			val_ = component_ == PathProgress ? s_ : z_;
+
+			// dCV/dd_k of each frame. Frames with negligible weight are
+			// skipped, so only their rotations need to be computed.
+			std::vector<size_t> used;
+			std::vector<Matrix3> cU;
+			double csum = 0;
+			Vector3 ysum = Vector3::Zero();
+			for(size_t a = 0; a < nactive; ++a)
+			{
+				if(w[a] < 1e-12*wsum)
+					continue;
+
+				auto k = active_[a];
+				auto c = component_ == PathProgress ? 
+					-lambda_*w[a]*(k + 1 - s_)/wsum : w[a]/wsum;
+
+				Matrix3 S = Map<const Matrix3>(result + 9*a);
+				Matrix3 U = QCP::Rotation(S, lmax[a]);
+
+				used.push_back(k);
+				cU.push_back(c*U);
+				csum += c;
+				ysum.noalias() += cU.back()*refs_[k].sum;
+			}
+
+			// dd_k/dx_t = 2/N (e_t - m_t/M sum_i e_i) with e_t = x_t - U_k y_t.
+			const auto& masses = snapshot.GetMasses();
+			Vector3 esum = csum*sum - ysum;
+			for(size_t t = 0; t < nloc; ++t)
+			{
+				auto i = idx[t];
+				Vector3 g = csum*Vector3{x_[t], x_[nloc + t], x_[2*nloc + t]};
+				for(size_t u = 0; u < used.size(); ++u)
+				{
+					const auto* y = y_.data() + 3*nloc*used[u];
+					g.noalias() -= cU[u]*Vector3{y[t], y[nloc + t], y[2*nloc + t]};
+				}
+				AddGradient(i, 2./n*(g - masses[i]/com_.mass*esum));
+			}
+		}
+
+		//! Get the progress along the path from the last evaluation.
+		double GetProgress() const { return s_; }
+
+		//! Get the distance from the path from the last evaluation.
+		double GetDistance() const { return z_; }
+
+		//! Get the last known mean square deviation from each frame.
+		const std::vector<double>& GetFrameDistances() const { return dists_; }
+
+		//! Get the frames evaluated in the last step.
+		const std::vector<size_t>& GetActiveFrames() const { return active_; }
+
+		//! Serialize this CV for restart purposes.
+		/*!
+		 * \param json JSON value
+		 */
+		virtual void Serialize(Json::Value& json) const override
+		{
+			json["type"] = "Path";
+			for(auto& id : atomids_)
+				json["atom ids"].append(id);
+			for(auto& frame : frames_)
+				json["frames"].append(frame);
+			json["lambda"] = lambda_;
+			json["component"] = component_ == PathProgress ? "s" : "z";
+			json["neighbors"] = static_cast<Json::UInt>(neighbors_);
+			json["refresh"] = static_cast<Json::UInt>(refresh_);
+			for(auto& bound : bounds_)
+				json["bounds"].append(bound);
+		}
+	};
+}
@@ -22,276 +22,339 @@
 #pragma once 
 
 #include "CollectiveVariable.h"
+#include "../Drivers/DriverException.h"
+#include "../Utility/QCP.h"
 #include "../Utility/ReadFile.h"
 #include <array>
-#include <Eigen/Dense>
-#include <Eigen/Eigenvalues>
+#include <limits>
+#include <numeric>
 
 namespace SSAGES
 {
-	//! Collective variable to calculate root mean square displacement.
+	//! Reference structure centered on its center of mass.
 	/*!
-	 *RMSD calculation performed as reported in 
-	 *Coutsias, E. A., Seok, C., and Dill, K. A., "Using Quaternions to Calculate RMSD", J. Comput. Chem. 25: 1849-1857, 2004
+	 * \ingroup CVs
+	 *
+	 * Holds the coordinates of a reference structure read from an XYZ 
+	 * file, ordered like the atom IDs of the CV using it.
 	 */
+	struct ReferenceStructure
+	{
+		//! Centered coordinates.
+		std::vector<Vector3> coords;
+
+		//! Sum of centered coordinates.
+		Vector3 sum;
+
+		//! Inner product of centered coordinates.
+		double norm;
+
+		//! Read and center a reference structure.
+		/*!
+		 * \param filename XYZ file.
+		 * \param masses Masses by position in the atom ID list.
+		 */
+		void Load(const std::string& filename, const std::vector<double>& masses)
+		{
+			auto n = masses.size();
+			auto xyzinfo = ReadFile::ReadXYZ(filename);
+			if(xyzinfo.size() != n)
+				throw std::runtime_error("Reference structure and input structure atom size do not match!");
+
+			coords.resize(n);
+			Vector3 COMref = Vector3::Zero();
+			double total_mass = 0;
+			for(size_t j = 0; j < n; ++j)
+			{
+				coords[j] = {xyzinfo[j][1], xyzinfo[j][2], xyzinfo[j][3]};
+				COMref += masses[j]*coords[j];
+				total_mass += masses[j];
+			}
+			COMref /= total_mass;
 
+			sum.setZero();
+			norm = 0;
+			for(auto& y : coords)
+			{
+				y -= COMref;
+				sum += y;
+				norm += y.squaredNorm();
+			}
+		}
+
+		//! Collect the masses of a group of atoms from all processors.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param atomids IDs of the atoms.
+		 * \param name Name of the caller for error messages.
+		 * \return Masses by position in atomids.
+		 */
+		static std::vector<double> GatherMasses(const Snapshot& snapshot, const Label& atomids, const std::string& name)
+		{
+			using std::to_string;
+
+			auto n = atomids.size();
+			const auto& mass = snapshot.GetMasses();
+
+			std::vector<double> masses(n, 0);
+			std::vector<int> found(n, 0);
+			for(size_t j = 0; j < n; ++j)
+			{
+				auto i = snapshot.GetLocalIndex(atomids[j]);
+				if(i != -1)
+				{
+					masses[j] = mass[i];
+					found[j] = 1;
+				}
+			}
+
+			MPI_Allreduce(MPI_IN_PLACE, masses.data(), n, MPI_DOUBLE, MPI_SUM, snapshot.GetCommunicator());
+			MPI_Allreduce(MPI_IN_PLACE, found.data(), n, MPI_INT, MPI_SUM, snapshot.GetCommunicator());
+			unsigned ntot = std::accumulate(found.begin(), found.end(), 0, std::plus<int>());
+			if(ntot != n)
+				throw BuildException({
+					name + ": Expected to find " + 
+					to_string(n) + 
+					" atoms, but only found " + 
+					to_string(ntot) + "."
+				});
+
+			return masses;
+		}
+	};
+
+	//! Collective variable to calculate root mean square displacement.
+	/*!
+	 * RMSD after optimal superposition onto one or more reference 
+	 * structures. Both structures are centered on their center of mass. The 
+	 * optimal rotation is found with the quaternion characteristic 
+	 * polynomial method of Theobald, Acta Cryst. A61: 478-480, 2005.
+	 *
+	 * Atoms may be spread across processors. Only the 3x3 correlation 
+	 * matrices are reduced, so the cost is linear in the number of atoms. If 
+	 * several references are given, the CV is the RMSD to the closest one.
+	 *
+	 * \ingroup CVs
+	 */
 	class RMSDCV : public CollectiveVariable
 	{
 	private:
+		Label atomids_; //!< IDs of the atoms used for RMSD calculation.
 
-		std::vector<int> atomids_; //!< IDs of the atoms used for Rg calculation
+		//! Names of the reference structure files.
+		std::vector<std::string> molecules_; 
 
-		std::vector<int> pertatoms_; //!< Array to store indicies of atoms of interest
+		//! Reference structures.
+		std::vector<ReferenceStructure> refs_;
 
-		//! Name of model structure.
-		std::string molecule_; 
+		//! RMSD to each reference.
+		std::vector<double> rmsds_;
 
-		//! Store reference structure coordinates.
-		std::vector<Vector3> refcoord_;
+		//! Index of closest reference.
+		size_t closest_;
 
-		//! Center of mass of reference.
-		Vector3 COMref_;
+		GroupCenterOfMass com_; //!< Center of mass of the atoms.
+		Label slots_; //!< Position in atomids_ of each local atom.
+		std::vector<Vector3> ris_; //!< Local positions relative to the COM.
+		size_t handle_; //!< CommPlan segment holding correlation matrices.
 
 	public:
 		//! Constructor.
 		/*!
-		 * \param atomids IDs of the atoms defining Rg.
-		 * \param molxyz String determining the molecule.
+		 * \param atomids IDs of the atoms defining RMSD.
+		 * \param molxyz Reference structure files (XYZ format).
 		 * \param use_range If \c True Use range of atoms defined by the two atoms in atomids.
 		 *
 		 * Construct a RMSD CV.
-		 *
-		 * \todo Bounds needs to be an input and periodic boundary conditions
 		 */
-		RMSDCV(std::vector<int> atomids, std::string molxyz, bool use_range = false) :
-		atomids_(atomids), molecule_(molxyz)
+		RMSDCV(const Label& atomids, const std::vector<std::string>& molxyz, bool use_range = false) :
+		atomids_(atomids), molecules_(molxyz), refs_(), rmsds_(), closest_(0), 
+		com_(), slots_(), ris_(), handle_(0)
 		{
 			if(use_range)
 			{
 				if(atomids.size() != 2)
-				{	std::cout<<"RMSDCV: If using range, must define only two atoms!"<<std::endl;
-					exit(0);
-				}
-
-				atomids_.clear();
+					throw BuildException({"RMSDCV: If using range, must define only two atoms!"});
 
 				if(atomids[0] >= atomids[1])
-				{	std::cout<<"RMSDCV: Please reverse atom range or check that atom range is not equal!"<<std::endl;
-					exit(0);
-				}					
-				for(int i = atomids[0]; i <= atomids[1];i++)
+					throw BuildException({"RMSDCV: Please reverse atom range or check that atom range is not equal!"});
+
+				atomids_.clear();
+				for(int i = atomids[0]; i <= atomids[1]; i++)
 					atomids_.push_back(i);
 			}
+
+			if(molecules_.empty())
+				throw BuildException({"RMSDCV: At least one reference structure is required."});
+		}
+
+		//! Constructor for a single reference.
+		/*!
+		 * \param atomids IDs of the atoms defining RMSD.
+		 * \param molxyz Reference structure file (XYZ format).
+		 * \param use_range If \c True Use range of atoms defined by the two atoms in atomids.
+		 */
+		RMSDCV(const Label& atomids, const std::string& molxyz, bool use_range = false) :
+		RMSDCV(atomids, std::vector<std::string>{molxyz}, use_range)
+		{
 		}
 
-		// Initialize variables
+		//! Initialize necessary variables.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 *
+		 * Reads the reference structures and centers them on the center of 
+		 * mass of the current atom masses.
+		 */
 		void Initialize(const Snapshot& snapshot) override
 		{
+			auto masses = ReferenceStructure::GatherMasses(snapshot, atomids_, "RMSDCV");
 
-			const auto& mass = snapshot.GetMasses();
-			const auto& ids = snapshot.GetAtomIDs();
+			refs_.resize(molecules_.size());
+			for(size_t k = 0; k < refs_.size(); ++k)
+				refs_[k].Load(molecules_[k], masses);
 
-			// Initialize gradient
-			auto n = snapshot.GetPositions().size();
-			grad_.resize(n);
-			refcoord_.resize(atomids_.size());
+			rmsds_.assign(molecules_.size(), 0);
+		}
 
-			std::vector<std::array<double,4>> xyzinfo = ReadFile::ReadXYZ(molecule_);
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
 
-			if(refcoord_.size() != xyzinfo.size())
-				throw std::runtime_error("Reference structure and input structure atom size do not match!");
+		//! Evaluate the CV.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 */
+		void Evaluate(const Snapshot& snapshot) override
+		{
+			EvaluateStaged(snapshot);
+		}
 
-			for(size_t i = 0; i < xyzinfo.size(); i++)
-			{
-				refcoord_[i][0] = xyzinfo[i][1];
-				refcoord_[i][1] = xyzinfo[i][2];
-				refcoord_[i][2] = xyzinfo[i][3];
-			}
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Two rounds for the center of mass and one for the 
+		 *         correlation matrices.
+		 */
+		int GetCommStages() const override { return 3; }
 
-			Vector3 mass_pos_prod_ref;
-			mass_pos_prod_ref.setZero();
-			double total_mass = 0;
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			using namespace Eigen;
 
-			// Loop through atom positions
-			for( size_t i = 0; i < mass.size(); ++i)
+			auto nrefs = refs_.size();
+
+			// Local atoms and their slots in the reference.
+			if(stage == 0)
 			{
-				// Loop through pertinent atoms
-				for(size_t j = 0; j < atomids_.size(); j++)
+				com_.indices.clear();
+				slots_.clear();
+				for(size_t j = 0; j < atomids_.size(); ++j)
 				{
-					if(ids[i] == atomids_[j])
+					auto i = snapshot.GetLocalIndex(atomids_[j]);
+					if(i != -1)
 					{
-						mass_pos_prod_ref += mass[i]*refcoord_[j];
-						total_mass += mass[i];
-						break;
+						com_.indices.push_back(i);
+						slots_.push_back(j);
 					}
 				}
 			}
 
-			COMref_ = mass_pos_prod_ref/total_mass;
-		}
+			if(stage < 3)
+				com_.Stage(snapshot, stage, plan);
+			if(stage < 2)
+				return;
 
-		// Evaluate the CV
-		void Evaluate(const Snapshot& snapshot) override
-		{
 			const auto& pos = snapshot.GetPositions();
-			const auto& ids = snapshot.GetAtomIDs();
-			const auto& mass = snapshot.GetMasses();
-			const auto& image_flags = snapshot.GetImageFlags();
-			Vector3 mass_pos_prod = {0,0,0};
-			double total_mass=0;
-			int i;
-			// Loop through atom positions
-			for( size_t i = 0; i < pos.size(); ++i)
+			const auto& idx = com_.indices;
+
+			// Local parts of the correlation matrices, the inner product 
+			// and the coordinate sum of the current structure.
+			if(stage == 2)
 			{
-				grad_[i].setZero();
-				// Loop through pertinent atoms
-				for(size_t j = 0; j < atomids_.size(); j++)
+				handle_ = plan.ReserveSum(9*nrefs + 4);
+				auto* local = plan.Local(handle_);
+				Map<Vector3> sum(local + 9*nrefs);
+				ris_.clear();
+				ris_.reserve(idx.size());
+				for(size_t t = 0; t < idx.size(); ++t)
 				{
-					if(ids[i] == atomids_[j])
-					{
-						pertatoms_[j] = i;
-						auto u_coord = snapshot.UnwrapVector(pos[i], image_flags[i]);
-
-						mass_pos_prod += mass[i]*u_coord;
-						total_mass += mass[i];
-						break;
-					}
+					ris_.emplace_back(snapshot.ApplyMinimumImage(pos[idx[t]] - com_.com));
+					const auto& x = ris_.back();
+					for(size_t k = 0; k < nrefs; ++k)
+						Map<Matrix3>(local + 9*k).noalias() += refs_[k].coords[slots_[t]]*x.transpose();
+					sum += x;
+					local[9*nrefs + 3] += x.squaredNorm();
 				}
+				return;
 			}
 
+			ClearGradient(snapshot.GetNumAtoms());
+			boxgrad_ = Matrix3::Zero();
 
-			// Calculate center of mass
-			//Vector3 mass_pos_prod;
-			//mass_pos_prod.setZero();
-			total_mass = 0;
-			Vector3 COM_;
-
-			// Need to unwrap coordinates for appropriate COM calculation. 
-
-			//for( size_t j = 0; j < pertatoms_.size(); ++j)
-			//{
-			//	i = pertatoms_[j];
-			//	auto u_coord = UnwrapCoordinates(snapshot.GetLatticeConstants(), image_flags[i], pos[i]);
-
-			//	mass_pos_prod[0] += mass[i]*u_coord[0];
-			//	mass_pos_prod[1] += mass[i]*u_coord[1];
-			//	mass_pos_prod[2] += mass[i]*u_coord[2];
-			//	total_mass += mass[i];
-			//}
-
-			COM_ = mass_pos_prod/total_mass;
+			auto* result = plan.Result(handle_);
+			Vector3 sum = Map<const Vector3>(result + 9*nrefs);
+			auto norm = result[9*nrefs + 3];
+			double n = atomids_.size();
 
-			// Build correlation matrix
-			Matrix3 R;
-
-			Vector3 diff;
-			Vector3 diff_ref;
-			double part_RMSD = 0;
-
-			for( size_t j = 0; j < pertatoms_.size(); ++j)
+			// Closest reference.
+			Matrix3 U = Matrix3::Identity();
+			val_ = std::numeric_limits<double>::infinity();
+			for(size_t k = 0; k < nrefs; ++k)
 			{
-				i = pertatoms_[j];
-				auto u_coord = snapshot.UnwrapVector(pos[i], image_flags[i]);
-
-				diff = u_coord -COM_;
-				diff_ref = refcoord_[j] - COMref_;
-
-				R(0,0) += diff[0]*diff_ref[0];
-				R(0,1) += diff[0]*diff_ref[1];
-				R(0,2) += diff[0]*diff_ref[2];
-				R(1,0) += diff[1]*diff_ref[0];
-				R(1,1) += diff[1]*diff_ref[1];
-				R(1,2) += diff[1]*diff_ref[2];
-				R(2,0) += diff[2]*diff_ref[0];
-				R(2,1) += diff[2]*diff_ref[1];
-				R(2,2) += diff[2]*diff_ref[2];
-
-
-				auto normdiff2 = diff.norm()*diff.norm();
-				auto normref2 = diff_ref.norm()*diff_ref.norm();
-
-				part_RMSD += (normdiff2 + normref2);
+				Matrix3 S = Map<const Matrix3>(result + 9*k);
+				auto E0 = 0.5*(norm + refs_[k].norm);
+				auto lambda = QCP::MaxEigenvalue(S, E0);
+				rmsds_[k] = std::sqrt(std::max(0., 2.*(E0 - lambda))/n);
+				if(rmsds_[k] < val_)
+				{
+					val_ = rmsds_[k];
+					closest_ = k;
+					U = QCP::Rotation(S, lambda);
+				}
 			}
 
-			Eigen::Matrix4d F;
-			F(0,0)= R(0,0) + R(1,1) + R(2,2);
-			F(1,0)= R(1,2) - R(2,1);
-			F(2,0)= R(2,0) - R(0,2);
-			F(3,0)= R(0,1) - R(1,0);
-			
-			F(0,1)= R(1,2) - R(2,1);
-			F(1,1)= R(0,0) - R(1,1) - R(2,2);
-			F(2,1)= R(0,1) + R(1,0);
-			F(3,1)= R(0,2) + R(2,0);
-
-			F(0,2)= R(2,0) - R(0,2);
-			F(1,2)= R(0,1) - R(1,0);
-			F(2,2)= -R(0,0) + R(1,1) - R(2,2);
-			F(3,2)= R(1,2) + R(2,1);
-
-			F(0,3)= R(0,1) - R(1,0);
-			F(1,3)= R(0,2) - R(2,0);
-			F(2,3)= R(1,2) - R(2,1);
-			F(3,3)= -R(0,0) - R(1,1) + R(2,2);
-			
-			//Find eigenvalues
-			Eigen::EigenSolver<Eigen::Matrix4d> es(F);
-			//EigenSolver<F> es;
-			//es.compute(F);
-			//auto max_lambda = es.eigenvalues().maxCoeff();
-			auto lambda = es.eigenvalues().real();
-			//double max_lambda;
-			auto max_lambda = lambda.maxCoeff();
-			int column;
-			
-
-			for (i =0; i < 4; ++i)
-				if(es.eigenvalues()[i] == max_lambda)
-					column=i;
-
-			// Calculate RMSD
-
-
-			auto RMSD = sqrt((part_RMSD - (2*max_lambda))/(atomids_.size()));
-
-			val_ = RMSD;
-
-			// Calculate gradient
-
-			auto eigenvector = es.eigenvectors().col(column);
-
-			auto q0 = eigenvector[0].real();
-			auto q1 = eigenvector[1].real();
-			auto q2 = eigenvector[2].real();
-			auto q3 = eigenvector[3].real();
-
-			Matrix3 RotMatrix(3,3);
-			RotMatrix(0,0) = q0*q0+q1*q1-q2*q2-q3*q3;
-			RotMatrix(1,0) = 2*(q1*q2+q0*q3);
-			RotMatrix(2,0) = 2*(q1*q3-q0*q2);
-
-			RotMatrix(0,1) = 2*(q1*q2-q0*q3);
-			RotMatrix(1,1) = q0*q0-q1*q1+q2*q2-q3*q3;
-			RotMatrix(2,1) = 1*(q2*q3+q0*q1);
-
-			RotMatrix(0,2) = 2*(q1*q3+q0*q2);
-			RotMatrix(1,2) = 2*(q2*q3-q0*q1);
-			RotMatrix(2,2) = q0*q0-q1*q1-q2*q2+q3*q3;
-
-			//double trans[3];
-			for(size_t j=0; j<pertatoms_.size();++j)
-			{
-				auto trans = RotMatrix.transpose()*refcoord_[j];
-
-				i = pertatoms_[j];
-				auto u_coord = pos[i]; //UnwrapCoordinates(snapshot.GetLatticeConstants(), image_flags[i], pos[i]);
+			// Gradient vanishes (and is ill-defined) at perfect overlap.
+			if(val_ == 0)
+				return;
 
-				grad_[i][0] = (u_coord[0] - trans[0])/((atomids_.size())*val_);
-				grad_[i][1] = (u_coord[1] - trans[1])/((atomids_.size())*val_);
-				grad_[i][2] = (u_coord[2] - trans[2])/((atomids_.size())*val_);
+			// The optimal rotation is stationary, so only the residuals
+			// e_i = x_i - U y_i and the center of mass contribute.
+			const auto& masses = snapshot.GetMasses();
+			const auto& ref = refs_[closest_].coords;
+			Vector3 esum = sum - U*refs_[closest_].sum;
+			for(size_t t = 0; t < idx.size(); ++t)
+			{
+				auto i = idx[t];
+				Vector3 e = ris_[t] - U*ref[slots_[t]];
+				AddGradient(i, (e - masses[i]/com_.mass*esum)/(n*val_));
 			}
 		}
 
+		//! Get the RMSD to each reference structure.
+		/*!
+		 * \return RMSDs from the last evaluation.
+		 */
+		const std::vector<double>& GetRMSDs() const { return rmsds_; }
+
+		//! Get the reference structure closest to the last evaluation.
+		/*!
+		 * \return Index of the reference.
+		 */
+		size_t GetClosestReference() const { return closest_; }
+
 		//! Serialize this CV for restart purposes.
 		/*!
 		 * \param json JSON value
@@ -299,7 +362,11 @@ namespace SSAGES
 		virtual void Serialize(Json::Value& json) const override
 		{
 			json["type"] = "RMSD";
-			json["reference"] = molecule_;
+			if(molecules_.size() == 1)
+				json["reference"] = molecules_[0];
+			else
+				for(auto& molecule : molecules_)
+					json["references"].append(molecule);
 			for(size_t i=0; i < atomids_.size(); ++i)
 				json["atom ids"].append(atomids_[i]);
 			for(size_t i = 0; i < bounds_.size(); ++i)
@@ -20,7 +20,7 @@
 
 #pragma once 
 
-#include "CollectiveVariable.h"
+#include "MultiCollectiveVariable.h"
 #include "Drivers/DriverException.h" 
 
 
@@ -32,17 +32,19 @@ namespace SSAGES
 	 *  Xp(t) ~ (1/N) sum_{i=1}^{N} ri(t)*cos[pi(n-0.5)p/N],
 	 *  where N is the number of particle groups, p is the mode index, ri is the center-of-mass position of
 	 *  a collection of atoms comprising the i'th bead in the N-bead polymer chain
+	 *
+	 *  Each mode p = 0..N-1 is a component. Requested modes share the 
+	 *  centers of mass and the unwrapped chain.
 	 *  \ingroup CVs
 	 */
-	class  RouseModeCV : public CollectiveVariable
+	class  RouseModeCV : public MultiCollectiveVariable
 	{
 	private:
 		std::vector<Label>     groups_; // vector of groups of indices to define the particle groups
 		std::vector<double>     massg_; // vector of the total mass for each particle group
-		int                         N_; // number of Rouse beads in polymer chain
-		int                         p_; // index of mode of interest as CV
-	    Vector3                    xp_; // 3d vector for containing vectorial rouse amplitude
+		size_t                      N_; // number of Rouse beads in polymer chain
 		std::vector<Vector3>        r_; // vector of coordinate positions for each bead
+		GroupCentersOfMass       coms_; // staged centers of mass of all groups
 	
 	public:
 		//! Basic Constructor for Rouse Mode CV
@@ -51,8 +53,26 @@ namespace SSAGES
 		 * \param p      - index for relevant Rouse mode
 		 */
 		RouseModeCV(const std::vector<Label>& groups, int p) : 
-		groups_(groups), p_(p), N_( groups_.size())
-		{ massg_.resize( groups_.size(),0.0 ); }
+		RouseModeCV(groups, std::vector<size_t>{static_cast<size_t>(p)})
+		{}
+
+		//! Constructor for several Rouse modes
+		/*!
+		 * \param groups - vector of vector of atom IDs, each group comprising a bead in the Rouse chain
+		 * \param modes  - indices of Rouse modes to compute, the first is the value of this CV
+		 */
+		RouseModeCV(const std::vector<Label>& groups, const std::vector<size_t>& modes) : 
+		MultiCollectiveVariable(groups.size(), modes), groups_(groups), N_(groups_.size())
+		{ massg_.resize( groups_.size(),0.0 ); coms_.groups = groups_; }
+
+		//! \copydoc MultiCollectiveVariable::GetNumComponents()
+		size_t GetNumComponents() const override { return N_; }
+
+		//! \copydoc MultiCollectiveVariable::GetComponentName()
+		std::string GetComponentName(size_t c) const override
+		{
+			return "mode " + std::to_string(c);
+		}
 
 		//! Helper function to determine masses of each group
 		/*! Note: this here assumes that the masses of each group are not changing during
@@ -78,13 +98,6 @@ namespace SSAGES
 		{
 			using std::to_string;
 
-			// Check for valid p_
-			if (p_ > groups_.size())
-				throw std::invalid_argument(
-					"RouseModeCV: Expected to find p to be less than " + 
-					to_string(groups_.size()) +" but found p = " + 
-					to_string(p_) 
-				);			
 			// Check for valid groups
 			for (size_t j = 0; j < groups_.size(); ++j) {
 				auto nj = groups_[j].size();
@@ -111,85 +124,108 @@ namespace SSAGES
 			this->setMasses( groups_, snapshot);
 		}
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			for(auto& group : groups_)
+				ids.insert(ids.end(), group.begin(), group.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
 		{
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return Two rounds for the group centers of mass.
+		 */
+		int GetCommStages() const override { return 2; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			// Compute the center of mass of all groups at once.
+			// Local indices are only looked up again after atoms migrate.
+			coms_.Stage(snapshot, stage, plan);
+			if (stage < GetCommStages())
+				return;
 
 			// Get data from snapshot.
 			auto          ntot = snapshot.GetNumAtoms(); // total number of atoms
 			const auto& masses = snapshot.GetMasses();   // mass of each atom
 
 			// Initialize working variables
-			double ppi_n = p_ * M_PI / N_;  // constant
-			xp_.fill(0.0);  	// vectorial Rouse mode
 			r_.resize(N_);		// position vector for beads in Rouse chain (unwrapped)
-			grad_.resize(ntot, Vector3{0,0,0});  // gradient set to 0.0 for all atoms
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-
-            // Iterate over all N_ atom groups and compute the center of mass for each
-		    std::vector<Vector3>     rcom; // vector of COM positions 
-            for (size_t i = 0; i < N_; ++i) {
-				Label idi;	// list of indices
-				snapshot.GetLocalIndices(groups_[i], &idi);
-				rcom.push_back(snapshot.CenterOfMass(idi,massg_[i])); // center of mass for group
-			}
+			ClearComponents(ntot);  // gradients set to 0.0 for all atoms
 
 			// Now compute differences vectors between the neighboring beads
 			// accumulate displacements to reconstruct unwrapped polymer chain
 			// for simplicity, we consider the first bead to be the reference position
 			// in all snapshots
-			r_[0] = rcom[0];
+			r_[0] = coms_.coms[0];
 			for (size_t i = 1; i< N_; ++i) {
-				Vector3 dri = snapshot.ApplyMinimumImage(rcom[i] - rcom[i-1]);
+				Vector3 dri = snapshot.ApplyMinimumImage(coms_.coms[i] - coms_.coms[i-1]);
 				r_[i] = r_[i-1] + dri;  // r_i = r_{i-1} + (r_i - r_{i-1})
 			}
 
-			// Determine the value of the Rouse coordinate
-			// Xp(t) = 1/sqrt(N) * sum_{i=1}^{N} ri, p = 0
-			// Xp(t) = sqrt(2/N) * sum_{i=1}^{N} ri * cos[p*pi/N*(i-0.5)], p = 1,...,N-1
-			// Note: this solution is valid for homogeneous friction
-			xp_.fill(0.0);
-			for (size_t i = 0; i<N_; ++i) {
-				xp_ += r_[i]*cos ( ppi_n * (i+0.5) );
-			}
-			xp_ /= sqrt(N_);
-			if ( p_ != 0 ) xp_ *= sqrt(2.0) ;
-
-			// Compute Rouse vector norm as the CV
-			// CV = sqrt(Xp*Xp), Xp = (Xp1,Xp2,Xp3)
-			val_ = xp_.norm();
-
-			// Now perform gradient operation
-			// dCV/dxjd = (Xpd/CV)*(c/N)**0.5*sum_i=1^N cos[p*pi(i-0.5)/N] mj/Mi *delta_j({i})
-			// delta_j({i}) = 1, if j in {i}, 0 otherwise
-			Vector3   gradpcon  = xp_ / sqrt(N_) / val_;
-			if ( p_ != 0) gradpcon *= sqrt(2.0);         // (Xpd/CV)*(c/N)**0.5
-            for (size_t i = 0; i < N_; ++i) {
-			    Label idi;	// list of indices
-			    snapshot.GetLocalIndices(groups_[i], &idi);
-			    // go over each atom in the group and add to its gradient
-			    // Note: performance tradeoff here. All gradient elements have a common factor of
-			    // Xpd/CV*sqrt(c/N) = prefactor, with c = 2 if p != 0
-			    // this could be factored out, but if ntot >> number of atoms in groups
-			    // then it won't be worth it to post multiply all gradient terms... 
-			    // Could also go over loop again after to do the multiplication, but 
-			    // that is troublesome if atom ids appear in multiple groups for some reason
-			    double cosval = cos(ppi_n*(i+0.5)) / massg_[i]; // cos[p*pi(i-0.5)/N] / Mi
-			    for (auto& id : idi) {
-			    	grad_[id] +=  gradpcon* cosval * masses[id];
-			    }
+			for (size_t p = 0; p < N_; ++p) {
+				if (!IsEnabled(p)) continue;
+
+				// Determine the value of the Rouse coordinate
+				// Xp(t) = 1/sqrt(N) * sum_{i=1}^{N} ri, p = 0
+				// Xp(t) = sqrt(2/N) * sum_{i=1}^{N} ri * cos[p*pi/N*(i-0.5)], p = 1,...,N-1
+				// Note: this solution is valid for homogeneous friction
+				double ppi_n = p * M_PI / N_;  // constant
+				Vector3 xp = Vector3::Zero();  // vectorial Rouse mode
+				for (size_t i = 0; i<N_; ++i) {
+					xp += r_[i]*cos ( ppi_n * (i+0.5) );
+				}
+				xp /= sqrt(N_);
+				if ( p != 0 ) xp *= sqrt(2.0) ;
+
+				// Compute Rouse vector norm as the CV
+				// CV = sqrt(Xp*Xp), Xp = (Xp1,Xp2,Xp3)
+				cvals_[p] = xp.norm();
+
+				// Now perform gradient operation
+				// dCV/dxjd = (Xpd/CV)*(c/N)**0.5*sum_i=1^N cos[p*pi(i-0.5)/N] mj/Mi *delta_j({i})
+				// delta_j({i}) = 1, if j in {i}, 0 otherwise
+				Vector3   gradpcon  = xp / sqrt(N_) / cvals_[p];
+				if ( p != 0) gradpcon *= sqrt(2.0);         // (Xpd/CV)*(c/N)**0.5
+				for (size_t i = 0; i < N_; ++i) {
+					const Label& idi = coms_.indices[i];	// list of indices
+					// go over each atom in the group and add to its gradient
+					double cosval = cos(ppi_n*(i+0.5)) / massg_[i]; // cos[p*pi(i-0.5)/N] / Mi
+					for (auto& id : idi) {
+						AddComponentGradient(p, id, gradpcon* cosval * masses[id]);
+					}
+				}
 			}
 
+			SelectComponent();
 		}
 
-		//! Serialize this CV for restart purposes.
+		//! Serialize a single mode for restart purposes.
 		/*!
+		 * \param c Rouse mode.
 		 * \param json JSON value
 		 */
-		void Serialize(Json::Value& json) const override
+		void SerializeComponent(size_t c, Json::Value& json) const override
 		{
 			json["type"] = "RouseMode";
 			for (int i = 0; i < (int) groups_.size(); ++i) {
@@ -197,7 +233,7 @@ namespace SSAGES
 					json["groups"][i][j] = groups_[i][j];
 				}
 			}
-			json["mode"] = p_;
+			json["mode"] = static_cast<int>(c);
 		}
 	};
 }
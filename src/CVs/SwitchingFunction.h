@@ -0,0 +1,400 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2017 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "JSON/Serializable.h"
+#include "Drivers/DriverException.h"
+#include "json/json.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Integer power by repeated squaring, unrolled at compile time.
+	template<unsigned N>
+	struct IntPow
+	{
+		//! Compute x^N.
+		static double Eval(double x) { return (N % 2 ? x : 1.)*IntPow<N/2>::Eval(x*x); }
+	};
+
+	//! Terminal case of IntPow.
+	template<>
+	struct IntPow<0>
+	{
+		//! Compute x^0.
+		static double Eval(double) { return 1.; }
+	};
+
+	//! Integer power by repeated squaring.
+	/*!
+	 * \param x Base.
+	 * \param n Exponent.
+	 * \return x^n.
+	 */
+	inline double IntPower(double x, unsigned n)
+	{
+		double y = 1.;
+		for(; n; n >>= 1, x *= x)
+			if(n & 1)
+				y *= x;
+		return y;
+	}
+
+	//! Switching function for counting neighbors.
+	/*!
+	 * Three smooth forms are available, with \f$x = (r - d_0)/r_0\f$:
+	 *
+	 * * Rational: \f$(1 - x^n)/(1 - x^m)\f$.
+	 * * Exponential: \f$\exp(-x)\f$, one for \f$r < d_0\f$.
+	 * * Gaussian: \f$\exp(-x^2/2)\f$, one for \f$r < d_0\f$.
+	 *
+	 * Beyond \f$d_{max}\f$ the function is zero. A function with a finite
+	 * cutoff may also be tabulated in \f$r^2\f$. The table is shifted to
+	 * vanish at the cutoff, so its value is continuous there.
+	 *
+	 * The batched interface works on squared distances and returns the
+	 * derivative divided by the distance, which is what pair gradients
+	 * need. Rational functions with even exponents and \f$d_0 = 0\f$,
+	 * Gaussians with \f$d_0 = 0\f$ and tables need no square root. The
+	 * loops carry no dependencies so the compiler can vectorize them.
+	 */
+	class SwitchingFunction : public Serializable
+	{
+	public:
+		//! Functional form.
+		enum Form
+		{
+			Rational, //!< Rational function.
+			Exponential, //!< Exponential decay.
+			Gaussian //!< Gaussian decay.
+		};
+
+	private:
+		Form form_; //!< Functional form.
+		double d0_; //!< Minimum linear shift value.
+		double r0_; //!< Cutoff distance.
+		int n_, m_; //!< Exponents of the switching function which controll the stiffness.
+		double dmax_; //!< Distance beyond which the function is zero.
+		bool truncated_; //!< Whether the function is zero beyond dmax.
+
+		size_t ntab_; //!< Number of table intervals, zero if not tabulated.
+		double dr2_; //!< Table spacing in squared distance.
+		std::vector<double> ftab_; //!< Tabulated values.
+		std::vector<double> dftab_; //!< Tabulated derivatives over distance.
+
+		//! Squared cutoff, the largest double if the function is not truncated.
+		double CutoffSquared() const
+		{
+			return truncated_ ? dmax_*dmax_ : std::numeric_limits<double>::max();
+		}
+
+		//! Whether the analytic form needs no square root.
+		bool IsSquaredForm() const
+		{
+			return d0_ == 0 && (form_ == Gaussian || 
+			       (form_ == Rational && n_ % 2 == 0 && m_ % 2 == 0));
+		}
+
+		//! Rational function of squared distance with even exponents and no shift.
+		template<unsigned N, unsigned M>
+		void RationalSquared(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			const auto ir02 = 1./(r0_*r0_);
+			const auto dmax2 = CutoffSquared();
+			for(size_t i = 0; i < n; ++i)
+			{
+				const auto x2 = r2[i]*ir02;
+				const auto xn = IntPow<N/2>::Eval(x2);
+				const auto xm = IntPow<M/2>::Eval(x2);
+				const auto den = 1./(1. - xm);
+				const auto fi = (1. - xn)*den;
+				const auto di = (M*IntPow<M/2-1>::Eval(x2)*fi - N*IntPow<N/2-1>::Eval(x2))*den*ir02;
+				f[i] = r2[i] <= dmax2 ? fi : 0.;
+				dfr[i] = r2[i] <= dmax2 ? di : 0.;
+			}
+		}
+
+		//! Rational function of squared distance with arbitrary even exponents.
+		void RationalSquared(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			const auto ir02 = 1./(r0_*r0_);
+			const auto dmax2 = CutoffSquared();
+			const unsigned hn = n_/2, hm = m_/2;
+			for(size_t i = 0; i < n; ++i)
+			{
+				const auto x2 = r2[i]*ir02;
+				const auto xn = IntPower(x2, hn);
+				const auto xm = IntPower(x2, hm);
+				const auto den = 1./(1. - xm);
+				const auto fi = (1. - xn)*den;
+				const auto di = (m_*IntPower(x2, hm-1)*fi - n_*IntPower(x2, hn-1))*den*ir02;
+				f[i] = r2[i] <= dmax2 ? fi : 0.;
+				dfr[i] = r2[i] <= dmax2 ? di : 0.;
+			}
+		}
+
+		//! Rational function of distance.
+		void RationalGeneral(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			const auto dmax2 = CutoffSquared();
+			for(size_t i = 0; i < n; ++i)
+			{
+				const auto r = std::sqrt(r2[i]);
+				const auto x = (r - d0_)/r0_;
+				const auto xn = IntPower(x, n_);
+				const auto xm = IntPower(x, m_);
+				const auto den = 1./(1. - xm);
+				const auto fi = (1. - xn)*den;
+				const auto di = (m_*IntPower(x, m_-1)*fi - n_*IntPower(x, n_-1))*den/(r0_*r);
+				f[i] = r2[i] <= dmax2 ? fi : 0.;
+				dfr[i] = r2[i] <= dmax2 ? di : 0.;
+			}
+		}
+
+		//! Exponential decay.
+		void ExponentialForm(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			const auto dmax2 = CutoffSquared();
+			for(size_t i = 0; i < n; ++i)
+			{
+				const auto r = std::sqrt(r2[i]);
+				const auto x = std::max(0., (r - d0_)/r0_);
+				const auto fi = std::exp(-x);
+				const auto di = x > 0 ? -fi/(r0_*r) : 0.;
+				f[i] = r2[i] <= dmax2 ? fi : 0.;
+				dfr[i] = r2[i] <= dmax2 ? di : 0.;
+			}
+		}
+
+		//! Gaussian decay.
+		void GaussianForm(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			const auto ir02 = 1./(r0_*r0_);
+			const auto dmax2 = CutoffSquared();
+			if(d0_ == 0)
+			{
+				for(size_t i = 0; i < n; ++i)
+				{
+					const auto fi = std::exp(-0.5*r2[i]*ir02);
+					f[i] = r2[i] <= dmax2 ? fi : 0.;
+					dfr[i] = r2[i] <= dmax2 ? -fi*ir02 : 0.;
+				}
+				return;
+			}
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				const auto r = std::sqrt(r2[i]);
+				const auto dr = std::max(0., r - d0_);
+				const auto fi = std::exp(-0.5*dr*dr*ir02);
+				f[i] = r2[i] <= dmax2 ? fi : 0.;
+				dfr[i] = r2[i] <= dmax2 ? -fi*dr*ir02/r : 0.;
+			}
+		}
+
+		//! Evaluate the analytic form.
+		void Analytic(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			if(form_ == Exponential)
+				return ExponentialForm(r2, n, f, dfr);
+			if(form_ == Gaussian)
+				return GaussianForm(r2, n, f, dfr);
+
+			if(d0_ != 0 || n_ % 2 || m_ % 2)
+				return RationalGeneral(r2, n, f, dfr);
+
+			// Common exponent pairs are unrolled.
+			if(n_ == 6 && m_ == 12)
+				return RationalSquared<6, 12>(r2, n, f, dfr);
+			if(n_ == 8 && m_ == 16)
+				return RationalSquared<8, 16>(r2, n, f, dfr);
+			if(n_ == 10 && m_ == 20)
+				return RationalSquared<10, 20>(r2, n, f, dfr);
+			if(n_ == 12 && m_ == 24)
+				return RationalSquared<12, 24>(r2, n, f, dfr);
+			RationalSquared(r2, n, f, dfr);
+		}
+
+		//! Interpolate the table linearly in squared distance.
+		void Interpolate(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			const auto idr2 = 1./dr2_;
+			const auto dmax2 = CutoffSquared();
+			for(size_t i = 0; i < n; ++i)
+			{
+				const auto t = std::min(r2[i], dmax2)*idr2;
+				const auto k = std::min(static_cast<size_t>(t), ntab_ - 1);
+				const auto w = t - k;
+				const auto fi = (1. - w)*ftab_[k] + w*ftab_[k+1];
+				const auto di = (1. - w)*dftab_[k] + w*dftab_[k+1];
+				f[i] = r2[i] <= dmax2 ? fi : 0.;
+				dfr[i] = r2[i] <= dmax2 ? di : 0.;
+			}
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param d0 Shift of the distance.
+		 * \param r0 Length scale.
+		 * \param n Exponent of the numerator (rational form).
+		 * \param m Exponent of the denominator (rational form).
+		 * \param dmax Cutoff beyond which the function is zero. The 
+		 *        function is not truncated unless the cutoff is positive.
+		 * \param form Functional form.
+		 */
+		SwitchingFunction(double d0, double r0, int n, int m,
+		                  double dmax = 0, Form form = Rational) :
+		form_(form), d0_(d0), r0_(r0), n_(n), m_(m), dmax_(dmax),
+		truncated_(dmax > 0), ntab_(0), dr2_(0), ftab_(), dftab_() {}
+
+		//! Tabulate the function.
+		/*!
+		 * \param npoints Number of table intervals.
+		 *
+		 * The table spans squared distances up to the cutoff and is shifted
+		 * to vanish there.
+		 */
+		void Tabulate(size_t npoints)
+		{
+			if(!truncated_ || npoints == 0)
+				throw BuildException({"SwitchingFunction: Tabulation requires \"dmax\" and at least one point."});
+
+			ntab_ = 0;
+			dr2_ = dmax_*dmax_/npoints;
+			std::vector<double> r2(npoints + 1);
+			for(size_t i = 0; i <= npoints; ++i)
+				r2[i] = i*dr2_;
+			r2[npoints] = dmax_*dmax_;
+
+			ftab_.resize(npoints + 1);
+			dftab_.resize(npoints + 1);
+			Analytic(r2.data(), r2.size(), ftab_.data(), dftab_.data());
+
+			// The derivative over distance diverges at zero unless the 
+			// form depends on the squared distance only.
+			if(!IsSquaredForm())
+				dftab_[0] = dftab_[1];
+
+			const auto fmax = ftab_.back();
+			for(auto& f : ftab_)
+				f -= fmax;
+
+			ntab_ = npoints;
+		}
+
+		//! Check whether the function is truncated.
+		/*!
+		 * \return \c TRUE if the function is zero beyond GetCutoff().
+		 */
+		bool IsTruncated() const { return truncated_; }
+
+		//! Get the cutoff distance.
+		/*!
+		 * \return Distance beyond which the function is truncated to zero.
+		 *         Only meaningful if IsTruncated() is \c TRUE.
+		 */
+		double GetCutoff() const { return dmax_; }
+
+		//! Evaluate the switching function for a batch of pairs.
+		/*!
+		 * \param r2 Squared distances.
+		 * \param n Number of pairs.
+		 * \param f Array receiving the function values.
+		 * \param dfr Array receiving the derivatives divided by distance.
+		 */
+		void Evaluate(const double* r2, size_t n, double* f, double* dfr) const
+		{
+			if(ntab_)
+				Interpolate(r2, n, f, dfr);
+			else
+				Analytic(r2, n, f, dfr);
+		}
+
+		//! Evaluate the switching function.
+		/*!
+		 * \param rij distance between two atoms.
+		 * \param df Reference to variable which will store the gradient.
+		 *
+		 * \return value of switching function.
+		 */
+		double Evaluate(double rij, double& df) const
+		{
+			double r2 = rij*rij, f, dfr;
+			Evaluate(&r2, 1, &f, &dfr);
+			df = dfr*rij;
+			return f;
+		}
+
+		//! Build SwitchingFunction from JSON value.
+		/*!
+		 * \param json JSON value node.
+		 *
+		 * \return New SwitchingFunction.
+		 */
+		static SwitchingFunction Build(const Json::Value& json)
+		{
+			auto type = json.get("type", "rational").asString();
+			Form form = Rational;
+			if(type == "exponential")
+				form = Exponential;
+			else if(type == "gaussian")
+				form = Gaussian;
+			else if(type != "rational")
+				throw BuildException({"SwitchingFunction: Unknown type \"" + type + "\"."});
+
+			SwitchingFunction sf(
+				json.get("d0", 0).asDouble(),
+				json["r0"].asDouble(),
+				json.get("n", 6).asInt(),
+				json.get("m", 12).asInt(),
+				json.get("dmax", 0).asDouble(),
+				form
+			);
+
+			if(json.isMember("tabulate"))
+				sf.Tabulate(json["tabulate"].asUInt());
+
+			return sf;
+		}
+
+		//! Serialize this switching function for restart purposes.
+		/*!
+		 * \param json JSON value
+		 */
+		void Serialize(Json::Value& json) const override
+		{
+			const char* types[] = {"rational", "exponential", "gaussian"};
+			json["type"] = types[form_];
+			json["d0"] = d0_;
+			json["r0"] = r0_;
+			json["n"] = n_;
+			json["m"] = m_;
+			if(truncated_)
+				json["dmax"] = dmax_;
+			if(ntab_)
+				json["tabulate"] = static_cast<Json::UInt>(ntab_);
+		}
+	};
+}
@@ -48,6 +48,12 @@ namespace SSAGES
 		//! If \c True, use periodic boundary conditions.
 		bool periodic_;
 
+		//! Local indices of the atoms, -1 if not local.
+		std::array<int, 4> indices_;
+
+		//! CommPlan segment holding the atom positions.
+		size_t handle_;
+
 	public:
 		//! Constructor.
 		/*!
@@ -62,7 +68,8 @@ namespace SSAGES
 		 * \todo Bounds needs to be an input and periodic boundary conditions
 		 */
 		TorsionalCV(int atomid1, int atomid2, int atomid3, int atomid4, bool periodic) : 
-		atomids_({atomid1, atomid2, atomid3, atomid4}), periodic_(periodic)
+		atomids_({atomid1, atomid2, atomid3, atomid4}), periodic_(periodic), 
+		indices_(), handle_(0)
 		{
 		}
 
@@ -88,39 +95,67 @@ namespace SSAGES
 				});		
 		}
 
+		//! Get the IDs of the atoms the CV depends on.
+		/*!
+		 * \param ids List to which the atom IDs are appended.
+		 * \return \c TRUE, the atom set is known.
+		 */
+		bool GetAtomSet(Label& ids) const override
+		{
+			ids.insert(ids.end(), atomids_.begin(), atomids_.end());
+			return true;
+		}
+
 		//! Evaluate the CV.
 		/*!
 		 * \param snapshot Current simulation snapshot.
 		 */
 		void Evaluate(const Snapshot& snapshot) override
 		{
-			// Get data from snapshot. 
-			auto n = snapshot.GetNumAtoms();
-			const auto& pos = snapshot.GetPositions();
-			auto& comm = snapshot.GetCommunicator();
-
-			// Initialize gradient.
-			std::fill(grad_.begin(), grad_.end(), Vector3{0,0,0});
-			grad_.resize(n, Vector3{0,0,0});
-
-			Vector3 xi{0, 0, 0}, xj{0, 0, 0}, xk{0, 0, 0}, xl{0, 0, 0};
-
-			auto iindex = snapshot.GetLocalIndex(atomids_[0]);
-			auto jindex = snapshot.GetLocalIndex(atomids_[1]);
-			auto kindex = snapshot.GetLocalIndex(atomids_[2]);
-			auto lindex = snapshot.GetLocalIndex(atomids_[3]);
-
-			if(iindex != -1) xi = pos[iindex];
-			if(jindex != -1) xj = pos[jindex];
-			if(kindex != -1) xk = pos[kindex];
-			if(lindex != -1) xl = pos[lindex];
-
-			// By performing a reduce, we actually collect all. This can 
-			// be converted to a more intelligent allgater on rank then bcast. 
-			MPI_Allreduce(MPI_IN_PLACE, xi.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, xj.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, xk.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, xl.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
+			EvaluateStaged(snapshot);
+		}
+
+		//! Get the number of communication rounds.
+		/*!
+		 * \return One round to collect the four atom positions.
+		 */
+		int GetCommStages() const override { return 1; }
+
+		//! Perform one stage of the evaluation.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param stage Stage of the evaluation.
+		 * \param plan Communication plan.
+		 */
+		void EvaluateStage(const Snapshot& snapshot, int stage, CommPlan& plan) override
+		{
+			if(stage == 0)
+			{
+				// Get data from snapshot. 
+				auto n = snapshot.GetNumAtoms();
+				const auto& pos = snapshot.GetPositions();
+
+				// Initialize gradient.
+				ClearGradient(n);
+
+				// Positions are collected by a sum, with each atom 
+				// contributed by the rank that owns it. 
+				handle_ = plan.ReserveSum(12);
+				auto* x = plan.Local(handle_);
+				for(int i = 0; i < 4; ++i)
+				{
+					indices_[i] = snapshot.GetLocalIndex(atomids_[i]);
+					if(indices_[i] != -1)
+						std::copy(pos[indices_[i]].data(), pos[indices_[i]].data() + 3, x + 3*i);
+				}
+				return;
+			}
+
+			auto* r = plan.Result(handle_);
+			Vector3 xi{r[0], r[1], r[2]}, xj{r[3], r[4], r[5]}, 
+			        xk{r[6], r[7], r[8]}, xl{r[9], r[10], r[11]};
+			auto iindex = indices_[0], jindex = indices_[1], 
+			     kindex = indices_[2], lindex = indices_[3];
 			
 			//Calculate pertinent vectors
 			auto F = snapshot.ApplyMinimumImage(xi - xj);
@@ -137,15 +172,14 @@ namespace SSAGES
 			auto Zed = F.dot(G.normalized())/A.dot(A); 
 			auto Ned = H.dot(G.normalized())/B.dot(B);
 
-			Vector3 gradi{0,0,0}, gradl{0,0,0}; 
-			if(iindex != -1) gradi = -G.norm()*A/A.dot(A);
-			if(lindex != -1) gradl = G.norm()*B/B.dot(B);
-			MPI_Allreduce(MPI_IN_PLACE, gradi.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			MPI_Allreduce(MPI_IN_PLACE, gradl.data(), 3, MPI_DOUBLE, MPI_SUM, comm);
-			if(iindex != -1) grad_[iindex] = gradi;
-			if(lindex != -1) grad_[lindex] = gradl;
-			if(jindex != -1) grad_[jindex] = Zed*A - Ned*B - gradi;
-			if(kindex != -1) grad_[kindex] = Ned*B  - Zed*A - gradl;
+			// Every rank knows all positions, so the outer gradients 
+			// need no further communication.
+			Vector3 gradi = -G.norm()*A/A.dot(A);
+			Vector3 gradl = G.norm()*B/B.dot(B);
+			if(iindex != -1) AddGradient(iindex, gradi);
+			if(lindex != -1) AddGradient(lindex, gradl);
+			if(jindex != -1) AddGradient(jindex, Zed*A - Ned*B - gradi);
+			if(kindex != -1) AddGradient(kindex, Ned*B  - Zed*A - gradl);
 		}
 
 		//! Return value taking periodic boundary conditions into account
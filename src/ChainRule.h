@@ -0,0 +1,99 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Snapshot.h"
+#include "CVs/CollectiveVariable.h"
+#include <vector>
+
+namespace SSAGES
+{
+	//! Applies CV biases to the atoms through the chain rule.
+	/*!
+	 * \ingroup core
+	 *
+	 * Methods only provide the derivatives of their bias potential with 
+	 * respect to each CV, dV/dCV. This class turns them into per-atom 
+	 * forces, F_j -= dV/dCV_i * dCV_i/dx_j, and a virial contribution, 
+	 * W += dV/dCV_i * dCV_i/dH, using the sparse CV gradients.
+	 */
+	class ChainRule
+	{
+	public:
+		//! Apply bias forces and virial to a snapshot.
+		/*!
+		 * \param cvs List of CVs.
+		 * \param derivatives dV/dCV for each CV. May be shorter than \c cvs,
+		 *        in which case the remaining CVs are not biased.
+		 * \param snapshot Snapshot receiving the forces and virial.
+		 *
+		 * The snapshot is only touched if at least one derivative is
+		 * non-zero.
+		 */
+		static void Apply(const CVList& cvs, 
+		                  const std::vector<double>& derivatives, 
+		                  Snapshot* snapshot)
+		{
+			auto ncv = std::min(cvs.size(), derivatives.size());
+
+			bool biased = false;
+			for(size_t i = 0; i < ncv; ++i)
+				biased = biased || derivatives[i] != 0;
+
+			if(!biased)
+				return;
+
+			auto* forces = snapshot->GetForces().data();
+			auto& virial = snapshot->GetVirial();
+
+			for(size_t i = 0; i < ncv; ++i)
+			{
+				const auto D = derivatives[i];
+				if(D == 0)
+					continue;
+
+				const auto& grad = cvs[i]->GetSparseGradient();
+				const auto* indices = grad.indices.data();
+				const auto* values = grad.values.data();
+				const auto n = grad.size();
+
+				for(size_t j = 0; j < n; ++j)
+					forces[indices[j]] -= D*values[j];
+
+				virial += D*cvs[i]->GetBoxGradient();
+			}
+		}
+
+		//! Accumulate bias derivatives.
+		/*!
+		 * \param derivatives Derivatives dV/dCV of one bias.
+		 * \param total Running sum of derivatives, grown as needed.
+		 */
+		static void Accumulate(const std::vector<double>& derivatives, 
+		                       std::vector<double>& total)
+		{
+			if(total.size() < derivatives.size())
+				total.resize(derivatives.size(), 0);
+
+			for(size_t i = 0; i < derivatives.size(); ++i)
+				total[i] += derivatives[i];
+		}
+	};
+}
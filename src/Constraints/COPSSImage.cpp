@@ -37,7 +37,8 @@ namespace SSAGES
 	{
 
 		// Gather information
-  		auto& types = snapshot->GetAtomTypes();
+  		const auto* csnapshot = snapshot;
+  		auto& types = csnapshot->GetAtomTypes();
   	        size_t nlocal_ = snapshot->GetNumAtoms();
 
 		#ifdef DEBUG_SNAPSHOT_
@@ -137,9 +138,10 @@ namespace SSAGES
 				    size_t kth)
 	{
 		//fprintf(stdout, "compute: (%d, %d, %d)\n", ith, jth, kth);
-                auto& types_  = snapshot->GetAtomTypes();
-                auto& charges_ = snapshot->GetCharges();
-                auto& positions_ = snapshot->GetPositions();
+                const auto* csnapshot = snapshot;
+                auto& types_  = csnapshot->GetAtomTypes();
+                auto& charges_ = csnapshot->GetCharges();
+                auto& positions_ = csnapshot->GetPositions();
                 auto& forces_ = snapshot->GetForces();
 		 eouter_ = snapshot->GetDielectric();
                 qqrd2e_ = snapshot->Getqqrd2e();	
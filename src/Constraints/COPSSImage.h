@@ -181,6 +181,9 @@ namespace SSAGES
 		//! Post-simulation hook
 		void PostSimulation(Snapshot*, const CVList&) override;
 
+		//! Needs no thermodynamic quantities.
+		unsigned GetThermoNeeds(int) const override { return NoThermo; }
+
 		//! Serialize the class
 		/*!
 		 * \warning Serialization not yet implemented.
@@ -84,6 +84,9 @@ namespace SSAGES
 		//! Read a restart file
 		bool readrestart_;
 
+		//! Number of threads for CV evaluation
+		unsigned int threads_;
+
 		//! Random number generators for setting seeds
 		std::random_device rd_;
 
@@ -103,7 +106,7 @@ namespace SSAGES
 		world_(world), comm_(comm), wid_(walkerID),
 		hook_(nullptr), snapshot_(nullptr), method_(nullptr), CVs_(),
 		iterations_(0), observers_(), inputfile_("none"), restartname_(),
-		readrestart_(), rd_(), gen_(rd_())
+		readrestart_(), threads_(1), rd_(), gen_(rd_())
 		 {}
 
 		//! Destructor
@@ -237,6 +240,8 @@ namespace SSAGES
 				//Set the driver in the hook
 				hook_->SetMDDriver(this);
 
+				hook_->SetThreads(threads_);
+
 			    if(method_)
 				    hook_->AddListener(method_);
 
@@ -257,12 +262,16 @@ namespace SSAGES
 
 			auto& tmp = json["CVs"];
 			for(unsigned int i = 0; i < CVs_.size();i++)
+			{
 				CVs_[i]->Serialize(tmp[i]);
+				CVs_[i]->SerializeStride(tmp[i]);
+			}
 
 			json["inputfile"] = inputfile_;
 			json["number processors"] = comm_.size();
 			json["restart file"] = restartname_;
 			json["read restart"] = readrestart_;
+			json["threads"] = threads_;
 		}
 
      	// Accept a visitor.
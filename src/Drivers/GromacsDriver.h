@@ -114,6 +114,7 @@ namespace SSAGES
 		{
 			inputfile_ = json.get("inputfile","none").asString();
 			iterations_ = json.get("MDSteps", 1).asInt();
+			threads_ = json.get("threads", 1).asUInt();
 
 			// Set hook. 
 			auto& hook = GromacsHook::Instance();
@@ -152,6 +152,7 @@ namespace SSAGES
 				throw BuildException(validator.GetErrors());
 
 			iterations_ = json.get("MDSteps",1).asInt();
+			threads_ = json.get("threads", 1).asUInt();
 			inputfile_ = json.get("inputfile","none").asString();
 			restartname_ = json.get("restart file", "none").asString();
 			readrestart_ = json.get("read restart", false).asBool();
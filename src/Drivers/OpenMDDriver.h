@@ -101,6 +101,7 @@ namespace SSAGES
 		{
 			inputfile_ = json.get("inputfile","none").asString();
 			MDSteps_ = json.get("MDSteps", 1).asInt();
+			threads_ = json.get("threads", 1).asUInt();
 
 			// Set hook. 
 			auto& hook = OpenMDHook::Instance();
@@ -69,6 +69,7 @@ namespace SSAGES
 		{
 			inputfile_ = json.get("inputfile","none").asString();
 			mdsteps_ = json.get("MDSteps", 1).asInt();
+			threads_ = json.get("threads", 1).asUInt();
 
 			// Set hook. 
 			qbhook_ = new QboxHook();
@@ -21,11 +21,13 @@
 #pragma once 
 
 #include "types.h"
+#include <vector>
 
 namespace SSAGES
 {
 	// Forward declare. 
 	class Snapshot;
+	class ThreadPool;
 
 	//! Base abstract class for listening in to events fired by "Hook".
 	/*!
@@ -35,14 +37,36 @@ namespace SSAGES
 	{
 	private:
 		unsigned int frequency_; //!< Frequency for listening.
+
+	protected:
+		//! Derivatives of the bias potential with respect to each CV.
+		/*!
+		 * A listener that biases CVs stores dV/dCV here during 
+		 * PostIntegration. The Hook then applies the resulting forces and 
+		 * virial through the chain rule. Entries left empty or zero do not 
+		 * bias the corresponding CV.
+		 */
+		std::vector<double> derivatives_;
+
+		//! Threads shared with the hook, or null to run serially.
+		ThreadPool* pool_;
 	
 	public:
+		//! Thermodynamic quantities which listeners may read.
+		enum Thermo : unsigned
+		{
+			NoThermo = 0, //!< Nothing.
+			Energy = 1 << 0, //!< Total energy.
+			Temperature = 1 << 1, //!< Temperature.
+			AllThermo = Energy | Temperature //!< All quantities.
+		};
+
 		//! Constructor
 		/*!
 		 * \param frequency Frequency for listening.
 		 */
 		EventListener(unsigned int frequency) : 
-		frequency_(frequency)
+		frequency_(frequency), derivatives_(0), pool_(nullptr)
 		{
 
 		}
@@ -53,6 +77,44 @@ namespace SSAGES
 		 */
 		unsigned int GetFrequency() const { return frequency_; }
 
+		//! Get bias derivatives.
+		/*!
+		 * \return Derivatives dV/dCV from the last call to PostIntegration.
+		 */
+		const std::vector<double>& GetBiasDerivatives() const { return derivatives_; }
+
+		//! Set the threads available to the listener.
+		/*!
+		 * \param pool Thread pool owned by the hook, or null.
+		 *
+		 * Listeners may use the pool for loops within their hooks, such
+		 * as sweeps over a grid. The pool is not available to other
+		 * threads and must not be used for MPI calls.
+		 */
+		void SetThreadPool(ThreadPool* pool) { pool_ = pool; }
+
+		//! Check whether the listener needs every atom in the snapshot.
+		/*!
+		 * \return \c TRUE if the listener reads or modifies atoms other 
+		 *         than those of the CVs.
+		 *
+		 * Listeners which only act through CV values and bias derivatives 
+		 * should return \c FALSE. This allows hooks to synchronize only the 
+		 * atoms the CVs depend on.
+		 */
+		virtual bool RequiresFullSync() const { return true; }
+
+		//! Get the thermodynamic quantities needed at an iteration.
+		/*!
+		 * \param iteration Iteration at which the listener is called.
+		 * \return Combination of Thermo flags.
+		 *
+		 * Computing energies is expensive for some engines, so hooks only 
+		 * acquire the quantities requested by the listeners called at a 
+		 * given iteration. Otherwise the snapshot holds stale values.
+		 */
+		virtual unsigned GetThermoNeeds(int) const { return AllThermo; }
+
 		//! Method call prior to simulation initiation.
 		/*!
 		 * \param snapshot Pointer to the simulation snapshot.
@@ -19,6 +19,7 @@
  */
 #pragma once
 
+#include <array>
 #include <exception>
 
 #include "Drivers/DriverException.h"
@@ -35,9 +36,44 @@ namespace Json {
 namespace SSAGES
 {
 
+//! Index and point types of a grid with D dimensions.
+/*!
+ * \tparam D Number of dimensions, or 0 if only known at run time.
+ */
+template<size_t D>
+struct GridTraits
+{
+    //! Grid indices.
+    typedef std::array<int, D> Indices;
+
+    //! Point in space.
+    typedef std::array<double, D> Point;
+
+    //! Size a container for the grid dimension.
+    template<typename C>
+    static void Resize(C&, size_t) {}
+};
+
+//! Index and point types of a grid whose dimension is set at run time.
+template<>
+struct GridTraits<0>
+{
+    //! Grid indices.
+    typedef std::vector<int> Indices;
+
+    //! Point in space.
+    typedef std::vector<double> Point;
+
+    //! Size a container for the grid dimension.
+    template<typename C>
+    static void Resize(C& c, size_t n) { c.resize(n); }
+};
+
 //! Basic Grid.
 /*!
  * \tparam T type of data to be stored in the grid.
+ * \tparam D number of dimensions, or 0 (default) if the dimension is only
+ *           known at run time.
  *
  * A Grid is a method to store data in SSAGES. It is used to discretize a
  * continuous number, typically a collective variable or a function, into
@@ -56,40 +92,38 @@ namespace SSAGES
  * Note that n follows the C/C++ convention, i.e. n = 0 for the first interval.
  * The bin indices pertaining to a given point can be obtained via GetIndices().
  *
+ * If the dimension is fixed at compile time, indices and points are passed
+ * as std::array and lookups run over loops of constant length, using the
+ * precomputed strides and inverse spacings. Nothing is allocated per lookup.
+ * With D = 0 the same interface takes std::vector, which is what grids built
+ * from input files use.
+ *
  * \ingroup Core
  */
-template<typename T>
+template<typename T, size_t D = 0>
 class Grid : public GridBase<T>
 {
+public:
+    //! Grid indices, std::array for fixed dimensions.
+    typedef typename GridTraits<D>::Indices Indices;
+
+    //! Point in space, std::array for fixed dimensions.
+    typedef typename GridTraits<D>::Point Point;
+
 private:
-    //! Map d-dimensional indices to 1-d data vector
-    /*!
-     * \param indices Vector specifying the grid point.
-     * \return Index of 1d data vector.
-     *
-     * Map a set of indices to the index of the 1d data vector. Keep in mind,
-     * that the data includes underflow (index -1) and overflow (index
-     * numPoints) bins in periodic dimension.
-     */
-    size_t mapTo1d(const std::vector<int> &indices) const override
+    //! Number of dimensions, a compile time constant if D > 0.
+    size_t Dim() const
     {
-        // Check if an index is out of bounds
-        for (size_t i=0; i < GridBase<T>::GetDimension(); ++i) {
-            int index = indices.at(i);
-            int numpoints = GridBase<T>::GetNumPoints(i);
-            if ( index < 0 || index >= numpoints )
-            {
-                throw std::out_of_range("Grid index out of range.");
-            }
-        }
+        return D ? D : GridBase<T>::dimension_;
+    }
 
-        size_t idx = 0;
-        size_t fac = 1;
-        for (size_t i=0; i < GridBase<T>::GetDimension(); ++i) {
-            idx += indices.at(i) * fac;
-            fac *= GridBase<T>::GetNumPoints(i);
+    //! Check the size of indices or points, a no-op for fixed dimensions.
+    void CheckSize(size_t n) const
+    {
+        if (n != Dim()) {
+            throw std::invalid_argument("Dimension of indices or point does "
+                    "not match dimension of the grid.");
         }
-        return idx;
     }
 
 public:
@@ -110,13 +144,148 @@ public:
               std::vector<bool> isPeriodic)
       : GridBase<T>(numPoints, lower, upper, isPeriodic)
     {
-        size_t data_size = 1;
-        for (size_t d = 0; d < GridBase<T>::GetDimension(); ++d) {
-            size_t storage_size = GridBase<T>::GetNumPoints(d);
-            data_size *= storage_size;
+        if (D && GridBase<T>::GetDimension() != D) {
+            throw std::invalid_argument("Number of grid points does not match "
+                    "the dimension of the grid.");
         }
 
-        GridBase<T>::data_.resize(data_size);
+        GridBase<T>::InitLayout(false);
+    }
+
+    using GridBase<T>::GetIndices;
+    using GridBase<T>::GetCoordinates;
+    using GridBase<T>::at;
+    using GridBase<T>::operator[];
+
+    //! Return the Grid indices for a given point.
+    /*!
+     * \param x Point in space.
+     * \return Indices of the grid point to which the point pertains.
+     */
+    Indices GetIndices(const Point &x) const
+    {
+        CheckSize(x.size());
+
+        Indices indices;
+        GridTraits<D>::Resize(indices, Dim());
+        for (size_t i = 0; i < Dim(); ++i) {
+            indices[i] = GridBase<T>::GetIndex(i, x[i]);
+        }
+        return indices;
+    }
+
+    //! Return coordinates of the grid center points
+    /*!
+     * \param indices Grid indices specifying a grid point.
+     * \return Position of the grid point.
+     */
+    Point GetCoordinates(const Indices &indices) const
+    {
+        CheckSize(indices.size());
+
+        Point x;
+        GridTraits<D>::Resize(x, Dim());
+        for (size_t i = 0; i < Dim(); ++i) {
+            x[i] = GridBase<T>::GetCoordinate(i, indices[i]);
+        }
+        return x;
+    }
+
+    //! Return the position of a grid point in the storage vector.
+    /*!
+     * \param indices Grid indices specifying a grid point.
+     * \return Index into data().
+     */
+    size_t GetFlatIndex(const Indices &indices) const
+    {
+        CheckSize(indices.size());
+
+        size_t idx = 0;
+        for (size_t i = 0; i < Dim(); ++i) {
+            idx += GridBase<T>::storageIndex(i, indices[i])*GridBase<T>::strides_[i];
+        }
+        return idx;
+    }
+
+    //! Return the position of the grid point containing x in the storage vector.
+    /*!
+     * \param x Point in space.
+     * \return Index into data().
+     */
+    size_t GetFlatIndexAt(const Point &x) const
+    {
+        CheckSize(x.size());
+
+        size_t idx = 0;
+        for (size_t i = 0; i < Dim(); ++i) {
+            auto k = GridBase<T>::GetIndex(i, x[i]);
+            idx += GridBase<T>::storageIndex(i, k)*GridBase<T>::strides_[i];
+        }
+        return idx;
+    }
+
+    //! Access Grid element read-only
+    /*!
+     * \param indices Grid indices specifying the grid point.
+     * \return Const reference to the value at the given grid point.
+     */
+    const T& at(const Indices &indices) const
+    {
+        return GridBase<T>::data_[GetFlatIndex(indices)];
+    }
+
+    //! Access Grid element read/write
+    /*!
+     * \param indices Grid indices specifying the grid point.
+     * \return Reference to the value at the given grid point.
+     */
+    T& at(const Indices &indices)
+    {
+        return GridBase<T>::data_[GetFlatIndex(indices)];
+    }
+
+    //! Access Grid element pertaining to a specific point -- read-only
+    /*!
+     * \param x Point in space.
+     * \return Const reference to the value at the given coordinates.
+     */
+    const T& at(const Point &x) const
+    {
+        return GridBase<T>::data_[GetFlatIndexAt(x)];
+    }
+
+    //! Access Grid element pertaining to a specific point -- read/write
+    /*!
+     * \param x Point in space.
+     * \return Reference to the value at the given coordinates.
+     */
+    T& at(const Point &x)
+    {
+        return GridBase<T>::data_[GetFlatIndexAt(x)];
+    }
+
+    //! \copydoc Grid::at(const Indices&) const
+    const T& operator[](const Indices &indices) const
+    {
+        return at(indices);
+    }
+
+    //! \copydoc Grid::at(const Indices&)
+    T& operator[](const Indices &indices)
+    {
+        return at(indices);
+    }
+
+    //! \copydoc Grid::at(const Point&) const
+    const T& operator[](const Point &x) const
+    {
+        return at(x);
+    }
+
+    //! \copydoc Grid::at(const Point&)
+    T& operator[](const Point &x)
+    {
+        return at(x);
     }
 
     //! Set up the grid
@@ -128,7 +297,7 @@ public:
      * if an unknown error occured, but generally, it will throw a
      * BuildException of failure.
      */
-    static Grid<T>* BuildGrid(const Json::Value& json)
+    static Grid<T, D>* BuildGrid(const Json::Value& json)
     {
         return BuildGrid(json, "#/Grid");
     }
@@ -143,7 +312,7 @@ public:
      * if an unknown error occured, but generally, it will throw a
      * BuildException on failure.
      */
-    static Grid<T>* BuildGrid(const Json::Value& json, const std::string& path)
+    static Grid<T, D>* BuildGrid(const Json::Value& json, const std::string& path)
     {
         Json::ObjectRequirement validator;
         Json::Value schema;
@@ -165,6 +334,11 @@ public:
         }
 
         size_t dimension = lower.size();
+        if (D && dimension != D) {
+            throw BuildException({"Grid requires " + std::to_string(D) +
+                                  " dimensions, but " +
+                                  std::to_string(dimension) + " were given!"});
+        }
 
         // Read in upper grid edges.
         std::vector<double> upper;
@@ -202,7 +376,7 @@ public:
         }
 
         // Construct the grid.
-        Grid<T>* grid = new Grid(number_points, lower, upper, isPeriodic);
+        Grid<T, D>* grid = new Grid(number_points, lower, upper, isPeriodic);
 
         return grid;
     }
@@ -283,7 +457,7 @@ public:
          *                iterator.
          * \param hist Pointer to the grid to iterate over.
          */
-        GridIterator(const std::vector<int> &indices, Grid<T> *grid)
+        GridIterator(const std::vector<int> &indices, Grid<T, D> *grid)
             : indices_(indices), grid_(grid)
         {
         }
@@ -507,7 +681,7 @@ public:
         std::vector<int> indices_;
 
         //! Pointer to grid to iterate over.
-        Grid<T> *grid_;
+        Grid<T, D> *grid_;
     };
 
     //! Custom iterator over a grid.
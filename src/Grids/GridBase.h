@@ -19,10 +19,16 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <exception>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 
+#include "JSON/Serializable.h"
+#include "Utility/ThreadPool.h"
+
 namespace SSAGES
 {
 
@@ -53,34 +59,121 @@ protected:
     //! Periodicity of the Grid.
     std::vector<bool> isPeriodic_;
 
+    //! Grid spacing in each dimension.
+    std::vector<double> spacing_;
+
+    //! Inverse grid spacing in each dimension.
+    std::vector<double> invSpacing_;
+
+    //! Distance in the storage vector between neighbors in each dimension.
+    std::vector<size_t> strides_;
+
+    //! Storage offset of index 0 in each dimension.
+    /*!
+     * The offset is 1 in dimensions with an underflow bin and 0 otherwise.
+     */
+    std::vector<int> offsets_;
+
+    //! Set up the storage layout.
+    /*!
+     * \param overflow If \c True, each non-periodic dimension gets an
+     *                 underflow and an overflow bin.
+     *
+     * Computes the strides and allocates the storage. The first dimension
+     * is stored contiguously. Child classes call this from their
+     * constructors.
+     */
+    void InitLayout(bool overflow)
+    {
+        strides_.resize(dimension_);
+        offsets_.resize(dimension_);
+
+        size_t data_size = 1;
+        for (size_t d = 0; d < dimension_; ++d) {
+            offsets_[d] = (overflow && !isPeriodic_[d]) ? 1 : 0;
+            strides_[d] = data_size;
+            data_size *= numPoints_[d] + 2*offsets_[d];
+        }
+
+        data_.resize(data_size);
+    }
+
     //! Wrap the index around periodic boundaries
     std::vector<int> wrapIndices(const std::vector<int> &indices) const
     {
         std::vector<int> newIndices(indices);
         for (size_t i=0; i<dimension_; ++i) {
-            if (!GetPeriodic(i)) {
-                continue;
+            if (isPeriodic_[i]) {
+                newIndices[i] = wrapIndex(i, indices[i]);
             }
-
-            int index = indices.at(i);
-            while (index < 0) { index += GetNumPoints(i); }
-            while (index >= GetNumPoints(i)) { index -= GetNumPoints(i); }
-            newIndices.at(i) = index;
         }
 
         return newIndices;
     }
 
-    //! This function needs to be implemented by child classes.
+    //! Wrap a single index around a periodic boundary.
+    /*!
+     * \param dim Index of the dimension.
+     * \param index Grid index in this dimension.
+     * \return Index in the interval [0, numPoints).
+     */
+    int wrapIndex(size_t dim, int index) const
+    {
+        index %= numPoints_[dim];
+        return index < 0 ? index + numPoints_[dim] : index;
+    }
+
+    //! Map d-dimensional indices to the 1d storage vector.
     /*!
+     * \tparam I Indexable container of ints, e.g. std::vector or std::array.
      * \param indices The indices specifying the grid point.
      * \return Index of the grid point in the 1d storage vector.
      *
-     * mapTo1d maps the indices onto a single index to access the data stored
-     * in the data_ vector. This mapping will be different for different grid
-     * implementations.
+     * Indices outside of the grid, including the under- and overflow bins
+     * if the storage has none, raise std::out_of_range.
+     */
+    template<typename I>
+    size_t mapTo1d(const I &indices) const
+    {
+        size_t idx = 0;
+        for (size_t i = 0; i < dimension_; ++i) {
+            idx += storageIndex(i, indices[i])*strides_[i];
+        }
+        return idx;
+    }
+
+    //! Storage position of an index along one dimension.
+    /*!
+     * \param dim Index of the dimension.
+     * \param index Grid index in this dimension.
+     * \return Position along the dimension in the storage layout.
+     */
+    size_t storageIndex(size_t dim, int index) const
+    {
+        int k = index + offsets_[dim];
+        if (k < 0 || k >= numPoints_[dim] + 2*offsets_[dim]) {
+            throw std::out_of_range("Grid index out of range.");
+        }
+        return k;
+    }
+
+    //! Map a point in space to the 1d storage vector.
+    /*!
+     * \tparam P Indexable container of doubles.
+     * \param x Point in space.
+     * \return Index of the grid point containing x in the storage vector.
+     *
+     * Identical to mapTo1d(GetIndices(x)), without temporaries.
      */
-    virtual size_t mapTo1d(const std::vector<int> &indices) const = 0;
+    template<typename P>
+    size_t mapPointTo1d(const P &x) const
+    {
+        size_t idx = 0;
+        for (size_t i = 0; i < dimension_; ++i) {
+            idx += storageIndex(i, GetIndex(i, x[i]))*strides_[i];
+        }
+        return idx;
+    }
 
 protected:
     //! Constructor
@@ -112,11 +205,19 @@ protected:
         }
         if (isPeriodic_.size() == 0) {
             // Default: Non-periodic in all dimensions
-            isPeriodic.resize(dimension_, false);
+            isPeriodic_.resize(dimension_, false);
         } else if (isPeriodic_.size() != dimension_) {
             throw std::invalid_argument("Size of vector isPeriodic does not "
                     "match size of vector containing number of grid points.");
         }
+
+        // Spacings are used by every lookup.
+        spacing_.resize(dimension_);
+        invSpacing_.resize(dimension_);
+        for (size_t i = 0; i < dimension_; ++i) {
+            spacing_[i] = (edges_.second[i] - edges_.first[i]) / numPoints_[i];
+            invSpacing_[i] = 1.0 / spacing_[i];
+        }
     }
 
 public:
@@ -238,6 +339,17 @@ public:
         return GetPeriodic().at(dim);
     }
 
+    //! Get the storage distance between neighbors along a dimension.
+    /*!
+     * \param dim Index of the dimension.
+     * \return Distance in the storage vector between grid points whose
+     *         indices differ by one in this dimension.
+     */
+    size_t GetStride(size_t dim) const
+    {
+        return strides_.at(dim);
+    }
+
     //! Get the size of the internal storage vector
     /*!
      * \return Size of the internal storage vector.
@@ -275,6 +387,245 @@ public:
         return data_.data();
     }
 
+    //! Iterator over the grid points in storage order.
+    /*!
+     * \tparam R Either T or const T for iterator and const iterator.
+     *
+     * The iterator walks the storage vector contiguously, with the first
+     * dimension running fastest. Indices and coordinates of the current grid
+     * point are kept up to date as the iterator moves, so dereferencing and
+     * stepping do not check bounds or allocate. In a histogram, the under-
+     * and overflow bins are visited as well, with indices -1 and
+     * number_points.
+     *
+     * Use this iterator for sweeps over the whole grid. The iterators of
+     * Grid and Histogram can instead be moved to arbitrary indices.
+     */
+    template<typename R>
+    class CellIterator {
+    public:
+        //! Type name of the iterator.
+        typedef CellIterator self_type;
+
+        //! Difference type.
+        typedef std::ptrdiff_t difference_type;
+
+        //! Either T or const T.
+        typedef R value_type;
+
+        //! Either T* or T const*.
+        typedef R* pointer;
+
+        //! Either T& or T const&.
+        typedef R& reference;
+
+        //! CellIterator is a forward iterator.
+        typedef std::forward_iterator_tag iterator_category;
+
+        //! Constructor
+        /*!
+         * \param grid Grid to iterate over.
+         * \param data Storage of the grid.
+         * \param pos Position in the storage vector.
+         *
+         * Past the end, indices and coordinates are not set up.
+         */
+        CellIterator(const GridBase<T> *grid, R *data, size_t pos)
+            : grid_(grid), data_(data), pos_(pos), indices_(), coords_()
+        {
+            if (pos_ >= grid_->size()) {
+                return;
+            }
+
+            indices_.resize(grid_->dimension_);
+            coords_.resize(grid_->dimension_);
+            for (size_t d = grid_->dimension_; d-- > 0;) {
+                indices_[d] = pos / grid_->strides_[d] - grid_->offsets_[d];
+                coords_[d] = grid_->GetCoordinate(d, indices_[d]);
+                pos %= grid_->strides_[d];
+            }
+        }
+
+        //! Dereference operator.
+        reference operator*() const { return data_[pos_]; }
+
+        //! Member access operator.
+        pointer operator->() const { return data_ + pos_; }
+
+        //! Pre-increment operator.
+        /*!
+         * \return Reference to iterator.
+         *
+         * Carries over to the next dimension at the end of a row. On average
+         * only the first index and coordinate change.
+         */
+        self_type &operator++()
+        {
+            ++pos_;
+            for (size_t d = 0; d < indices_.size(); ++d) {
+                if (++indices_[d] < grid_->numPoints_[d] + grid_->offsets_[d]) {
+                    coords_[d] = grid_->GetCoordinate(d, indices_[d]);
+                    break;
+                }
+                indices_[d] = -grid_->offsets_[d];
+                coords_[d] = grid_->GetCoordinate(d, indices_[d]);
+            }
+
+            return *this;
+        }
+
+        //! Post-increment operator.
+        self_type operator++(int)
+        {
+            self_type it(*this);
+            ++(*this);
+            return it;
+        }
+
+        //! Equality operator.
+        bool operator==(const self_type &rhs) const
+        {
+            return pos_ == rhs.pos_ && data_ == rhs.data_;
+        }
+
+        //! Non-equality operator.
+        bool operator!=(const self_type &rhs) const
+        {
+            return !( (*this) == rhs );
+        }
+
+        //! Position of the current grid point in the storage vector.
+        size_t GetFlatIndex() const { return pos_; }
+
+        //! Indices of the current grid point.
+        const std::vector<int> &indices() const { return indices_; }
+
+        //! Index of the current grid point in one dimension.
+        int index(size_t d) const { return indices_[d]; }
+
+        //! Center of the current grid point.
+        const std::vector<double> &coordinates() const { return coords_; }
+
+        //! Center of the current grid point in one dimension.
+        double coordinate(size_t d) const { return coords_[d]; }
+
+        //! Check if the current grid point is an under- or overflow bin.
+        bool isUnderOverflowBin() const
+        {
+            for (size_t d = 0; d < indices_.size(); ++d) {
+                if (indices_[d] < 0 || indices_[d] >= grid_->numPoints_[d]) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        //! Grid to iterate over.
+        const GridBase<T> *grid_;
+
+        //! Storage of the grid.
+        R *data_;
+
+        //! Position in the storage vector.
+        size_t pos_;
+
+        //! Indices of the current grid point.
+        std::vector<int> indices_;
+
+        //! Center of the current grid point.
+        std::vector<double> coords_;
+    };
+
+    //! Iterator over grid points in storage order.
+    typedef CellIterator<T> cell_iterator;
+
+    //! Constant iterator over grid points in storage order.
+    typedef CellIterator<const T> const_cell_iterator;
+
+    //! Return cell iterator at the start of the storage vector.
+    cell_iterator cell_begin()
+    {
+        return cell_iterator(this, data_.data(), 0);
+    }
+
+    //! Return cell iterator past the end of the storage vector.
+    cell_iterator cell_end()
+    {
+        return cell_iterator(this, data_.data(), data_.size());
+    }
+
+    //! Return const cell iterator at the start of the storage vector.
+    const_cell_iterator cell_begin() const
+    {
+        return const_cell_iterator(this, data_.data(), 0);
+    }
+
+    //! Return const cell iterator past the end of the storage vector.
+    const_cell_iterator cell_end() const
+    {
+        return const_cell_iterator(this, data_.data(), data_.size());
+    }
+
+    //! Call a function on every grid point.
+    /*!
+     * \param f Function taking a cell_iterator& at the grid point.
+     * \param pool Threads to split the storage vector across, or null to
+     *             run on the calling thread.
+     *
+     * Each thread walks a contiguous part of the storage vector with its own
+     * iterator. The function is called concurrently and may only modify the
+     * grid point it is given.
+     */
+    template<typename F>
+    void for_each_cell(F &&f, ThreadPool *pool = nullptr)
+    {
+        const size_t n = data_.size();
+        const size_t nchunks = pool ? std::min(pool->GetThreads(), n) : 1;
+
+        auto chunk = [&](size_t c)
+        {
+            const size_t last = n*(c + 1)/nchunks;
+            for (cell_iterator it(this, data_.data(), n*c/nchunks);
+                 it.GetFlatIndex() < last; ++it) {
+                f(it);
+            }
+        };
+
+        if (pool) {
+            pool->ParallelFor(nchunks, chunk);
+        } else {
+            chunk(0);
+        }
+    }
+
+    //! Call a function on every grid point, read-only.
+    /*!
+     * \param f Function taking a const_cell_iterator& at the grid point.
+     * \param pool Threads to split the storage vector across, or null.
+     */
+    template<typename F>
+    void for_each_cell(F &&f, ThreadPool *pool = nullptr) const
+    {
+        const size_t n = data_.size();
+        const size_t nchunks = pool ? std::min(pool->GetThreads(), n) : 1;
+
+        auto chunk = [&](size_t c)
+        {
+            const size_t last = n*(c + 1)/nchunks;
+            for (const_cell_iterator it(this, data_.data(), n*c/nchunks);
+                 it.GetFlatIndex() < last; ++it) {
+                f(it);
+            }
+        };
+
+        if (pool) {
+            pool->ParallelFor(nchunks, chunk);
+        } else {
+            chunk(0);
+        }
+    }
+
     //! Return the Grid indices for a given point.
     /*!
      * \param x Point in space.
@@ -302,23 +653,33 @@ public:
 
         std::vector<int> indices(dimension_);
         for (size_t i = 0; i < dimension_; ++i) {
-            double xpos = x.at(i);
-            if (!GetPeriodic(i)) {
-                if (xpos < GetLower(i)) {
-                    indices.at(i) = -1;
-                    continue;
-                } else if (xpos > GetUpper(i)) {
-                    indices.at(i) = GetNumPoints(i);
-                    continue;
-                }
-            }
+            indices[i] = GetIndex(i, x[i]);
+        }
+
+        return indices;
+    }
 
-            // To make sure, the value is rounded in the correct direction.
-            double spacing = (GetUpper(i) - GetLower(i)) / GetNumPoints(i);
-            indices.at(i) = std::floor( (xpos - GetLower(i)) / spacing);
+    //! Return the Grid index for a point along one dimension.
+    /*!
+     * \param dim Index of the dimension.
+     * \param x Coordinate of the point in this dimension.
+     * \return Grid index, wrapped in periodic dimensions, or the index of
+     *         the under- or overflow bin.
+     *
+     * This is GetIndices() for a single dimension. It does not allocate.
+     */
+    int GetIndex(size_t dim, double x) const
+    {
+        if (!isPeriodic_[dim]) {
+            if (x < edges_.first[dim]) {
+                return -1;
+            } else if (x > edges_.second[dim]) {
+                return numPoints_[dim];
+            }
+            return std::floor((x - edges_.first[dim])*invSpacing_[dim]);
         }
 
-        return wrapIndices(indices);
+        return wrapIndex(dim, std::floor((x - edges_.first[dim])*invSpacing_[dim]));
     }
 
     //! Return the Grid index for a one-dimensional grid.
@@ -348,7 +709,7 @@ public:
      * is associated with an interval of the underlying space. This function
      * returns the center point of this interval.
      */
-    std::vector<double> GetCoordinates(const std::vector<int> &indices)
+    std::vector<double> GetCoordinates(const std::vector<int> &indices) const
     {
         if (indices.size() != dimension_) {
             throw std::invalid_argument(
@@ -359,13 +720,23 @@ public:
         std::vector<double> v(dimension_);
 
         for (size_t i = 0; i < dimension_; ++i) {
-            double spacing = (GetUpper(i) - GetLower(i)) / GetNumPoints(i);
-            v.at(i) = GetLower(i) + (indices[i] + 0.5)*spacing;
+            v[i] = GetCoordinate(i, indices[i]);
         }
 
         return v;
     }
 
+    //! Return the center of a grid point along one dimension.
+    /*!
+     * \param dim Index of the dimension.
+     * \param index Grid index in this dimension.
+     * \return Coordinate of the center of the interval.
+     */
+    double GetCoordinate(size_t dim, int index) const
+    {
+        return edges_.first[dim] + (index + 0.5)*spacing_[dim];
+    }
+
     //! Return center point of 1d-grid
     /*!
      * \param index Index of the 1d grid.
@@ -373,7 +744,7 @@ public:
      *
      * \note This function is only available for 1d grids.
      */
-    double GetCoordinate(int index)
+    double GetCoordinate(int index) const
     {
         return GetCoordinates({index}).at(0);
     }
@@ -399,7 +770,7 @@ public:
                     "dimension of the grid.");
         }
 
-        return data_.at(mapTo1d(indices));
+        return data_[mapTo1d(indices)];
     }
 
     //! Access Grid element read/write
@@ -480,11 +851,16 @@ public:
      * \return Const reference of the value at the given coordinates.
      *
      * This function is provided for convenience. It is identical to
-     * GridBase::at(GridBase::GetIndices(x)).
+     * GridBase::at(GridBase::GetIndices(x)), but does not allocate.
      */
     const T& at(const std::vector<double> &x) const
     {
-        return at(GetIndices(x));
+        if (x.size() != dimension_) {
+            throw std::invalid_argument("Specified point has a larger "
+                    "dimensionality than the grid.");
+        }
+
+        return data_[mapPointTo1d(x)];
     }
 
     //! Access Grid element pertaining to a specific point -- read/write
@@ -493,11 +869,11 @@ public:
      * \return Reference to the value at the given coordinates.
      *
      * This function is provided for convenience. It is identical to
-     * GridBase::at(GridBase::GetIndices(x)).
+     * GridBase::at(GridBase::GetIndices(x)), but does not allocate.
      */
     T& at(const std::vector<double> &x)
     {
-        return at(GetIndices(x));
+        return const_cast<T&>(static_cast<const GridBase<T>* >(this)->at(x));
     }
 
     //! Access 1d-Grid by point - read-only
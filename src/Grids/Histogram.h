@@ -69,44 +69,6 @@ namespace SSAGES
 template<typename T>
 class Histogram : public GridBase<T>
 {
-private:
-    //! Map d-dimensional indices to 1-d data vector
-    /*!
-     * \param indices Vector specifying the grid point.
-     * \return Index of 1d data vector.
-     *
-     * Map a set of indices to the index of the 1d data vector. Keep in mind,
-     * that the data includes underflow (index -1) and overflow (index
-     * numPoints) bins in periodic dimension.
-     */
-    size_t mapTo1d(const std::vector<int> &indices) const override
-    {
-        // Check if an index is out of bounds
-        for (size_t i=0; i < GridBase<T>::GetDimension(); ++i) {
-            int index = indices.at(i);
-            bool periodic = GridBase<T>::GetPeriodic(i);
-            int numpoints = GridBase<T>::GetNumPoints(i);
-            if ( (periodic && (index < 0 || index >= numpoints)) ||
-                 (periodic && (index < -1 || index > numpoints)) )
-            {
-                throw std::out_of_range("Bin index out of range.");
-            }
-        }
-
-        size_t idx = 0;
-        size_t fac = 1;
-        for (size_t i=0; i < GridBase<T>::GetDimension(); ++i) {
-            if (GridBase<T>::GetPeriodic(i)) {
-                idx += indices.at(i) * fac;
-                fac *= GridBase<T>::GetNumPoints(i);
-            } else {
-                idx += (indices.at(i) + 1) * fac;
-                fac *= GridBase<T>::GetNumPoints(i) + 2;
-            }
-        }
-        return idx;
-    }
-
 public:
     //! Constructor
     /*!
@@ -125,14 +87,8 @@ public:
               std::vector<bool> isPeriodic)
       : GridBase<T>(numPoints, lower, upper, isPeriodic)
     {
-        size_t data_size = 1;
-        for (size_t d = 0; d < GridBase<T>::GetDimension(); ++d) {
-            size_t storage_size = GridBase<T>::GetNumPoints(d);
-            if (!GridBase<T>::GetPeriodic(d)) { storage_size += 2; }
-            data_size *= storage_size;
-        }
-
-        GridBase<T>::data_.resize(data_size);
+        // Under- and overflow bins in non-periodic dimensions.
+        GridBase<T>::InitLayout(true);
     }
 
     //! Set up the histogram
@@ -22,20 +22,31 @@
 #include "Hook.h"
 #include "Drivers/Driver.h"
 #include "CVs/CollectiveVariable.h"
+#include "ChainRule.h"
+#include "Utility/CommPlan.h"
+#include "Utility/ExpressionCache.h"
 #include <algorithm>
 
 namespace SSAGES
 {
+	Hook::Hook() : 
+	listeners_(0), MDDriver_(nullptr), derivatives_(0), pool_(), 
+	cache_(new ExpressionCache()), syncids_(), fullsync_(true), 
+	snapshot_(nullptr)
+	{}
+
+	Hook::~Hook()
+	{
+	}
+
 	void Hook::PreSimulationHook()
 	{
 		snapshot_->Changed(false);
 	
 		// Initialize/evaluate CVs.
-		for(auto& cv : cvs_)
-		{
+		for(auto& cv : GetSources())
 			cv->Initialize(*snapshot_);
-			cv->Evaluate(*snapshot_);
-		}
+		EvaluateCVs();
 
 		// Call presimulation method on listeners. 
 		for(auto& listener : listeners_)
@@ -45,19 +56,40 @@ namespace SSAGES
 		if(snapshot_->HasChanged())
 			SyncToEngine();
 
-		snapshot_->Changed(false);		
+		snapshot_->Changed(false);
+
+		// From here on, only synchronize the atoms that matter.
+		UpdateSyncSet();
 	}
 
 	void Hook::PostIntegrationHook()
 	{
 		snapshot_->Changed(false);
 
-		for(auto& cv : cvs_)
-			cv->Evaluate(*snapshot_);
+		// Nothing consumes the CVs at this iteration.
+		auto iteration = snapshot_->GetIteration();
+		if(!IsActive(iteration))
+			return;
+
+		EvaluateCVs(false);
 
+		// Call listeners and collect their bias derivatives.
+		derivatives_.assign(cvs_.size(), 0);
 		for(auto& listener : listeners_)
-			if(snapshot_->GetIteration() % listener->GetFrequency() == 0)
+			if(iteration % listener->GetFrequency() == 0)
+			{
 				listener->PostIntegration(snapshot_, cvs_);
+				ChainRule::Accumulate(listener->GetBiasDerivatives(), derivatives_);
+			}
+
+		// CVs which were not evaluated keep stale values and are not 
+		// biased. The others are scaled for impulse multiple time steps.
+		auto ncv = std::min(cvs_.size(), derivatives_.size());
+		for(size_t i = 0; i < ncv; ++i)
+			derivatives_[i] *= cvs_[i]->IsDue(iteration) ? cvs_[i]->GetBiasScale() : 0.;
+
+		// Apply bias forces of all CVs at once.
+		ChainRule::Apply(cvs_, derivatives_, snapshot_);
 
 		if(snapshot_->HasChanged())
 			SyncToEngine();
@@ -69,8 +101,7 @@ namespace SSAGES
 	{
 		snapshot_->Changed(false);
 
-		for(auto& cv : cvs_)
-			cv->Evaluate(*snapshot_);
+		EvaluateCVs();
 		
 		for(auto& listener : listeners_)
 			listener->PostSimulation(snapshot_, cvs_);
@@ -81,10 +112,151 @@ namespace SSAGES
 		snapshot_->Changed(false);		
 	}
 
+	void Hook::EvaluateCVs(bool all)
+	{
+		auto iteration = snapshot_->GetIteration();
+		auto due = [&](CollectiveVariable* cv)
+		{
+			return all || cv->GetSource()->IsDue(iteration);
+		};
+
+		// CVs without communication stages may call MPI themselves, so 
+		// they are evaluated directly on this thread.
+		int nstages = 0;
+		CVList staged;
+		for(auto& cv : GetSources())
+		{
+			if(!due(cv))
+				continue;
+
+			if(cv->GetCommStages() == 0)
+				cv->Evaluate(*snapshot_);
+			else
+				staged.push_back(cv);
+			nstages = std::max(nstages, cv->GetCommStages());
+		}
+
+		if(nstages == 0)
+		{
+			for(auto& cv : cvs_)
+				if(due(cv))
+					cv->Collect(*snapshot_);
+			return;
+		}
+
+		// Atom lookups must not rebuild the index map concurrently.
+		snapshot_->UpdateIndexMap();
+
+		// Each CV fills its own plan so that stages can run concurrently. 
+		// Stage s of every CV still contributes to the same round, so 
+		// there is a single collective per stage for all CVs combined.
+		std::vector<CommPlan> plans(staged.size() + 1, CommPlan(snapshot_->GetCommunicator()));
+		std::vector<CommPlan*> pplans;
+		for(auto& plan : plans)
+			pplans.push_back(&plan);
+
+		// The last plan carries the shared centers of mass. Anything left 
+		// over from an interrupted evaluation is discarded.
+		auto& cacheplan = plans.back();
+		auto* cache = snapshot_->GetCache();
+		if(cache && cache->IsPending())
+			cache->Invalidate();
+
+		for(int s = 0; s <= nstages; ++s)
+		{
+			std::function<void(size_t)> stage = [&](size_t i)
+			{
+				if(s <= staged[i]->GetCommStages())
+					staged[i]->EvaluateStage(*snapshot_, s, plans[i]);
+			};
+
+			if(pool_)
+				pool_->ParallelFor(staged.size(), stage);
+			else
+				for(size_t i = 0; i < staged.size(); ++i)
+					stage(i);
+
+			if(s == nstages)
+				break;
+
+			if(cache)
+				cache->Prepare(*snapshot_, cacheplan);
+			CommPlan::ExecuteAll(pplans);
+			if(cache)
+				cache->Complete(cacheplan);
+		}
+
+		for(auto& cv : cvs_)
+			if(due(cv))
+				cv->Collect(*snapshot_);
+	}
+
+	CVList Hook::GetSources() const
+	{
+		CVList sources;
+		for(auto& cv : cvs_)
+		{
+			auto* source = cv->GetSource();
+			if(std::find(sources.begin(), sources.end(), source) == sources.end())
+				sources.push_back(source);
+		}
+		return sources;
+	}
+
+	void Hook::UpdateSyncSet()
+	{
+		fullsync_ = false;
+		syncids_.clear();
+
+		for(auto& listener : listeners_)
+			fullsync_ = fullsync_ || listener->RequiresFullSync();
+
+		for(auto& cv : cvs_)
+			fullsync_ = fullsync_ || !cv->GetAtomSet(syncids_);
+
+		std::sort(syncids_.begin(), syncids_.end());
+		syncids_.erase(std::unique(syncids_.begin(), syncids_.end()), syncids_.end());
+		
+		if(fullsync_)
+			syncids_.clear();
+	}
+
+	unsigned Hook::GetThermoNeeds(int iteration) const
+	{
+		unsigned needs = EventListener::NoThermo;
+		for(auto& listener : listeners_)
+			if(iteration % listener->GetFrequency() == 0)
+				needs |= listener->GetThermoNeeds(iteration);
+		
+		return needs;
+	}
+
+	bool Hook::IsActive(int iteration) const
+	{
+		for(auto& listener : listeners_)
+			if(iteration % listener->GetFrequency() == 0)
+				return true;
+
+		return false;
+	}
+
+	void Hook::SetThreads(unsigned int nthreads)
+	{
+		if(nthreads > 1)
+			pool_.reset(new ThreadPool(nthreads));
+		else
+			pool_.reset();
+
+		for(auto& listener : listeners_)
+			listener->SetThreadPool(pool_.get());
+	}
+
 	//! Sets the active snapshot.
 	void Hook::SetSnapshot(Snapshot* snapshot)
 	{
 		snapshot_ = snapshot;
+		if(snapshot_)
+			snapshot_->SetCache(cache_.get());
 	}
 
 	//! Sets the active Driver
@@ -102,7 +274,10 @@ namespace SSAGES
 	void Hook::AddListener(EventListener* listener)
 	{
 		if(std::find(listeners_.begin(), listeners_.end(), listener) == listeners_.end())
+		{
 			listeners_.push_back(listener);
+			listener->SetThreadPool(pool_.get());
+		}
 	}
 
 	//! Add a CollectiveVariable to the hook.
@@ -21,13 +21,16 @@
 #pragma once
 
 #include "EventListener.h"
+#include "Utility/ThreadPool.h"
 #include <algorithm>
+#include <memory>
 
 namespace SSAGES
 {
 	// Forward declare.
 	class Driver; 
 	class CollectiveVariable;
+	class ExpressionCache;
 	class Snapshot;
 
 	//! Base class for hooks into the simultion engines
@@ -49,6 +52,51 @@ namespace SSAGES
 		//! Driver running this hook
 		Driver* MDDriver_;
 
+		//! Total bias derivatives dV/dCV of all listeners.
+		std::vector<double> derivatives_;
+
+		//! Threads for CV evaluation.
+		std::unique_ptr<ThreadPool> pool_;
+
+		//! Intermediates shared between CVs, attached to the snapshot.
+		std::unique_ptr<ExpressionCache> cache_;
+
+		//! Evaluate all CVs.
+		/*!
+		 * Staged CVs are evaluated together so that their communication 
+		 * is fused into one collective per stage. Their stages run 
+		 * concurrently on the thread pool, while collectives and CVs 
+		 * which communicate on their own stay on the calling thread.
+		 * Centers of mass requested from the expression cache are 
+		 * computed in the same collectives.
+		 *
+		 * \param all If \c FALSE, only CVs due at the current iteration 
+		 *        are evaluated, see CollectiveVariable::SetStride().
+		 */
+		void EvaluateCVs(bool all = true);
+
+		//! Get the CVs which perform evaluations, without duplicates.
+		/*!
+		 * \return Sources of all CVs, in order of first appearance.
+		 *
+		 * Components of a multi-output CV share a single source.
+		 */
+		CVList GetSources() const;
+
+		//! IDs of the atoms required by CVs and listeners, sorted.
+		Label syncids_;
+
+		//! \c TRUE if all atoms must be synchronized.
+		bool fullsync_;
+
+		//! Determine which atoms need synchronization.
+		/*!
+		 * Called once CVs and listeners are initialized. Only the atoms 
+		 * of the CVs are needed, unless a CV does not know its atom set 
+		 * or a listener requires all atoms.
+		 */
+		void UpdateSyncSet();
+
 	protected:
 		//! Local snapshot.
 		Snapshot* snapshot_;
@@ -67,15 +115,58 @@ namespace SSAGES
 		 */
 		virtual void SyncToSnapshot() = 0;
 
+		//! Check whether all atoms need to be synchronized.
+		/*!
+		 * \return \c TRUE if all atoms are synchronized. Otherwise hooks 
+		 *         may restrict synchronization to GetSyncIDs().
+		 *
+		 * Synchronization is always full until the pre-simulation hook 
+		 * has completed, since CVs locate their atoms during initialization.
+		 */
+		bool IsFullSync() const { return fullsync_; }
+
+		//! Get the IDs of the atoms which need to be synchronized.
+		/*!
+		 * \return Sorted list of atom IDs. Only meaningful if 
+		 *         IsFullSync() returns \c FALSE.
+		 */
+		const Label& GetSyncIDs() const { return syncids_; }
+
+		//! Get the thermodynamic quantities needed at an iteration.
+		/*!
+		 * \param iteration Iteration of the post-integration hook.
+		 * \return Combination of EventListener::Thermo flags of all 
+		 *         listeners called at that iteration.
+		 *
+		 * The pre- and post-simulation hooks call every listener, so hooks 
+		 * should provide all quantities there.
+		 */
+		unsigned GetThermoNeeds(int iteration) const;
+
+		//! Check whether anything happens at an iteration.
+		/*!
+		 * \param iteration Iteration of the post-integration hook.
+		 * \return \c TRUE if a listener is called at that iteration.
+		 *
+		 * CVs are only evaluated for listeners, so on other iterations the 
+		 * post-integration hook does nothing and hooks may skip 
+		 * synchronization.
+		 */
+		bool IsActive(int iteration) const;
+
 	public:
 		//! Constructor
 		/*!
 		 * Initialize a hook with world and walker communicators and
 		 * corresponding walker ID.
 		 */
-		Hook() : 
-		listeners_(0), MDDriver_(nullptr), snapshot_(nullptr)
-		{}
+		Hook();
+
+		//! Set the number of threads used to evaluate CVs.
+		/*!
+		 * \param nthreads Number of threads including the calling thread.
+		 */
+		void SetThreads(unsigned int nthreads);
 
 		//! Sets the active snapshot.
 		void SetSnapshot(Snapshot* snapshot);
@@ -135,6 +226,6 @@ namespace SSAGES
 		void PostSimulationHook();
 
 		//! Destructor
-		virtual ~Hook(){}
+		virtual ~Hook();
 	};
 }
\ No newline at end of file
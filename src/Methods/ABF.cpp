@@ -51,43 +51,24 @@ namespace SSAGES
 		// First of these vectors hold the lower bound for the CVs in order.
 		// Second vector holds the upper bound for the CVs in order.
 		// Third vector holds number of histogram bins for the CVs in order.
-	
-		// The first mapping starts here.
-		for(size_t i = 0; i < histdetails_.size(); ++i)
-		{
-			// Check if CV is in bounds for each CV.
-			if ((cvs[i]->GetValue()<histdetails_[i][0]) || (cvs[i]->GetValue()>histdetails_[i][1]))
-				return -1;
-		}
-
-		// This vector holds the CV coordinates in the fictitious object.
-		std::vector<int> coords(cvs.size());
-		
-		// Loop over each CV dimension.
-		for(size_t i = 0; i < histdetails_.size(); ++i)
-		{
-			// Loop over all bins in each CV dimensions
-			for(int j = 0; j < histdetails_[i][2] ; ++j)
-			{
-				if((histdetails_[i][0] + j*((histdetails_[i][1]-histdetails_[i][0])/histdetails_[i][2]) < cvs[i]->GetValue()) && 
-				   (histdetails_[i][0] + (j+1)*((histdetails_[i][1]-histdetails_[i][0])/histdetails_[i][2]) > cvs[i]->GetValue()))
-				{
-					coords[i] = j;
-				}
-			}
-		} //First mapping ends here. 
 
-		// Second mapping starts here.
+		// Both mappings are done in one pass. The bin in each dimension 
+		// follows directly from the bin width, and the one dimensional 
+		// index is built up with the last CV running fastest.
 		int finalcoord = 0;
-		int indexer = 1;
-		// Loop over each CV dimension.
 		for(size_t i = 0; i < histdetails_.size(); ++i)
 		{
-			indexer = 1;
-			for(size_t j = i+1; j < histdetails_.size(); ++j)
-				indexer = indexer*histdetails_[j][2];
+			auto lower = histdetails_[i][0];
+			auto upper = histdetails_[i][1];
+			int nbins = histdetails_[i][2];
+			auto val = cvs[i]->GetValue();
 
-			finalcoord += coords[i]*indexer;
+			// Check if CV is in bounds.
+			if(val < lower || val > upper)
+				return -1;
+
+			int bin = std::min(nbins - 1, static_cast<int>((val - lower)/(upper - lower)*nbins));
+			finalcoord = finalcoord*nbins + bin;
 		}
 
 		return finalcoord;			
@@ -122,8 +103,8 @@ namespace SSAGES
 		if(_F.size() == 0) _F.setZero(nel*ncv_);
 		if(_N.size() == 0) _N.resize(nel, 0);
 
-		// Initialize biases.
-		biases_.resize(snapshot->GetPositions().size(), Vector3{0, 0, 0});
+		// Initialize bias derivatives.
+		derivatives_.assign(ncv_, 0);
 		
 		// Initialize w \dot p's for finite difference. 
 		wdotp1_.setZero(ncv_);
@@ -144,47 +125,55 @@ namespace SSAGES
 	{
 		++iteration_;
 
-		// Gather information.
-		auto& vels = snapshot->GetVelocities();
-		auto& mass = snapshot->GetMasses();
-		auto& forces = snapshot->GetForces();
+		// Gather information. Read-only, so nothing is flagged as modified.
+		const auto* csnapshot = snapshot;
+		auto& vels = csnapshot->GetVelocities();
+		auto& mass = csnapshot->GetMasses();
 		auto n = snapshot->GetNumAtoms();
 
 		//! Coord holds where we are in CV space in current timestep.
 		int coord = histCoords(cvs);
 
-		//! Eigen::MatrixXd to hold the CV gradient.
-		Eigen::MatrixXd J(ncv_, 3*n);
+		//* Calculate W using Darve's approach (http://mc.stanford.edu/cgi-bin/images/0/06/Darve_2008.pdf).
+		// With J the CV Jacobian and M the (optionally unit) mass matrix, 
+		// W^T = (J M^-1 J^T)^-1 J M^-1. Only the atoms in each CV's sparse 
+		// gradient contribute, so J is never formed explicitly.
+		Eigen::MatrixXd Minv = Eigen::MatrixXd::Zero(ncv_, ncv_);
+		Eigen::VectorXd Jp = Eigen::VectorXd::Zero(ncv_);
+		if(gradbuf_.size() < n)
+			gradbuf_.resize(n, Vector3{0,0,0});
 
-		// Fill J. Each column represents grad(CV) with flattened Cartesian elements. 
 		for(int i = 0; i < ncv_; ++i)
 		{
-			auto& grad = cvs[i]->GetGradient();
-			for(size_t j = 0; j < n; ++j)
-				J.block<1, 3>(i,3*j) = grad[j];
-		}
-		
-		//* Calculate W using Darve's approach (http://mc.stanford.edu/cgi-bin/images/0/06/Darve_2008.pdf).
-		Eigen::MatrixXd Jmass = J.transpose();
-		
-		if(massweigh_)
-		{
-			for(size_t i = 0; i < forces.size(); ++i)
-				Jmass.block(3*i, 0, 3, ncv_) = Jmass.block(3*i, 0, 3, ncv_)/mass[i];
-		}
-							
-		Eigen::MatrixXd Minv = J*Jmass;
-		MPI_Allreduce(MPI_IN_PLACE, Minv.data(), Minv.size(), MPI_DOUBLE, MPI_SUM, comm_);
+			// Scatter M^-1 grad(CV_i) into the scratch buffer.
+			auto& gradi = cvs[i]->GetSparseGradient();
+			for(size_t k = 0; k < gradi.size(); ++k)
+			{
+				auto idx = gradi.indices[k];
+				gradbuf_[idx] += (massweigh_ ? 1./mass[idx] : 1.)*gradi.values[k];
+			}
 
-		Eigen::MatrixXd Wt = Minv.inverse()*Jmass.transpose();	
+			for(int j = i; j < ncv_; ++j)
+			{
+				auto& gradj = cvs[j]->GetSparseGradient();
+				for(size_t k = 0; k < gradj.size(); ++k)
+					Minv(i,j) += gradj.values[k].dot(gradbuf_[gradj.indices[k]]);
+				Minv(j,i) = Minv(i,j);
+			}
 
-		// Fill momenta.
-		Eigen::VectorXd momenta(3*vels.size());
-		for(size_t i = 0; i < vels.size(); ++i)
-			momenta.segment<3>(3*i) = mass[i]*vels[i];
+			// Momenta contribution J M^-1 p.
+			for(size_t k = 0; k < gradi.size(); ++k)
+			{
+				auto idx = gradi.indices[k];
+				Jp[i] += gradbuf_[idx].dot(mass[idx]*vels[idx]);
+				gradbuf_[idx].setZero();
+			}
+		}
+
+		MPI_Allreduce(MPI_IN_PLACE, Minv.data(), Minv.size(), MPI_DOUBLE, MPI_SUM, comm_);
 
 		// Compute dot(w,p).
-		Eigen::VectorXd wdotp = Wt*momenta;
+		Eigen::VectorXd wdotp = Minv.inverse()*Jp;
 
 		// Reduce dot product across processors.
 		MPI_Allreduce(MPI_IN_PLACE, wdotp.data(), wdotp.size(), MPI_DOUBLE, MPI_SUM, comm_);
@@ -216,13 +205,9 @@ namespace SSAGES
 		if(iteration_ % FBackupInterv_ == 0)
 			WriteData();
 		
-		// Calculate the bias from averaged F at current CV coordinates
-		CalcBiasForce(snapshot, cvs, coord);		
-		
-		// Update the forces in snapshot by adding in the force bias from each
-		// CV to each atom based on the gradient of the CV.
-		for (size_t j = 0; j < forces.size(); ++j)
-			forces[j] += biases_[j];	
+		// Calculate the bias from averaged F at current CV coordinates.
+		// The hook applies it to the atoms using the chain rule.
+		CalcBiasForce(cvs, coord);		
 	}
 
 	// Post-simulation hook.
@@ -233,22 +218,16 @@ namespace SSAGES
 		walkerout_.close();
 	}
 
-	void ABF::CalcBiasForce(const Snapshot* snapshot, const CVList& cvs, int coord)
+	void ABF::CalcBiasForce(const CVList& cvs, int coord)
 	{
 		// Reset the bias.
-		biases_.resize(snapshot->GetNumAtoms(), Vector3{0,0,0});
-		for(auto& b : biases_)
-			b.setZero();
+		derivatives_.assign(ncv_, 0);
 		
 		// Compute bias if within bounds
 		if(coord != -1)
 		{
 			for(int i = 0; i < ncv_; ++i)
-			{
-				auto& grad = cvs[i]->GetGradient();
-				for(size_t j = 0; j < biases_.size(); ++j)
-					biases_[j] -= Fworld_[ncv_*coord+i]*grad[j]/std::max(min_, Nworld_[coord]);
-			}
+				derivatives_[i] = Fworld_[ncv_*coord+i]/std::max(min_, Nworld_[coord]);
 		}
 		else
 		{
@@ -279,9 +258,7 @@ namespace SSAGES
 					x0 = restraint_[i][1];
 				}
 
-				auto& grad = cvs[i]->GetGradient();
-				for(size_t j = 0; j < biases_.size(); ++j)
-					biases_[j] -= (cvVal - x0)*k*grad[j];
+				derivatives_[i] = (cvVal - x0)*k;
 			}	
 		}
 	}
@@ -120,8 +120,8 @@ namespace SSAGES
 		//! Mass weighing of bias enabled/disabled
 		bool massweigh_;
 
-		//! Biases.	
-		std::vector<Vector3> biases_;
+		//! Scratch per-atom buffer for products of sparse CV gradients.
+		std::vector<Vector3> gradbuf_;
 
 		//! Number of CVs in system
 		unsigned int dim_;
@@ -165,7 +165,7 @@ namespace SSAGES
 		double unitconv_;
 
 		//! Computes the bias force.
-		void CalcBiasForce(const Snapshot* snapshot, const CVList& cvs, int coord);
+		void CalcBiasForce(const CVList& cvs, int coord);
 		
 		//! Writes out data to file.
 		void WriteData();
@@ -215,7 +215,7 @@ namespace SSAGES
 		Method(frequency, world, comm), _F(), Fworld_(), _N(0), Nworld_(0),
 		restraint_(restraint), isperiodic_(isperiodic), periodicboundaries_(periodicboundaries),
 		 min_(min), wdotp1_(), wdotp2_(), Fold_(), massweigh_(massweigh),
-		biases_(), dim_(0), filename_(filename), mpiid_(0), histdetails_(histdetails), 
+		gradbuf_(), dim_(0), filename_(filename), mpiid_(0), histdetails_(histdetails), 
 		FBackupInterv_(FBackupInterv), unitconv_(unitconv), timestep_(timestep)
 		{
 		}
@@ -241,6 +241,12 @@ namespace SSAGES
 		 */
 		void PostSimulation(Snapshot* snapshot, const CVList& cvs) override;
 
+		//! Only acts on the atoms of the CVs.
+		bool RequiresFullSync() const override { return false; }
+
+		//! Needs no thermodynamic quantities.
+		unsigned GetThermoNeeds(int) const override { return NoThermo; }
+
 		//! Set biasing histogram
 		/*!
 		 * \param F Vector containing values for the running total.
@@ -19,6 +19,7 @@
  * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "BasisFunc.h"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
@@ -85,9 +86,7 @@ namespace SSAGES
 		Map temp_map(idx,0.0);
         
         // Initialize the mapping for the hist function
-        for (int &val : *hist_) {
-            val = 0;
-        }
+        std::fill(hist_->data(), hist_->data() + hist_->size(), 0);
 
         //Initialize the mapping for the coeff function
         for(size_t i = 0; i < coeff_size; ++i)
@@ -159,24 +158,8 @@ namespace SSAGES
         }
 
 		// This calculates the bias force based on the existing basis projection.
+		// The hook applies it to the atoms using the chain rule.
 		CalcBiasForce(cvs);
-
-		// Take each CV and add its biased forces to the atoms using the chain rule
-		auto& forces = snapshot->GetForces();
-        auto& virial = snapshot->GetVirial();
-		for(size_t i = 0; i < cvs.size(); ++i)
-		{
-			auto& grad = cvs[i]->GetGradient();
-            auto& boxgrad = cvs[i]->GetBoxGradient();
-
-			/* Update the forces in snapshot by adding in the force bias from each
-			 *CV to each atom based on the gradient of the CV.
-             */
-			for (size_t j = 0; j < forces.size(); ++j) 
-				forces[j] += derivatives_[i]*grad[j];
-            
-            virial -= derivatives_[i]*boxgrad;
-		}
 	}
 
 	// Post-simulation hook.
@@ -236,11 +219,8 @@ namespace SSAGES
 	// Update the coefficients/bias projection
 	void Basis::UpdateBias(const CVList& cvs, const double beta)
 	{
-        std::vector<double> x(cvs.size(), 0);
         std::vector<double> coeffTemp(coeff_.size(), 0);
         double sum  = 0.0;
-        double bias = 0.0;
-        double basis = 1.0;
 
         // For multiple walkers, the struct is unpacked
         Histogram<int> histlocal(*hist_);
@@ -249,38 +229,34 @@ namespace SSAGES
         MPI_Allreduce(histlocal.data(), hist_->data(), hist_->size(), MPI_INT, MPI_SUM, world_);
 
         // Construct the biased histogram
-        size_t i = 0;
-        for (Histogram<int>::iterator it2 = hist_->begin(); it2 != hist_->end(); ++it2, ++i)
+        hist_->for_each_cell([&](Histogram<int>::cell_iterator& it)
         {
-            if (it2.isUnderOverflowBin()) {
-                --i;
-                continue;
-            }
+            if (it.isUnderOverflowBin())
+                return;
 
             // This is to make sure that the CV projects across the entire surface
-            if (*it2 == 0) { *it2 = 1; }
-           
+            if (*it == 0) { *it = 1; }
+
             // The loop builds the previous basis projection for each bin of the histogram
+            double bias = 0.0;
             for(size_t k = 1; k < coeff_.size(); ++k)
             {
                 auto& coeff = coeff_[k];
+                double basis = 1.0;
                 for(size_t l = 0; l < cvs.size(); ++l)
                 { 
                     // The previous bias is only calculated after each sweep has happened
                     int nbins = hist_->GetNumPoints(l);
-                    basis *= LUT_[l].values[it2.index(l) + coeff.map[l]*nbins];
+                    basis *= LUT_[l].values[it.index(l) + coeff.map[l]*nbins];
                 }
                 bias += coeff.value*basis;
-                basis = 1.0;
             }
             
             /* The evaluation of the biased histogram which projects the histogram to the
              * current bias of CV space.
              */
-            unbias_[i] += (*it2) * exp(bias) * weight_ / (double)(cyclefreq_);
-            bias = 0.0;
-
-        }
+            unbias_[InteriorIndex(it)] += (*it) * exp(bias) * weight_ / (double)(cyclefreq_);
+        }, pool_);
 
         // The coefficients and histograms are reset after evaluating the biased histogram values
         for(size_t i = 0; i < coeff_.size(); ++i)
@@ -290,48 +266,65 @@ namespace SSAGES
         }
 
         // Reset histogram
-        for (int &val : *hist_) {
-            val = 0;
-        }
+        std::fill(hist_->data(), hist_->data() + hist_->size(), 0);
+
+        // The log of the biased histogram with trap rule weights, which lower 
+        // the error significantly at the boundaries. It is shared by all 
+        // coefficients.
+        std::vector<double> logw(unbias_.size(), 0);
+        const Histogram<int>* hist = hist_;
+        hist->for_each_cell([&](Histogram<int>::const_cell_iterator& it)
+        {
+            if (it.isUnderOverflowBin())
+                return;
 
-        // The loop that evaluates the new coefficients by integrating the CV space
-        for(size_t i = 1; i < coeff_.size(); ++i)
+            double weight = 1.0;
+            for(size_t k = 0; k < cvs.size(); ++k)
+            {
+                if( it.index(k) == 0 ||
+                    it.index(k) == hist_->GetNumPoints(k)-1)
+                    weight /= 2.0;
+            }
+
+            auto j = InteriorIndex(it);
+            logw[j] = log(unbias_[j]) * weight;
+        }, pool_);
+
+        // The loop that evaluates the new coefficients by integrating the CV space.
+        // Coefficients are independent of each other.
+        auto project = [&](size_t i)
         {
             auto& coeff = coeff_[i];
             
-            // The method uses a standard integration with trap rule weights
-            size_t j = 0;
-            for(Histogram<int>::iterator it2 = hist_->begin(); it2 != hist_->end(); ++it2, ++j)
+            /*The numerical integration of the biased histogram across the entirety of CV space
+             *All calculations include the normalization as well
+             */
+            for(auto it = hist->cell_begin(); it != hist->cell_end(); ++it)
             {
-                if (it2.isUnderOverflowBin()) {
-                    --j;
+                if (it.isUnderOverflowBin())
                     continue;
-                }
-
-                double weight = std::pow(2.0,cvs.size());
 
-                // This adds in a trap-rule type weighting which lowers error significantly at the boundaries
-                for(size_t k = 0; k < cvs.size(); ++k)
-                {
-                    if( it2.index(k) == 0 ||
-                        it2.index(k) == hist_->GetNumPoints(k)-1)
-                        weight /= 2.0;
-                }
-            
-                /*The numerical integration of the biased histogram across the entirety of CV space
-                 *All calculations include the normalization as well
-                 */
+                double basis = 1.0;
                 for(size_t l = 0; l < cvs.size(); l++)
                 {
                     int nbins = hist_->GetNumPoints(l);
-                    basis *= LUT_[l].values[it2.index(l) + coeff.map[l]*nbins] / nbins;
+                    basis *= LUT_[l].values[it.index(l) + coeff.map[l]*nbins] / nbins;
                     basis *= 2.0 * coeff.map[l] + 1.0;
                 }
-                coeff.value += basis * log(unbias_[j]) * weight/std::pow(2.0,cvs.size());
-                basis = 1.0;
+                coeff.value += basis * logw[InteriorIndex(it)];
             }
-            coeffTemp[i] -= coeff.value;
-            coeff_arr_[i] = coeff.value;
+        };
+
+        if(pool_)
+            pool_->ParallelFor(coeff_.size() - 1, [&](size_t i){ project(i + 1); });
+        else
+            for(size_t i = 1; i < coeff_.size(); ++i)
+                project(i);
+
+        for(size_t i = 1; i < coeff_.size(); ++i)
+        {
+            coeffTemp[i] -= coeff_[i].value;
+            coeff_arr_[i] = coeff_[i].value;
             sum += coeffTemp[i]*coeffTemp[i];
         }
 
@@ -358,31 +351,28 @@ namespace SSAGES
     void Basis::PrintBias(const CVList& cvs, const double beta)
     {
         std::vector<double> bias(hist_->size(), 0);
-        std::vector<double> x(cvs.size(), 0);
-        double temp = 1.0; 
 
         /* Since the coefficients are the only piece that needs to be
          *updated, the bias is only evaluated when printing
          */
-        size_t i = 0;
-        for(Histogram<int>::iterator it = hist_->begin(); it != hist_->end(); ++it, ++i)
+        const Histogram<int>* hist = hist_;
+        hist->for_each_cell([&](Histogram<int>::const_cell_iterator& it)
         {
-            if (it.isUnderOverflowBin()) {
-                --i;
-                continue;
-            }
+            if (it.isUnderOverflowBin())
+                return;
 
+            auto i = InteriorIndex(it);
             for(size_t j = 1; j < coeff_.size(); ++j)
             {
+                double temp = 1.0;
                 for(size_t k = 0; k < cvs.size(); ++k)
                 {
                     int nbins = hist_->GetNumPoints(k);
                     temp *=  LUT_[k].values[it.index(k) + coeff_[j].map[k] * nbins];
                 }
                 bias[i] += coeff_[j].value*temp;
-                temp  = 1.0;
             }
-        }
+        }, pool_);
 
         // The filenames will have a standard name, with a user-defined suffix
         std::string filename1 = "basis"+bnme_+".out";
@@ -397,19 +387,17 @@ namespace SSAGES
         coeffout_ << iteration_  <<std::endl;
         basisout_ << "CV Values" << std::setw(35*cvs.size()) << "Basis Set Bias" << std::setw(35) << "PMF Estimate" << std::setw(35) << "Biased Histogram" << std::endl;
         
-        size_t j = 0;
-        for(Histogram<int>::iterator it = hist_->begin(); it != hist_->end(); ++it, ++j)
+        for(auto it = hist->cell_begin(); it != hist->cell_end(); ++it)
         {
-            if (it.isUnderOverflowBin()) {
-                --j;
+            if (it.isUnderOverflowBin())
                 continue;
-            }
 
             for(size_t k = 0; k < cvs.size(); ++k)
             {
                 // Evaluate the CV values for printing purposes
                 basisout_ << it.coordinate(k) << std::setw(35);
             }
+            auto j = InteriorIndex(it);
             basisout_ << -bias[j] << std::setw(35);
             if(unbias_[j])
                 basisout_ << -log(unbias_[j]) / beta << std::setw(35);
@@ -429,7 +417,7 @@ namespace SSAGES
         coeffout_.close();
 	}
 
-    // The forces are calculated by chain rule, first  the derivatives of the basis set, then in the PostIntegration function, the derivative of the CV is evaluated
+    // The forces are calculated by chain rule. Here the derivatives of the bias with respect to each CV are evaluated from the basis set, the hook then multiplies them with the CV gradients
 	void Basis::CalcBiasForce(const CVList& cvs)
 	{	
 		// Reset derivatives
@@ -477,6 +465,8 @@ namespace SSAGES
         // Only apply soft wall potential in the event that it has left the boundaries
         if(bounds_)
         {
+            // The bin of the current point is the same for all coefficients.
+            const auto idx = hist_->GetIndices(x);
             for (size_t i = 1; i < coeff_.size(); ++i)
             {
                 for (size_t j = 0; j < cvs.size(); ++j)
@@ -485,10 +475,10 @@ namespace SSAGES
                     for (size_t k = 0; k < cvs.size(); ++k)
                     {
                         int nbins = hist_->GetNumPoints(k);
-                        temp *= j == k ?  LUT_[k].derivs[hist_->GetIndices(x)[k] + coeff_[i].map[k]*nbins] * 2.0 / (hist_->GetUpper(j) - hist_->GetLower(j))
-                                       :  LUT_[k].values[hist_->GetIndices(x)[k] + coeff_[i].map[k]*nbins];
+                        temp *= j == k ?  LUT_[k].derivs[idx[k] + coeff_[i].map[k]*nbins] * 2.0 / (hist_->GetUpper(j) - hist_->GetLower(j))
+                                       :  LUT_[k].values[idx[k] + coeff_[i].map[k]*nbins];
                     }
-                    derivatives_[j] -= coeff_[i].value * temp;
+                    derivatives_[j] += coeff_[i].value * temp;
                 }
             }
         }
@@ -503,9 +493,9 @@ namespace SSAGES
             if(!hist_->GetPeriodic(j))
             {
                 if(x[j] > boundUp_[j])
-                    derivatives_[j] -= restraint_[j] * (x[j] - boundUp_[j]);
+                    derivatives_[j] += restraint_[j] * (x[j] - boundUp_[j]);
                 else if(x[j] < boundLow_[j])
-                    derivatives_[j] -= restraint_[j] * (x[j] - boundLow_[j]);
+                    derivatives_[j] += restraint_[j] * (x[j] - boundLow_[j]);
             }
         }
     }
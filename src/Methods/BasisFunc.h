@@ -119,13 +119,6 @@ namespace SSAGES
         //! The Basis set lookup table, also defined globally
 		std::vector<BasisLUT> LUT_;
 
-        //! Derivatives of the bias potential
-        /*!
-         * The derivatives of the bias potential imposed on the system.
-         * They are evaluated by using the lookup table.
-         */
-		std::vector<double> derivatives_;
-
         //! The order of the basis polynomials
         std::vector<unsigned int> polyords_;
 
@@ -200,6 +193,20 @@ namespace SSAGES
          */
         void BasisInit(const CVList& cvs);
 
+        //! Index of a histogram bin among the bins within the bounds.
+        /*!
+         * \param it Cell iterator at a bin within the bounds.
+         * \return Index into unbias_, with the first CV running fastest.
+         */
+        template<typename I>
+        size_t InteriorIndex(const I& it) const
+        {
+            size_t idx = 0;
+            for(size_t k = hist_->GetDimension(); k-- > 0;)
+                idx = idx*hist_->GetNumPoints(k) + it.index(k);
+            return idx;
+        }
+
 		//! Output stream for basis projection data.
 		std::ofstream basisout_;
 
@@ -252,7 +259,7 @@ namespace SSAGES
              const double weight,
              bool converge) :
 		Method(frequency, world, comm), hist_(hist),
-        coeff_(), unbias_(), coeff_arr_(), LUT_(), derivatives_(), polyords_(polyord),
+        coeff_(), unbias_(), coeff_arr_(), LUT_(), polyords_(polyord),
         restraint_(restraint), boundUp_(boundUp), boundLow_(boundLow),
         cyclefreq_(cyclefreq), mpiid_(0), weight_(weight),
         temperature_(temperature), tol_(tol),
@@ -281,6 +288,15 @@ namespace SSAGES
          */
 		void PostSimulation(Snapshot* snapshot, const CVList& cvs) override;
 
+		//! Only acts on the atoms of the CVs.
+		bool RequiresFullSync() const override { return false; }
+
+		//! Temperature is needed whenever the basis projection is updated.
+		unsigned GetThermoNeeds(int iteration) const override
+		{
+			return iteration % cyclefreq_ == 0 ? Temperature : NoThermo;
+		}
+
         //! Set the current iteration
         /*!
          * \param iter New value for the current iteration.
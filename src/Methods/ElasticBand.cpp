@@ -26,26 +26,18 @@
 namespace SSAGES
 {
 	// Post-integration hook.
-	void ElasticBand::PostIntegration(Snapshot* snapshot, const CVList& cvs)
+	void ElasticBand::PostIntegration(Snapshot*, const CVList& cvs)
 	{
-
-		auto& forces = snapshot->GetForces();
-
 		// Apply umbrella to cvs
+		derivatives_.resize(cvs.size());
 		for(size_t i = 0; i < cvs.size(); ++i)
 		{
-			// Get current CV and gradient.
+			// Get current CV.
 			auto& cv = cvs[i];
-			auto& grad = cv->GetGradient();
 
 			// Compute dV/dCV.
 			auto diff = cv->GetDifference(centers_[i]);
-			auto D = cvspring_[i] * diff;
-
-			// Update forces.
-			for(size_t j = 0; j < forces.size(); ++j)
-				for(int k = 0; k < forces[j].size(); ++k)
-					forces[j][k] -= D*grad[j][k];
+			derivatives_[i] = cvspring_[i] * diff;
 
 			// If not equilibrating and has evolved enough steps,
 			// generate the gradient
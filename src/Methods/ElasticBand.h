@@ -101,6 +101,9 @@ namespace SSAGES
 		 */
 		void PostIntegration(Snapshot* snapshot, const CVList& cvs) override;
 
+		//! Only acts on the atoms of the CVs.
+		bool RequiresFullSync() const override { return false; }
+
 		//! Serialize the Method
 		/*!
 		 * \warning Serialization not implemented yet!
@@ -49,6 +49,9 @@ namespace SSAGES
 		auto& forces = snapshot->GetForces();
         bool insidecell;
 
+        // No bias unless running the umbrella below.
+        derivatives_.assign(cvs.size(), 0);
+
         if(reset_for_umbrella)
         {
             //If the system was not going to run the umbrella anymore, reset its position
@@ -58,7 +61,6 @@ namespace SSAGES
             }
         	
         	auto& Pos = snapshot->GetPositions();
-        	auto& IDs = snapshot->GetAtomIDs();
 
         	for(size_t i = 0; i < prev_IDs_[0].size(); i++)
         	{
@@ -101,16 +103,8 @@ namespace SSAGES
                 {
                     for(size_t i = 0; i < cvs.size(); i++)
                     {
-                        // Get current cv and gradient
-                        auto& cv = cvs[i];
-                        auto& grad = cv->GetGradient();
-
-                        // Compute dV/dCV
-                        auto D = cvspring_[i]*(cv->GetDifference(centers_[i]));
-
-                        // Update forces
-                        for(size_t j = 0; j < forces.size(); j++)
-                                forces[j] -= D*grad[j];
+                        // Compute dV/dCV, applied to the forces by the hook
+                        derivatives_[i] = cvspring_[i]*(cvs[i]->GetDifference(centers_[i]));
                     }
                     umbrella_iter_++;    
                 }
@@ -132,7 +126,6 @@ namespace SSAGES
 				force.setZero();
 
 			auto& Pos = snapshot->GetPositions();
-			auto& IDs = snapshot->GetAtomIDs();
 
 			for(size_t i = 0; i < prev_IDs_[0].size(); i++)
 			{
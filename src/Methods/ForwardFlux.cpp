@@ -220,7 +220,7 @@ namespace SSAGES
         file.close();
     }
 	
-	void ForwardFlux::WriteFFSConfiguration(Snapshot* snapshot, FFSConfigID& ffsconfig, bool wassuccess)
+	void ForwardFlux::WriteFFSConfiguration(const Snapshot* snapshot, FFSConfigID& ffsconfig, bool wassuccess)
 	{
 		const auto& positions = snapshot->GetPositions();
 		const auto& velocities = snapshot->GetVelocities();
@@ -267,7 +267,7 @@ namespace SSAGES
     
     }
 
-    void ForwardFlux::AppendTrajectoryFile(Snapshot* snapshot, std::ofstream& file){
+    void ForwardFlux::AppendTrajectoryFile(const Snapshot* snapshot, std::ofstream& file){
 
 		const auto& positions = snapshot->GetPositions();
 		const auto& velocities = snapshot->GetVelocities();
@@ -289,7 +289,6 @@ namespace SSAGES
 	{
 		auto& positions = snapshot->GetPositions();
 		auto& velocities = snapshot->GetVelocities();
-		auto& atomID = snapshot->GetAtomIDs();
 		auto& forces = snapshot->GetForces();
 		//auto& ID = snapshot->GetSnapshotID();
 
@@ -308,6 +307,9 @@ namespace SSAGES
         file.open(filename);
         if (!file) {std::cerr << "Error! Unable to read " << filename << "\n"; exit(1);}
 
+        for(auto& force : forces)
+            force.setZero();
+
         unsigned int line_count = 0; 
         while(!std::getline(file,line).eof()){
 
@@ -330,14 +332,7 @@ namespace SSAGES
             // all other lines contain config information
             else if ((line_count != 0) && (tokens.size() == 7)){
             
-                //FIXME: try using snapshot->GetLocalIndex()
-
-                //copied from Ben's previous implementation
-                for(size_t i=0; i < atomID.size(); i++)
-                {
-                    if(atomID[i] == std::stoi(tokens[0]))
-                        atomindex = i;
-                }
+                atomindex = snapshot->GetLocalIndex(std::stoi(tokens[0]));
 
                 if(atomindex < 0)
                 {
@@ -351,10 +346,6 @@ namespace SSAGES
                 velocities[atomindex][0] = std::stod(tokens[4]);
                 velocities[atomindex][1] = std::stod(tokens[5]);
                 velocities[atomindex][2] = std::stod(tokens[6]);
-
-                for(auto& force : forces)
-                    force.setZero();
-
             }
             // else throw error
             else{
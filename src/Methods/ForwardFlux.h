@@ -195,7 +195,7 @@ namespace SSAGES
         int HasCrossedInterface(double, double, unsigned int interface);
 
         //! Write a file corresponding to FFSConfigID from current snapshot
-        void WriteFFSConfiguration(Snapshot *snapshot,FFSConfigID& ffsconfig, bool wassuccess);
+        void WriteFFSConfiguration(const Snapshot *snapshot,FFSConfigID& ffsconfig, bool wassuccess);
 
         //! Read a file corresponding to a FFSConfigID into current snapshot
         void ReadFFSConfiguration(Snapshot *,FFSConfigID&,bool);
@@ -236,7 +236,7 @@ namespace SSAGES
         
         //! Take the current config in snapshot and append it to the provided ofstream
         //! Current format is xyz style (including vx,vy,vz)
-        void AppendTrajectoryFile(Snapshot*, std::ofstream&);
+        void AppendTrajectoryFile(const Snapshot*, std::ofstream&);
 
         //! Take the current config in snapshot and append it to the provided ofstream
         void OpenTrajectoryFile(std::ofstream&);
@@ -378,6 +378,9 @@ namespace SSAGES
 		 */
 		void PostSimulation(Snapshot* snapshot, const CVList& cvs) override;
 
+		//! Needs no thermodynamic quantities.
+		unsigned GetThermoNeeds(int) const override { return NoThermo; }
+
 		//! \copydoc Serializable::Serialize()
 		void Serialize(Json::Value& json) const override
 		{
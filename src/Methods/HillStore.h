@@ -0,0 +1,317 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "../CVs/CollectiveVariable.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Multidimensional hill
+	/*!
+	 * Structure representing a multidimensional hill (Gaussian) which is
+	 * centered at "center" with widths "width" of height "height". A
+	 * multidimensional Gaussian has one height but n centers and widths.
+	 */
+	struct Hill
+	{
+		//! Hill center.
+		std::vector<double> center;
+
+		//! Hill width.
+		std::vector<double> width;
+
+		//! Hill height.
+		double height;
+
+		//! Constructs a multidimensional Hill (Gaussian)
+		/*!
+		 * \param center Hill center.
+		 * \param sigma Hill width.
+		 * \param height Hill height.
+		 */
+		Hill(const std::vector<double>& center,
+			 const std::vector<double>& sigma,
+			 double height) :
+		 center(center), width(sigma), height(height)
+		{}
+	};
+
+	//! Hills binned by their centers.
+	/*!
+	 * Hills are sorted into uniform bins in CV space, which are as wide as
+	 * the cutoff of the hills. Evaluating the bias only visits the bins
+	 * within the cutoff of the CV values, typically 3 per dimension, so the
+	 * cost does not grow with the number of hills deposited elsewhere. Bins
+	 * are stored sparsely, so CV space needs no bounds.
+	 *
+	 * Each bin stores its hills as arrays of centers, widths and heights,
+	 * and the Gaussians of a bin are accumulated in loops over these arrays.
+	 *
+	 * Hills only contribute where every CV is within the cutoff of the
+	 * center, in units of the widths. This is the same window as for hills
+	 * added onto a grid.
+	 */
+	class HillStore
+	{
+	private:
+		//! Hills in one bin.
+		struct Bin
+		{
+			std::vector<std::vector<double>> center; //!< Centers per CV.
+			std::vector<std::vector<double>> width; //!< Widths per CV.
+			std::vector<double> height; //!< Heights.
+		};
+
+		//! Hash of bin indices.
+		struct BinHash
+		{
+			//! Combine the indices of all dimensions.
+			size_t operator()(const std::vector<int>& key) const
+			{
+				size_t h = 0;
+				for(auto k : key)
+					h ^= std::hash<int>()(k) + 0x9e3779b9 + (h << 6) + (h >> 2);
+				return h;
+			}
+		};
+
+		size_t dim_; //!< Number of CVs.
+		double cutoff_; //!< Cutoff in units of the widths.
+		size_t size_; //!< Number of hills.
+		std::vector<double> binwidth_; //!< Bin width along each CV.
+		std::vector<double> maxwidth_; //!< Widest hill along each CV.
+		std::vector<int> minbin_, maxbin_; //!< Range of occupied bins.
+
+		std::vector<Bin> bins_; //!< Occupied bins.
+		std::unordered_map<std::vector<int>, size_t, BinHash> index_; //!< Bin of each key.
+
+		std::vector<int> key_; //!< Bin indices being looked up.
+		std::vector<std::vector<int>> candidates_; //!< Bins to visit along each CV.
+		std::vector<size_t> odometer_; //!< Position in the candidate bins.
+		std::vector<std::vector<double>> dx_; //!< Differences to the centers.
+		std::vector<double> g_, mask_; //!< Gaussians and cutoff mask.
+
+		//! Bin index of a value along one CV.
+		int BinIndex(size_t d, double x) const
+		{
+			return static_cast<int>(std::floor(x/binwidth_[d]));
+		}
+
+		//! Collect the bins within the cutoff of a CV value.
+		/*!
+		 * \param d Index of the CV.
+		 * \param cv CV whose periodicity applies.
+		 *
+		 * Windows which cross a periodic boundary are split into two
+		 * ranges of bins. Windows wider than half a period cover every
+		 * occupied bin.
+		 */
+		void CollectCandidates(size_t d, const CollectiveVariable& cv)
+		{
+			auto& candidates = candidates_[d];
+			candidates.clear();
+
+			const double x = cv.GetValue();
+			const double r = cutoff_*maxwidth_[d];
+			const double eps = 1e-10*(1. + r);
+			const int first = minbin_[d], last = maxbin_[d];
+
+			auto add = [&](int lo, int hi)
+			{
+				for(int k = std::max(lo, first); k <= std::min(hi, last); ++k)
+					candidates.push_back(k);
+			};
+
+			if(std::abs(cv.GetDifference(x - r) - r) > eps ||
+			   std::abs(cv.GetDifference(x + r) + r) > eps)
+			{
+				add(first, last);
+				return;
+			}
+
+			auto lo = BinIndex(d, cv.GetPeriodicValue(x - r));
+			auto hi = BinIndex(d, cv.GetPeriodicValue(x + r));
+			if(lo <= hi)
+				add(lo, hi);
+			else
+			{
+				add(lo, last);
+				add(first, hi);
+			}
+		}
+
+		//! Accumulate the hills of one bin.
+		/*!
+		 * \param bin Bin of hills.
+		 * \param cvs List of CVs.
+		 * \param derivatives Derivatives of the bias to add to.
+		 * \return Bias of the hills.
+		 */
+		double Accumulate(const Bin& bin, const CVList& cvs, std::vector<double>& derivatives)
+		{
+			const size_t m = bin.height.size();
+			g_.assign(m, 0.);
+			mask_.assign(m, 1.);
+
+			// Periodic differences go through the CVs, everything
+			// else runs over contiguous arrays.
+			for(size_t d = 0; d < dim_; ++d)
+			{
+				auto& dx = dx_[d];
+				dx.resize(m);
+				const auto* c = bin.center[d].data();
+				const auto* w = bin.width[d].data();
+				auto* g = g_.data();
+				auto* mask = mask_.data();
+				const auto& cv = *cvs[d];
+				for(size_t k = 0; k < m; ++k)
+					dx[k] = cv.GetDifference(c[k]);
+
+				for(size_t k = 0; k < m; ++k)
+				{
+					auto u = dx[k]/w[k];
+					g[k] += 0.5*u*u;
+					mask[k] *= std::abs(u) <= cutoff_ ? 1. : 0.;
+				}
+			}
+
+			double bias = 0;
+			const auto* h = bin.height.data();
+			for(size_t k = 0; k < m; ++k)
+			{
+				g_[k] = mask_[k]*h[k]*std::exp(-g_[k]);
+				bias += g_[k];
+			}
+
+			for(size_t d = 0; d < dim_; ++d)
+			{
+				const auto* dx = dx_[d].data();
+				const auto* w = bin.width[d].data();
+				double sum = 0;
+				for(size_t k = 0; k < m; ++k)
+					sum -= g_[k]*dx[k]/(w[k]*w[k]);
+				derivatives[d] += sum;
+			}
+
+			return bias;
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param widths Typical hill widths, which set the bin widths.
+		 * \param cutoff Cutoff of the hills in units of their widths.
+		 */
+		HillStore(const std::vector<double>& widths, double cutoff) :
+		dim_(widths.size()), cutoff_(cutoff), size_(0), binwidth_(widths),
+		maxwidth_(widths), minbin_(widths.size(), 0), maxbin_(widths.size(), -1),
+		bins_(), index_(), key_(widths.size()), candidates_(widths.size()),
+		odometer_(widths.size()), dx_(widths.size()), g_(), mask_()
+		{
+			for(auto& b : binwidth_)
+				b *= cutoff_;
+		}
+
+		//! Get the number of hills.
+		size_t size() const { return size_; }
+
+		//! Add a hill.
+		/*!
+		 * \param hill Hill to be added.
+		 */
+		void Add(const Hill& hill)
+		{
+			for(size_t d = 0; d < dim_; ++d)
+			{
+				key_[d] = BinIndex(d, hill.center[d]);
+				maxwidth_[d] = std::max(maxwidth_[d], hill.width[d]);
+				minbin_[d] = size_ ? std::min(minbin_[d], key_[d]) : key_[d];
+				maxbin_[d] = size_ ? std::max(maxbin_[d], key_[d]) : key_[d];
+			}
+
+			auto it = index_.find(key_);
+			if(it == index_.end())
+			{
+				it = index_.emplace(key_, bins_.size()).first;
+				bins_.emplace_back();
+				bins_.back().center.resize(dim_);
+				bins_.back().width.resize(dim_);
+			}
+
+			auto& bin = bins_[it->second];
+			for(size_t d = 0; d < dim_; ++d)
+			{
+				bin.center[d].push_back(hill.center[d]);
+				bin.width[d].push_back(hill.width[d]);
+			}
+			bin.height.push_back(hill.height);
+			++size_;
+		}
+
+		//! Evaluate the bias and its derivatives at the current CV values.
+		/*!
+		 * \param cvs List of CVs.
+		 * \param derivatives Derivatives of the bias with respect to each
+		 *        CV, which the hills are added to.
+		 * \return Bias at the current CV values.
+		 */
+		double Evaluate(const CVList& cvs, std::vector<double>& derivatives)
+		{
+			if(size_ == 0)
+				return 0.;
+
+			size_t ncandidates = 1;
+			for(size_t d = 0; d < dim_; ++d)
+			{
+				CollectCandidates(d, *cvs[d]);
+				ncandidates *= candidates_[d].size();
+			}
+
+			// Looking up more bins than are occupied does not pay off.
+			double bias = 0;
+			if(ncandidates >= bins_.size())
+			{
+				for(auto& bin : bins_)
+					bias += Accumulate(bin, cvs, derivatives);
+				return bias;
+			}
+
+			std::fill(odometer_.begin(), odometer_.end(), 0);
+			for(size_t n = 0; n < ncandidates; ++n)
+			{
+				for(size_t d = 0; d < dim_; ++d)
+					key_[d] = candidates_[d][odometer_[d]];
+
+				auto it = index_.find(key_);
+				if(it != index_.end())
+					bias += Accumulate(bins_[it->second], cvs, derivatives);
+
+				for(size_t d = 0; d < dim_ && ++odometer_[d] == candidates_[d].size(); ++d)
+					odometer_[d] = 0;
+			}
+
+			return bias;
+		}
+	};
+}
@@ -21,6 +21,7 @@
  */
 #include "Meta.h"
 #include <math.h>
+#include <algorithm>
 #include <iostream>
 #include "Drivers/DriverException.h"
 
@@ -52,7 +53,7 @@ namespace SSAGES
 	}
 
 	// Pre-simulation hook.
-	void Meta::PreSimulation(Snapshot* snapshot, const CVList& cvs)
+	void Meta::PreSimulation(Snapshot*, const CVList& cvs)
 	{
 		// Write ouput file header.
 		if(world_.rank() == 0)
@@ -71,21 +72,7 @@ namespace SSAGES
 			hillsout_.close();
 		}
 
-		// Initialize grid to zero. 
-		if(grid_ != nullptr)
-		{
-			Vector vec = Vector::Zero(cvs.size());
-			std::fill(grid_->begin(), grid_->end(), vec);
-		} 
-
-		auto n = snapshot->GetTargetIterations();
-		n = n ? n : 1e5; // Pre-allocate at least something.
-	
-		hills_.reserve(n+1);
-		widths_.reserve(n+1);
 		derivatives_.resize(cvs.size());
-		tder_.resize(cvs.size());
-		dx_.resize(cvs.size());
 	}
 
 	// Post-integration hook.
@@ -93,29 +80,11 @@ namespace SSAGES
 	{
 		// Add hills when needed.
 		if(snapshot->GetIteration() % hillfreq_ == 0)
-			AddHill(cvs, snapshot->GetIteration());
+			AddHill(cvs, *snapshot);
 
-		// Always calculate the current bias.
+		// Always calculate the current bias. The hook applies it 
+		// to the atoms using the chain rule.
 		CalcBiasForce(cvs);
-
-		// Take each CV and add its biased forces to the atoms
-		// using the chain rule.
-		auto& forces = snapshot->GetForces();
-		auto& virial = snapshot->GetVirial();
-
-		for(size_t i = 0; i < cvs.size(); ++i)
-		{
-			auto& grad = cvs[i]->GetGradient();
-			auto& boxgrad = cvs[i]->GetBoxGradient();
-			
-			// Update the forces in snapshot by adding in the force bias from each
-			// CV to each atom based on the gradient of the CV.
-			for (size_t j = 0; j < forces.size(); ++j)
-				for(size_t k = 0; k < 3; ++k)
-					forces[j][k] -= derivatives_[i]*grad[j][k];
-			
-			virial += derivatives_[i]*boxgrad;
-		}
 	}
 
 	// Post-simulation hook.
@@ -151,74 +120,168 @@ namespace SSAGES
 			// Load height. 
 			iss >> height;
 
-			hills_.emplace_back(center, width, height);
+			Hill hill(center, width, height);
+			hills_.Add(hill);
+			if(grid_ != nullptr)
+				DepositHill(hill);
 		}
 	}
 
 	// Drop a new hill.
-	void Meta::AddHill(const CVList& cvs, int iteration)
+	void Meta::AddHill(const CVList& cvs, const Snapshot& snapshot)
 	{
 		int n = cvs.size();
 
 		// Assume we have the same number of procs per walker.
 		int nwalkers = world_.size()/comm_.size();
 
-		// We need to exchange CV values across the walkers 
-		// and to each proc on a walker.	
-		std::vector<double> cvals(n*nwalkers, 0);
+		// We need to exchange CV values and hill heights across the 
+		// walkers and to each proc on a walker.	
+		std::vector<double> cvals((n + 1)*nwalkers, 0);
 
 		if(comm_.rank() == 0)
 		{
-			for(auto i = 0, j = world_.rank()/comm_.size()*n; i < n; ++i,++j)
-				cvals[j] = cvs[i]->GetValue();
+			auto j = world_.rank()/comm_.size()*(n + 1);
+			for(auto i = 0; i < n; ++i)
+				cvals[j + i] = cvs[i]->GetValue();
+
+			// Well-tempered hills shrink where the bias is high. Each 
+			// walker scales its own hill.
+			cvals[j + n] = height_;
+			if(biasfactor_ > 0)
+			{
+				auto kT = snapshot.GetKb()*temperature_;
+				cvals[j + n] *= exp(-CalcBias(cvs)/(kT*(biasfactor_ - 1.)));
+			}
 		}
 
 		// Reduce across all processors and add hills.
-		MPI_Allreduce(MPI_IN_PLACE, cvals.data(), n*nwalkers, MPI_DOUBLE, MPI_SUM, world_);
+		MPI_Allreduce(MPI_IN_PLACE, cvals.data(), (n + 1)*nwalkers, MPI_DOUBLE, MPI_SUM, world_);
 		
-		for(int i = 0; i < n*nwalkers; i += n)
+		for(int i = 0; i < (n + 1)*nwalkers; i += n + 1)
 		{
 			std::vector<double> cval(cvals.begin() + i, cvals.begin() + i + n);
-			hills_.emplace_back(cval, widths_, height_);
+			Hill hill(cval, widths_, cvals[i + n]);
+			hills_.Add(hill);
 			
 			// Write hill to file.
 			if(world_.rank() == 0)
-				PrintHill(hills_.back(), iteration);
+				PrintHill(hill, snapshot.GetIteration());
+
+			// If grid is defined, add bias onto grid. 
+			if(grid_ != nullptr)
+				DepositHill(hill);
 		}
+	}
 
-		// If grid is defined, add bias onto grid. 
-		if(grid_ != nullptr)
+	// Add a hill onto the grid. The Gaussians are separable, so they are 
+	// tabulated along each dimension and combined on the sub-grid around 
+	// the center.
+	void Meta::DepositHill(const Hill& hill)
+	{
+		const size_t n = grid_->GetDimension();
+		gauss_.resize(n);
+		dgauss_.resize(n);
+		offsets_.resize(n);
+
+		for(size_t d = 0; d < n; ++d)
 		{
-			std::vector<double> dx(n, 0.0), df(n, 1.0);
-			auto& hill = hills_.back();
-			for(auto it = grid_->begin(); it != grid_->end(); ++it)
+			auto& g = gauss_[d];
+			auto& dg = dgauss_[d];
+			auto& offsets = offsets_[d];
+			g.clear();
+			dg.clear();
+			offsets.clear();
+
+			const int npoints = grid_->GetNumPoints(d);
+			const double lower = grid_->GetLower(d);
+			const double spacing = (grid_->GetUpper(d) - lower)/npoints;
+			const double sigma = hill.width[d];
+
+			// Grid points within the cutoff. In periodic dimensions, 
+			// points are visited once at their nearest image.
+			int center = std::floor((hill.center[d] - lower)/spacing);
+			int range = std::ceil(cutoff_*sigma/spacing);
+			int first = center - range, last = center + range;
+			if(grid_->GetPeriodic(d))
 			{
-				auto& val = *it;
-				auto coord = it.coordinates();
-
-				// Compute difference between grid point and current val. 
-				for(size_t i = 0; i < n; ++i)
+				if(last - first >= npoints)
 				{
-					dx[i] = -cvs[i]->GetDifference(coord[i]);
-					df[i] = 1.;
+					first = center - npoints/2;
+					last = first + npoints - 1;
 				}
+			}
+			else
+			{
+				first = std::max(first, 0);
+				last = std::min(last, npoints - 1);
+			}
 
-				// Compute derivative.
-				for(size_t i = 0; i < n; ++i)
-				{
-					for(size_t j = 0; j < n; ++j)
-					{
-						if(j != i) 
-							df[i] *= gaussian(dx[j], hill.width[j]);
-						else
-							df[i] *= gaussianDerv(dx[j], hill.width[j]);
-					}
-				}
+			for(int k = first; k <= last; ++k)
+			{
+				auto dx = lower + (k + 0.5)*spacing - hill.center[d];
+				if(std::abs(dx) > cutoff_*sigma)
+					continue;
+
+				auto index = (k % npoints + npoints) % npoints;
+				g.push_back(gaussian(dx, sigma));
+				dg.push_back(gaussianDerv(dx, sigma));
+				offsets.push_back(index*grid_->GetStride(d));
+			}
 
-				// Add to grid. 
-				for(size_t i = 0; i < n; ++i)
-					val[i] += height_*df[i];
+			// Hill is out of range.
+			if(g.empty())
+				return;
+		}
+
+		// Loop over the higher dimensions and sweep the first one, which 
+		// is contiguous in memory.
+		auto* data = grid_->data();
+		auto* energy = energy_->data();
+		const auto& g0 = gauss_[0];
+		const auto& dg0 = dgauss_[0];
+		const auto& offsets0 = offsets_[0];
+		std::vector<size_t> k(n, 0);
+		std::vector<double> douter(n, 0.);
+		while(true)
+		{
+			// Products of the higher dimensions and their derivatives.
+			size_t base = 0;
+			double outer = hill.height;
+			for(size_t d = 1; d < n; ++d)
+			{
+				base += offsets_[d][k[d]];
+				outer *= gauss_[d][k[d]];
 			}
+
+			for(size_t i = 1; i < n; ++i)
+			{
+				douter[i] = hill.height;
+				for(size_t d = 1; d < n; ++d)
+					douter[i] *= d == i ? dgauss_[d][k[d]] : gauss_[d][k[d]];
+			}
+
+			for(size_t j = 0; j < g0.size(); ++j)
+			{
+				auto idx = base + offsets0[j];
+				auto& val = data[idx];
+				energy[idx] += g0[j]*outer;
+				val[0] += dg0[j]*outer;
+				for(size_t i = 1; i < n; ++i)
+					val[i] += g0[j]*douter[i];
+			}
+
+			// Next sub-grid row.
+			size_t d = 1;
+			for(; d < n; ++d)
+			{
+				if(++k[d] < gauss_[d].size())
+					break;
+				k[d] = 0;
+			}
+
+			if(d >= n)
+				break;
 		}
 	}
 
@@ -237,14 +300,35 @@ namespace SSAGES
 		for(auto& w : hill.width)
 			hillsout_ << w << " ";
 
-		hillsout_ << height_ << std::endl;
+		hillsout_ << hill.height << std::endl;
 		hillsout_.close();
 	}
 
+	// Bias potential at the current CV values.
+	double Meta::CalcBias(const CVList& cvs)
+	{
+		auto n = cvs.size();
+		if(grid_ != nullptr)
+		{
+			bool inbounds = true;
+			std::vector<double> val(n, 0.);
+			for(size_t i = 0; i < n; ++i)
+			{
+				val[i] = cvs[i]->GetValue();
+				if(val[i] < grid_->GetLower(i) || val[i]  > grid_->GetUpper(i))
+					inbounds = false;
+			}
+
+			if(inbounds)
+				return (*energy_)[val];
+		}
+
+		std::vector<double> der(n, 0.);
+		return hills_.Evaluate(cvs, der);
+	}
+
 	void Meta::CalcBiasForce(const CVList& cvs)
 	{	
-		// Reset bias and derivatives.
-		double bias = 0.;
 		auto n = cvs.size();
 
 		// Reset vectors.
@@ -264,7 +348,7 @@ namespace SSAGES
 
 			if(inbounds)
 			{
-				auto frc = (*grid_)[val];
+				const auto& frc = (*grid_)[val];
 				for(size_t i = 0; i < n; ++i)
 					derivatives_[i] = frc[i];
 			}
@@ -281,32 +365,8 @@ namespace SSAGES
 		}
 		else
 		{
-			// Loop through hills and calculate the bias force.
-			for(auto& hill : hills_)
-			{		
-				auto tbias = 1.;
-				std::fill(tder_.begin(), tder_.end(), 1.0);
-				std::fill(dx_.begin(), dx_.end(), 1.0);
-				
-				for(size_t i = 0; i < n; ++i)
-				{
-					dx_[i] = cvs[i]->GetDifference(hill.center[i]);
-					tbias *= gaussian(dx_[i], hill.width[i]);
-				}
-
-				for(size_t i = 0; i < n; ++i)
-					for(size_t j = 0; j < n; ++j)
-					{
-						if(j != i) 
-							tder_[i] *= gaussian(dx_[j], hill.width[j]);
-						else
-							tder_[i] *= gaussianDerv(dx_[j], hill.width[j]);
-					}
-
-				bias += height_ * tbias;
-				for(size_t i = 0; i < n; ++i)
-					derivatives_[i] += height_*tder_[i];
-			}
+			// Only visit hills near the current CV values.
+			hills_.Evaluate(cvs, derivatives_);
 		}
 
 		// Restraints.
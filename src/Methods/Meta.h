@@ -24,41 +24,13 @@
 #include "Method.h"
 #include "../CVs/CollectiveVariable.h"	
 #include "Grids/Grid.h"
+#include "HillStore.h"
 #include <fstream>
+#include <memory>
 #include <vector>
 
 namespace SSAGES
 {
-	//! Multidimensional hill
-	/*!
-	 * Structure representing a multidimensional hill (Gaussian) which is
-	 * centered at "center" with widths "width" of height "height". A
-	 * multidimensional Gaussian has one height but n centers and widths.
-	 */
-	struct Hill 
-	{
-		//! Hill center.
-		std::vector<double> center;
-
-		//! Hill width.
-		std::vector<double> width;
-
-		//! Hill height.
-		double height;
-		
-		//! Constructs a multidimensional Hill (Gaussian)
-		/*!
-		 * \param center Hill center.
-		 * \param sigma Hill width.
-		 * \param height Hill height.
-		 */
-		Hill(const std::vector<double>& center, 
-			 const std::vector<double>& sigma, 
-			 double height) :
-		 center(center), width(sigma), height(height)
-		{}
-	};
-
 	//! "Vanilla" multi-dimensional Metadynamics.
 	/*!
 	 * Implementation of a "vanilla" multi-dimensional Metadynamics method with
@@ -69,8 +41,8 @@ namespace SSAGES
 	class Meta : public Method
 	{
 	private:	
-		//! Hills.
-		std::vector<Hill> hills_;
+		//! Hills, binned by their centers.
+		HillStore hills_;
 
 		//! Hill height.
 		double height_;
@@ -78,27 +50,62 @@ namespace SSAGES
 		//! Hill widths.
 		std::vector<double> widths_;
 
-		//! Derivatives and temporary storage vectors.
-		std::vector<double> derivatives_, tder_, dx_;
-
 		//! Frequency of new hills
 		unsigned int hillfreq_;
 
 		//! CV Grid. 
 		Grid<Vector>* grid_;
 
+		//! Bias potential on the points of the CV grid.
+		std::unique_ptr<Grid<double>> energy_;
+
 		//! Bounds 
 		std::vector<double> upperb_, lowerb_; 
 
 		//! Bound restraints. 
 		std::vector<double> upperk_, lowerk_;
 
+		//! Cutoff of hills on the grid, in units of the hill widths.
+		double cutoff_;
+
+		//! Gaussians and their derivatives along each dimension of the grid.
+		std::vector<std::vector<double>> gauss_, dgauss_;
+
+		//! Storage offsets of the grid points along each dimension.
+		std::vector<std::vector<size_t>> offsets_;
+
+		//! Bias factor of well-tempered metadynamics, or 0 if disabled.
+		double biasfactor_;
+
+		//! Temperature of the system for well-tempered metadynamics.
+		double temperature_;
+
 		//! Adds a new hill.
 		/*!
 		 * \param cvs List of CVs.
-		 * \param iteration Current iteration.
+		 * \param snapshot Current simulation snapshot.
 		 */
-		void AddHill(const CVList& cvs, int iteration);
+		void AddHill(const CVList& cvs, const Snapshot& snapshot);
+
+		//! Get the bias potential at the current CV values.
+		/*!
+		 * \param cvs List of CVs.
+		 * \return Bias potential.
+		 *
+		 * Within the grid, the bias is looked up on the grid point. Outside,
+		 * it is summed over the nearby hills.
+		 */
+		double CalcBias(const CVList& cvs);
+
+		//! Adds a hill onto the grid.
+		/*!
+		 * \param hill Hill to be added.
+		 *
+		 * Only grid points within the cutoff of the center along every
+		 * dimension are updated, so the cost does not depend on the size
+		 * of the grid.
+		 */
+		void DepositHill(const Hill& hill);
 
 		//! Computes the bias force.
 		/*!
@@ -125,8 +132,17 @@ namespace SSAGES
 		 * \param widths Width of the hills to be deposited.
 		 * \param hillfreq Frequency of depositing hills.
 		 * \param frequency Frequency of invoking this method.
+		 * \param cutoff Distance from the hill center, in units of the
+		 *        widths, beyond which hills do not contribute to the bias.
+		 * \param biasfactor Bias factor of well-tempered metadynamics, or 0
+		 *        for hills of constant height.
+		 * \param temperature Temperature of the system, needed for
+		 *        well-tempered metadynamics.
 		 *
-		 * Constructs an instance of Metadynamics method.
+		 * Constructs an instance of Metadynamics method. In well-tempered
+		 * metadynamics, the height of each new hill is scaled by
+		 * exp(-V/(kB*T*(biasfactor - 1))), where V is the bias potential at
+		 * its center.
 		 * \note The size of "widths" should be commensurate with the number of
 		 *       CV's expected.
 		 */
@@ -140,11 +156,25 @@ namespace SSAGES
 			 const std::vector<double>& upperk,
 			 Grid<Vector>* grid,
 			 unsigned int hillfreq,
-			 unsigned int frequency) : 
-		Method(frequency, world, comm), hills_(), height_(height), widths_(widths), 
-		derivatives_(0), tder_(0), dx_(0), hillfreq_(hillfreq), grid_(grid),
-		upperb_(upperb), lowerb_(lowerb), upperk_(upperk), lowerk_(lowerk)
+			 unsigned int frequency,
+			 double cutoff,
+			 double biasfactor,
+			 double temperature) : 
+		Method(frequency, world, comm), hills_(widths, cutoff), height_(height), 
+		widths_(widths), hillfreq_(hillfreq), grid_(grid), energy_(),
+		upperb_(upperb), lowerb_(lowerb), upperk_(upperk), lowerk_(lowerk),
+		cutoff_(cutoff), gauss_(), dgauss_(), offsets_(), 
+		biasfactor_(biasfactor), temperature_(temperature)
 		{
+			// Start with a flat bias, so hills can be loaded before the 
+			// simulation.
+			if(grid_ != nullptr)
+			{
+				Vector vec = Vector::Zero(widths_.size());
+				std::fill(grid_->data(), grid_->data() + grid_->size(), vec);
+				energy_.reset(new Grid<double>(grid_->GetNumPoints(), 
+					grid_->GetLower(), grid_->GetUpper(), grid_->GetPeriodic()));
+			}
 		}
 
 		//! Pre-simulation hook.
@@ -168,6 +198,12 @@ namespace SSAGES
 		 */
 		void PostSimulation(Snapshot* snapshot, const CVList& cvs) override;
 
+		//! Only acts on the atoms of the CVs.
+		bool RequiresFullSync() const override { return false; }
+
+		//! Needs no thermodynamic quantities.
+		unsigned GetThermoNeeds(int) const override { return NoThermo; }
+
 		//! Load hills from file. 
 		/*! 
 		 * \param filename File name containing hills. 
@@ -189,6 +225,12 @@ namespace SSAGES
 				json["widths"].append(w);
 			json["height"] = height_;
 			json["hill_frequency"] = hillfreq_;
+			json["cutoff"] = cutoff_;
+			if(biasfactor_ > 0)
+			{
+				json["bias_factor"] = biasfactor_;
+				json["temperature"] = temperature_;
+			}
 		}
 
 		//! Destructor.
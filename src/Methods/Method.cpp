@@ -143,11 +143,24 @@ namespace SSAGES
 			auto height = json.get("height", 1.0).asDouble();
 			auto hillfreq = json.get("hill_frequency", 1).asInt();
 			auto freq = json.get("frequency", 1).asInt();
+			auto cutoff = json.get("cutoff", 6.0).asDouble();
+			auto biasfactor = json.get("bias_factor", 0.0).asDouble();
+			auto temperature = json.get("temperature", 0.0).asDouble();
+
+			if(grid != nullptr && grid->GetDimension() != widths.size())
+				throw BuildException({
+					"#/Method/Metadynamics: Grid dimension must match the "
+					"number of widths."});
+
+			if(biasfactor > 0 && temperature <= 0)
+				throw BuildException({
+					"#/Method/Metadynamics: Well-tempered metadynamics "
+					"requires a temperature."});
 
 			auto* m = new Meta(
 			    world, comm, height, widths, 
 				lowerb, upperb, lowerk,	upperk,
-				grid, hillfreq, freq
+				grid, hillfreq, freq, cutoff, biasfactor, temperature
 			);
 
 			if(json.isMember("load_hills"))
@@ -313,6 +313,9 @@ namespace SSAGES
 			stringout_.close();
 		}
 
+		//! Needs no thermodynamic quantities.
+		unsigned GetThermoNeeds(int) const override { return NoThermo; }
+
 		//! Set the tolerance for quitting method
 		/*!
 		 * \param tol List of tolerances for each CV.
@@ -63,6 +63,9 @@ namespace SSAGES
          auto& velocities = snapshot->GetVelocities();
          auto& atomids = snapshot->GetAtomIDs();
 
+        // No bias unless restrained below.
+        derivatives_.assign(cvs.size(), 0);
+
         if(snapshot_stored)
         {
             initialized = true;
@@ -92,21 +95,8 @@ namespace SSAGES
             {
                 for(size_t i = 0; i < cvs.size(); i++)
                 {
-                    //Get current CV and gradient
-                    auto& cv = cvs[i];
-                    auto& grad = cv->GetGradient();
-
-                    //Compute dV/dCV
-                    auto D = cvspring_[i]*(cv->GetDifference(centers_[i]));
-
-                    //Update forces
-                    for(size_t j = 0; j < forces.size(); j++)
-                    {
-                        for(int k = 0; k < forces[j].size(); k++)
-                        {
-                            forces[j][k] -= (double)D*grad[j][k];
-                        }
-                    }
+                    //Compute dV/dCV, applied to the forces by the hook
+                    derivatives_[i] = cvspring_[i]*(cvs[i]->GetDifference(centers_[i]));
                 }
             }
             else
@@ -148,21 +138,8 @@ namespace SSAGES
                     {
                         index_ = 0; //Reset index when starting
                     }
-                    //Get current CV and gradient
-                    auto& cv = cvs[i];
-                    auto& grad = cv->GetGradient();
-
-                    //Compute dV/dCV
-                    auto D = cvspring_[i]*(cv->GetDifference(centers_[i]));
-
-                    //Update forces
-                    for(size_t j = 0; j < forces.size(); j++)
-                    {
-                        for(int k = 0; k < forces[j].size(); k++)
-                        {
-                            forces[j][k] -= (double)D*grad[j][k]; 
-                        }
-                    }
+                    //Compute dV/dCV, applied to the forces by the hook
+                    derivatives_[i] = cvspring_[i]*(cvs[i]->GetDifference(centers_[i]));
                 }
                 if(iterator_ > initialize_steps_)
                 {
@@ -181,6 +158,7 @@ namespace SSAGES
                     index_ = 0;
                     for(auto& force: forces)
                         force.setZero();
+                    std::fill(derivatives_.begin(), derivatives_.end(), 0);
 
                     for(size_t i = 0; i < prev_IDs_[index_].size(); i++)
                     {
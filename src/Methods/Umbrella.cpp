@@ -32,28 +32,13 @@ namespace SSAGES
 
 	void Umbrella::PostIntegration(Snapshot* snapshot, const CVList& cvs)
 	{
-		// Compute the forces on the atoms from the CV's using the chain 
-		// rule.
-		auto& forces = snapshot->GetForces();
-		auto& virial = snapshot->GetVirial();
-		auto& H = snapshot->GetHMatrix();
-
+		// Compute dV/dCV. The hook applies the forces on the atoms 
+		// using the chain rule.
+		derivatives_.resize(cvs.size());
 		for(size_t i = 0; i < cvs.size(); ++i)
 		{
-			// Get current CV and gradient.
-			auto& cv = cvs[i];
-			auto& grad = cv->GetGradient();
-			auto& boxgrad = cv->GetBoxGradient();
-			// Compute dV/dCV.
 			auto center = GetCurrentCenter(snapshot->GetIteration(), i);
-			auto D = kspring_[i]*(cv->GetDifference(center));
-
-			// Update forces.
-			for(size_t j = 0; j < forces.size(); ++j)
-				forces[j] -= D*grad[j];
-			
-			// Update virial. 
-			virial += D*boxgrad;
+			derivatives_[i] = kspring_[i]*(cvs[i]->GetDifference(center));
 		}
 
 		iteration_++;
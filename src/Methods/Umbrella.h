@@ -141,6 +141,12 @@ namespace SSAGES
 		 */
 		void PostSimulation(Snapshot* snapshot, const CVList& cvs) override;
 
+		//! Only acts on the atoms of the CVs.
+		bool RequiresFullSync() const override { return false; }
+
+		//! Needs no thermodynamic quantities.
+		unsigned GetThermoNeeds(int) const override { return NoThermo; }
+
 		//! Set how often to log
 		/*!
 		 * \param iter New value for logging interval.
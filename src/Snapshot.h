@@ -19,16 +19,22 @@
  * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <algorithm>
 #include <numeric>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 #include <boost/mpi.hpp>
 #include "json/json.h"
 #include "JSON/Serializable.h"
 #include "types.h"
+#include "Utility/Vector3Array.h"
 
 namespace SSAGES
 {
+	// Forward declare.
+	class ExpressionCache;
+
 	//! Quick helper function to round a double.
 	inline double roundf(double x)
 	{
@@ -41,6 +47,10 @@ namespace SSAGES
 	 *
 	 * This contains information on the particle positions, velocities, etc...
 	 * and additional information on the state of the system.
+	 *
+	 * Positions, velocities and forces may be mapped directly onto the
+	 * arrays of the MD engine (see Vector3Array). Engines which cannot
+	 * provide contiguous double precision xyz data are copied instead.
 	 */
 	class Snapshot : public Serializable
 	{
@@ -62,10 +72,10 @@ namespace SSAGES
 
 		Bool3 isperiodic_; //!< Periodicity of box.
 
-		std::vector<Vector3> positions_; //!< Positions
+		Vector3Array positions_; //!< Positions
 		std::vector<Integer3> images_; //!< Unwrapped positions
-		std::vector<Vector3> velocities_; //!< Velocities
-		std::vector<Vector3> forces_; //!< Forces
+		Vector3Array velocities_; //!< Velocities
+		Vector3Array forces_; //!< Forces
 		std::vector<double> masses_; //!< Masses
 		std::vector<double> charges_; //!< Charges
 		Label atomids_; //!< List of Atom IDs
@@ -80,9 +90,85 @@ namespace SSAGES
 
 		double dielectric_; //!< Dielectric
 		double qqrd2e_; //!<qqrd2e
-		bool changed_; //!< \c TRUE is Simulation state changed
+		unsigned dirty_; //!< Bitmask of modified fields, see Snapshot::Field.
+
+		//! Map from atom ID to local index.
+		mutable std::unordered_map<int, int> idmap_;
+
+		//! Atom IDs the index map was last built from.
+		mutable Label mappedids_;
+
+		//! \c TRUE if atom IDs may have changed since the map was built.
+		mutable bool idsdirty_;
+
+		//! Incremented whenever the index map changes.
+		mutable size_t mapversion_;
+
+		//! Incremented whenever a field is flagged as modified.
+		size_t revision_;
+
+		//! Per-step cache of shared CV intermediates, may be null.
+		ExpressionCache* cache_;
+
+		//! Flag fields as modified.
+		void Modify(unsigned fields)
+		{
+			dirty_ |= fields;
+			++revision_;
+		}
+
+		//! Reduce the mass weighted displacements of a group of atoms.
+		/*!
+		 * \param indices Local indices of the atoms of interest.
+		 * \param ref Shared unwrapping reference, set on return.
+		 * \param sums Mass weighted displacement (0-2) and mass (3), set on return.
+		 *
+		 * Only four doubles per rank are gathered and four doubles reduced, 
+		 * regardless of group size. See GetGroupReference().
+		 */
+		void ReduceGroupSums(const Label& indices, Vector3& ref, double* sums) const
+		{
+			double local[4];
+			GetGroupReference(indices, local);
+
+			std::vector<double> refs(4*comm_.size());
+			MPI_Allgather(local, 4, MPI_DOUBLE, refs.data(), 4, MPI_DOUBLE, comm_);
+
+			ref = SelectGroupReference(refs.data());
+			GetGroupSums(indices, ref, sums);
+			MPI_Allreduce(MPI_IN_PLACE, sums, 4, MPI_DOUBLE, MPI_SUM, comm_);
+		}
+
+		//! Remove an ID from the index map if it still points to a slot.
+		void EraseMapping(int id, int idx) const
+		{
+			auto s = idmap_.find(id);
+			if(s != idmap_.end() && s->second == idx)
+				idmap_.erase(s);
+		}
 
 	public:
+		//! Fields of the snapshot whose modification is tracked.
+		/*!
+		 * Non-const accessors and setters flag the field they give access 
+		 * to, so hooks can tell which data needs to be pushed back.
+		 */
+		enum Field : unsigned
+		{
+			Positions  = 1 << 0, //!< Positions.
+			Velocities = 1 << 1, //!< Velocities.
+			Forces     = 1 << 2, //!< Forces.
+			Masses     = 1 << 3, //!< Masses.
+			ImageFlags = 1 << 4, //!< Image flags.
+			AtomIDs    = 1 << 5, //!< Atom IDs.
+			AtomTypes  = 1 << 6, //!< Atom types.
+			Charges    = 1 << 7, //!< Charges.
+			Sigmas     = 1 << 8, //!< Sigmas.
+			Virial     = 1 << 9, //!< Virial tensor.
+			State      = 1 << 10, //!< Box, iteration, thermodynamic and other scalars.
+			AllFields  = ~0u //!< All fields.
+		};
+
 		//! Constructor
 		/*!
 		 * \param comm MPI communicator
@@ -95,7 +181,9 @@ namespace SSAGES
 		comm_(comm), wid_(wid), H_(), Hinv_(), virial_(Matrix3::Zero()), 
 		origin_({0,0,0}), isperiodic_({true, true, true}), positions_(0), 
 		images_(0), velocities_(0), forces_(0), masses_(0), atomids_(0), 
-		types_(0), iteration_(0), temperature_(0), energy_(0), kb_(0)
+		types_(0), iteration_(0), temperature_(0), energy_(0), kb_(0),
+		dirty_(0), idmap_(), mappedids_(), idsdirty_(true), mapversion_(0),
+		revision_(0), cache_(nullptr)
 		{}
 
 		//! Get the current iteration
@@ -138,7 +226,11 @@ namespace SSAGES
 		/*!
 		 * \retun Virial tensor of the simulation box. 
 		 */
-		Matrix3& GetVirial() { return virial_; }
+		Matrix3& GetVirial() 
+		{ 
+			Modify(Virial);
+			return virial_; 
+		}
 
 		//! Get origin of the system.
 		/*! 
@@ -208,7 +300,7 @@ namespace SSAGES
 		void SetIteration(int iteration) 
 		{
 			iteration_ = iteration; 
-			changed_ = true; 
+			Modify(State); 
 		}
 		
 		//! Set target iterations
@@ -218,7 +310,7 @@ namespace SSAGES
 		void SetTargetIterations(int target) 
 		{
 			targetiter_ = target; 
-			changed_ = true; 
+			Modify(State); 
 		}
 
 		//! Change the temperature
@@ -228,7 +320,7 @@ namespace SSAGES
 		void SetTemperature(double temperature) 
 		{ 
 			temperature_ = temperature;
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Change the energy
@@ -238,7 +330,7 @@ namespace SSAGES
 		void SetEnergy(double energy) 
 		{
 			energy_ = energy;
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Change the Box H-matrix. 
@@ -249,7 +341,7 @@ namespace SSAGES
 		{
 			H_ = hmat;
 			Hinv_ = hmat.inverse();
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Change the box virial. 
@@ -259,7 +351,7 @@ namespace SSAGES
 		void SetVirial(const Matrix3& virial)
 		{
 			virial_ = virial; 
-			changed_ = true;
+			Modify(Virial);
 		}
 
 		//! Change the box origin.
@@ -269,7 +361,7 @@ namespace SSAGES
 		void SetOrigin(const Vector3& origin)
 		{
 			origin_ = origin; 
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Change the periodicity of the system
@@ -279,7 +371,7 @@ namespace SSAGES
 		void SetPeriodicity(const Bool3& isperiodic)
 		{
 			isperiodic_ = isperiodic;
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Change the kb
@@ -289,7 +381,7 @@ namespace SSAGES
 		void SetKb(double kb) 
 		{
 			kb_ = kb;
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Set the dielectric constant.
@@ -299,7 +391,7 @@ namespace SSAGES
 		void SetDielectric(double dielectric) 
 		{ 
 			dielectric_ = dielectric;
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Set the value for qqrd2e
@@ -309,7 +401,7 @@ namespace SSAGES
 		void Setqqrd2e(double qqrd2e) 
 		{ 
 			qqrd2e_ = qqrd2e;
-			changed_ = true;
+			Modify(State);
 		}
 
 		//! Set number of atoms in this snapshot.
@@ -322,12 +414,12 @@ namespace SSAGES
 		/*!
 		 * \return List of particle positions
 		 */
-		const std::vector<Vector3>& GetPositions() const { return positions_; }
+		const Vector3Array& GetPositions() const { return positions_; }
 
 		/*! \copydoc Snapshot::GetPositions() const */
-		std::vector<Vector3>& GetPositions() 
+		Vector3Array& GetPositions() 
 		{ 
-			changed_ = true;
+			Modify(Positions);
 			return positions_; 
 		}
 
@@ -340,7 +432,7 @@ namespace SSAGES
 		//! \copydoc Snapshot::GetImageFlags() const
 		std::vector<Integer3>& GetImageFlags() 
 		{ 
-			changed_ = true;
+			Modify(ImageFlags);
 			return images_; 
 		}
 
@@ -348,12 +440,12 @@ namespace SSAGES
 		/*!
 		 * \return List of particle velocities
 		 */
-		const std::vector<Vector3>& GetVelocities() const { return velocities_; }
+		const Vector3Array& GetVelocities() const { return velocities_; }
 
 		/*! \copydoc Snapshot::GetVelocities() const */
-		std::vector<Vector3>& GetVelocities() 
+		Vector3Array& GetVelocities() 
 		{
-			changed_ = true;
+			Modify(Velocities);
 			return velocities_; 
 		}
 
@@ -361,12 +453,12 @@ namespace SSAGES
 		/*!
 		 * \return List of per-particle forces
 		 */
-		const std::vector<Vector3>& GetForces() const { return forces_; }
+		const Vector3Array& GetForces() const { return forces_; }
 
 		/*! \copydoc Snapshot::GetForces() const */
-		std::vector<Vector3>& GetForces() 
+		Vector3Array& GetForces() 
 		{
-			changed_ = true; 
+			Modify(Forces); 
 			return forces_; 
 		}
 
@@ -382,7 +474,7 @@ namespace SSAGES
 		/*! \copydoc Snapshot::GetMasses() const */
 		std::vector<double>& GetMasses() 
 		{
-			changed_ = true; 
+			Modify(Masses); 
 			return masses_; 
 		}
 
@@ -459,18 +551,24 @@ namespace SSAGES
 			return mtot;
 		}
 
-		//! Compute center of mass of a group of atoms based on idex with provided 
-		//! Total mass.
+		//! Compute center of mass of a group of atoms based on index.
 		/*!
 		  * \param indices IDs of particles of interest. 
 		  * \return Vector3 Center of mass of particles.
+		  *
+		  * \note The total mass is reduced along with the mass weighted 
+		  *       positions, so no separate call to TotalMass() is needed.
 		  */ 		
 		Vector3 CenterOfMass(const Label& indices) const
 		{
-			// Get total mass.
-			auto mtot = TotalMass(indices);
+			Vector3 ref;
+			double sums[4];
+			ReduceGroupSums(indices, ref, sums);
 
-			return CenterOfMass(indices, mtot);			
+			if(sums[3] == 0)
+				return ref;
+
+			return ref + Vector3{sums[0], sums[1], sums[2]}/sums[3];
 		}
 
 		//! Compute center of mass of a group of atoms based on idex with provided 
@@ -484,56 +582,80 @@ namespace SSAGES
 		  */ 
 		Vector3 CenterOfMass(const Label& indices, double mtot) const
 		{
-			// Store coorinates and masses in vectors to gather. 
-			std::vector<double> pos, mass, gpos, gmass;
-			std::vector<int> pcounts(comm_.size(), 0), mcounts(comm_.size(), 0); 
-			std::vector<int> pdispls(comm_.size()+1, 0), mdispls(comm_.size()+1, 0);
-
-			pcounts[comm_.rank()] = 3*indices.size();
-			mcounts[comm_.rank()] = indices.size();
+			Vector3 ref;
+			double sums[4];
+			ReduceGroupSums(indices, ref, sums);
 
-			// Reduce counts.
-			MPI_Allreduce(MPI_IN_PLACE, pcounts.data(), pcounts.size(), MPI_INT, MPI_SUM, comm_);
-			MPI_Allreduce(MPI_IN_PLACE, mcounts.data(), mcounts.size(), MPI_INT, MPI_SUM, comm_);
+			return ref + Vector3{sums[0], sums[1], sums[2]}/mtot;
+		}
 
-			// Compute displacements.
-			std::partial_sum(pcounts.begin(), pcounts.end(), pdispls.begin() + 1);
-			std::partial_sum(mcounts.begin(), mcounts.end(), mdispls.begin() + 1);
-			
-			// Fill up mass and position vectors.
-			for(auto& idx : indices)
+		//! Get the local candidate for a group unwrapping reference.
+		/*!
+		 * \param indices Local indices of the atoms of interest.
+		 * \param slot Four doubles receiving a flag and the position of the 
+		 *        first local group atom. All zero if there is none.
+		 *
+		 * Together with SelectGroupReference() and GetGroupSums() this 
+		 * computes a distributed center of mass. Every rank contributes its 
+		 * slot, the first rank holding any atom provides the reference, and 
+		 * each rank unwraps its own atoms against it by minimum image. 
+		 * CenterOfMass() does the communication itself, while CVs may batch 
+		 * it with others through a CommPlan.
+		 *
+		 * \note The group must span less than half the box in each periodic 
+		 *       dimension for the unwrapping to be unambiguous.
+		 */
+		void GetGroupReference(const Label& indices, double* slot) const
+		{
+			std::fill(slot, slot + 4, 0.);
+			if(indices.size())
 			{
-				auto& p = positions_[idx];
-				pos.push_back(p[0]);
-				pos.push_back(p[1]);
-				pos.push_back(p[2]);
-				mass.push_back(masses_[idx]);
+				auto& p = positions_[indices[0]];
+				slot[0] = 1.;
+				slot[1] = p[0];
+				slot[2] = p[1];
+				slot[3] = p[2];
 			}
+		}
 
-			// Re-size receiving vectors. 
-			gpos.resize(pdispls.back(), 0);
-			gmass.resize(mdispls.back(), 0);
-
-			// All-gather data.
-			MPI_Allgatherv(pos.data(), pos.size(), MPI_DOUBLE, gpos.data(), pcounts.data(), pdispls.data(), MPI_DOUBLE, comm_);
-			MPI_Allgatherv(mass.data(), mass.size(), MPI_DOUBLE, gmass.data(), mcounts.data(), mdispls.data(), MPI_DOUBLE, comm_);
+		//! Select the group unwrapping reference from the gathered slots.
+		/*!
+		 * \param slots Slots of all ranks, gathered in rank order.
+		 * \return Reference position. Zero if the group is empty.
+		 */
+		Vector3 SelectGroupReference(const double* slots) const
+		{
+			for(int i = 0; i < comm_.size(); ++i)
+			{
+				auto* s = slots + 4*i;
+				if(s[0] != 0)
+					return {s[1], s[2], s[3]};
+			}
 
-			// Loop through atoms and compute mass weighted sum. 
-			// We march linearly through list and find nearest image
-			// to each successive particle to properly unwrap object.
-			Vector3 ppos = {gpos[0], gpos[1], gpos[2]}; // Previous unwrapped position.
-			Vector3 cpos = ppos;
-			Vector3 xcm = gmass[0]*cpos;
+			return Vector3::Zero();
+		}
 
-			for(size_t i = 1, j = 3; i < gmass.size(); ++i, j += 3)
+		//! Compute the local mass weighted displacements of a group.
+		/*!
+		 * \param indices Local indices of the atoms of interest.
+		 * \param ref Unwrapping reference.
+		 * \param sums Four doubles receiving the mass weighted minimum image 
+		 *        displacement from \c ref (0-2) and the mass (3).
+		 */
+		void GetGroupSums(const Label& indices, const Vector3& ref, double* sums) const
+		{
+			Vector3 dx = Vector3::Zero();
+			double m = 0;
+			for(auto& idx : indices)
 			{
-				cpos = {gpos[j], gpos[j+1], gpos[j+2]};
-				cpos = ApplyMinimumImage(cpos - ppos) + ppos;
-				xcm += gmass[i]*cpos;
-				ppos = cpos;
+				dx += masses_[idx]*ApplyMinimumImage(positions_[idx] - ref);
+				m += masses_[idx];
 			}
 
-			return xcm/mtot;
+			sums[0] = dx[0];
+			sums[1] = dx[1];
+			sums[2] = dx[2];
+			sums[3] = m;
 		}
 
 		//! Access the atom IDs
@@ -545,10 +667,66 @@ namespace SSAGES
 		/*! \copydoc Snapshot::GetAtomIDs() const */
 		Label& GetAtomIDs()
 		{
-			changed_ = true;
+			Modify(AtomIDs);
+			idsdirty_ = true;
 			return atomids_;
 		}
 
+		//! Update the atom ID to local index map.
+		/*!
+		 * The map is updated incrementally: only the slots whose atom ID 
+		 * differs from the last update are touched, so a step without 
+		 * atom migration or re-sorting costs a single linear comparison.
+		 * Hooks should call this after refreshing the atom IDs in 
+		 * SyncToSnapshot. Otherwise it is called lazily on the next lookup.
+		 */
+		void UpdateIndexMap() const
+		{
+			if(!idsdirty_)
+				return;
+
+			auto nold = mappedids_.size();
+			auto nnew = atomids_.size();
+
+			// Start from scratch if most of the list changed size.
+			if(nold == 0 || nnew > 2*nold || 2*nnew < nold)
+			{
+				idmap_.clear();
+				idmap_.reserve(nnew);
+				for(size_t i = 0; i < nnew; ++i)
+					idmap_.emplace(atomids_[i], i);
+				++mapversion_;
+			}
+			else
+			{
+				auto ncommon = std::min(nold, nnew);
+				auto changed = nold != nnew;
+				
+				// Drop IDs that were in the truncated tail.
+				for(size_t i = ncommon; i < nold; ++i)
+					EraseMapping(mappedids_[i], i);
+
+				for(size_t i = 0; i < ncommon; ++i)
+				{
+					if(mappedids_[i] == atomids_[i])
+						continue;
+
+					EraseMapping(mappedids_[i], i);
+					idmap_[atomids_[i]] = i;
+					changed = true;
+				}
+
+				for(size_t i = ncommon; i < nnew; ++i)
+					idmap_[atomids_[i]] = i;
+
+				if(changed)
+					++mapversion_;
+			}
+
+			mappedids_ = atomids_;
+			idsdirty_ = false;
+		}
+
 		//! Gets the local atom index corresponding to an atom ID.
 		/*!
 		 * \param id Atom ID.
@@ -556,12 +734,13 @@ namespace SSAGES
 		 */
 		int GetLocalIndex(int id) const
 		{
+			UpdateIndexMap();
 
-			auto s = std::find(atomids_.begin(), atomids_.end(), id);
-			if(s == atomids_.end())
+			auto s = idmap_.find(id);
+			if(s == idmap_.end())
 				return -1;
 			else
-				return s - atomids_.begin();
+				return s->second;
 		}
 
 		//! Gets the local atom indices corresponding to atom IDs in the 
@@ -574,14 +753,130 @@ namespace SSAGES
 		 */
 		void GetLocalIndices(const Label& ids, Label* indices) const
 		{
+			UpdateIndexMap();
+
 			for(auto& id : ids)
 			{
-				auto idx = GetLocalIndex(id);
-				if(idx != -1)
-					indices->push_back(idx);
+				auto s = idmap_.find(id);
+				if(s != idmap_.end())
+					indices->push_back(s->second);
 			}
 		}
 
+		//! Get the version of the atom ID to local index map.
+		/*!
+		 * \return Counter which changes whenever local indices may have 
+		 *         changed, e.g. through atom migration or re-sorting.
+		 *
+		 * Local index lists obtained from GetLocalIndices() or 
+		 * GetGroupIndices() remain valid as long as the version is unchanged.
+		 */
+		size_t GetIndexMapVersion() const
+		{
+			UpdateIndexMap();
+			return mapversion_;
+		}
+
+		//! Gets the local indices of several groups of atoms.
+		/*!
+		 * \param groups Atom IDs of each group.
+		 * \param indices Local atom indices of each group, set on return.
+		 * \param anchors Local index of the first atom of each group, or -1 
+		 *        if it is not on this processor. Set on return.
+		 *
+		 * The anchors are used by GetAnchorReference() to pick an unwrapping 
+		 * reference that all ranks agree on without gathering.
+		 */
+		void GetGroupIndices(const std::vector<Label>& groups, std::vector<Label>* indices, Label* anchors) const
+		{
+			indices->resize(groups.size());
+			anchors->resize(groups.size());
+			for(size_t i = 0; i < groups.size(); ++i)
+			{
+				(*indices)[i].clear();
+				GetLocalIndices(groups[i], &(*indices)[i]);
+				(*anchors)[i] = groups[i].size() ? GetLocalIndex(groups[i][0]) : -1;
+			}
+		}
+
+		//! Get the local contribution to a group unwrapping reference.
+		/*!
+		 * \param anchor Local index of the anchor atom, or -1.
+		 * \param slot Four doubles receiving a flag and the position of the 
+		 *        anchor atom. All zero if it is not on this processor.
+		 *
+		 * Summing the slots over all ranks yields the anchor position, 
+		 * which serves as the reference for GetGroupSums(). Unlike 
+		 * GetGroupReference() this needs a reduction of four doubles per 
+		 * group instead of a gather, so it batches well over many groups.
+		 */
+		void GetAnchorReference(int anchor, double* slot) const
+		{
+			std::fill(slot, slot + 4, 0.);
+			if(anchor >= 0)
+			{
+				auto& p = positions_[anchor];
+				slot[0] = 1.;
+				slot[1] = p[0];
+				slot[2] = p[1];
+				slot[3] = p[2];
+			}
+		}
+
+		//! Get a group unwrapping reference from reduced anchor slots.
+		/*!
+		 * \param slot Anchor slots summed over all ranks.
+		 * \return Reference position. Zero if no rank holds the anchor.
+		 */
+		static Vector3 SelectAnchorReference(const double* slot)
+		{
+			if(slot[0] == 0)
+				return Vector3::Zero();
+			
+			return Vector3{slot[1], slot[2], slot[3]}/slot[0];
+		}
+
+		//! Compute the centers of mass of several groups of atoms.
+		/*!
+		 * \param indices Local indices of the atoms of each group.
+		 * \param anchors Local anchor index of each group, see GetGroupIndices().
+		 * \param masses Optional container receiving the total mass of each group.
+		 * \return Center of mass of each group.
+		 *
+		 * All groups share one reduction for the unwrapping references and 
+		 * one for the mass weighted displacements, independent of the 
+		 * number of groups. Groups without mass are placed at their reference.
+		 */
+		std::vector<Vector3> CentersOfMass(const std::vector<Label>& indices, const Label& anchors, std::vector<double>* masses = nullptr) const
+		{
+			auto ngroups = indices.size();
+			std::vector<double> buf(4*ngroups);
+			for(size_t i = 0; i < ngroups; ++i)
+				GetAnchorReference(anchors[i], &buf[4*i]);
+			MPI_Allreduce(MPI_IN_PLACE, buf.data(), buf.size(), MPI_DOUBLE, MPI_SUM, comm_);
+
+			std::vector<Vector3> coms(ngroups);
+			for(size_t i = 0; i < ngroups; ++i)
+			{
+				coms[i] = SelectAnchorReference(&buf[4*i]);
+				GetGroupSums(indices[i], coms[i], &buf[4*i]);
+			}
+			MPI_Allreduce(MPI_IN_PLACE, buf.data(), buf.size(), MPI_DOUBLE, MPI_SUM, comm_);
+
+			if(masses)
+				masses->resize(ngroups);
+			for(size_t i = 0; i < ngroups; ++i)
+			{
+				auto* sums = &buf[4*i];
+				if(sums[3] != 0)
+					coms[i] += Vector3{sums[0], sums[1], sums[2]}/sums[3];
+				if(masses)
+					(*masses)[i] = sums[3];
+			}
+
+			return coms;
+		}
+
 		//! Access the atom charges
 		/*!
 		 * \return List of atom charges
@@ -591,7 +886,7 @@ namespace SSAGES
 		/*! \copydoc Snapshot::GetCharges() const */
 		std::vector<double>& GetCharges()
 		{
-			changed_ = true;
+			Modify(Charges);
 			return charges_;
 		}
 		
@@ -604,7 +899,7 @@ namespace SSAGES
 		/*! \copydoc Snapshot::GetAtomTypes() const */
 		Label& GetAtomTypes() 
 		{
-			changed_ = true; 
+			Modify(AtomTypes); 
 			return types_; 
 		}
 
@@ -617,7 +912,7 @@ namespace SSAGES
 		/*! \copydoc Snapshot::GetSigmas() const */
 		std::vector<std::vector<double>>& GetSigmas() 
 		{
-			changed_ = true; 
+			Modify(Sigmas); 
 			return sigma_;
 		}
 
@@ -630,7 +925,7 @@ namespace SSAGES
 		/*! \copydoc Snapshot::GetSnapshotID() const */
 		std::string& GetSnapshotID() 
 		{
-			changed_ = true; 
+			Modify(State); 
 			return ID_; 
 		}
 
@@ -638,13 +933,60 @@ namespace SSAGES
 		/*!
 		 * \return \c True if Snapshot was modified, else return \c False
 		 */
-		bool HasChanged() const { return changed_; }
+		bool HasChanged() const { return dirty_ != 0; }
+
+		//! Query if any of the given fields was modified
+		/*!
+		 * \param fields Bitmask of Snapshot::Field values.
+		 * \return \c True if any of the fields was modified.
+		 *
+		 * Hooks use this to push only the modified fields back to the 
+		 * engine.
+		 */
+		bool HasChanged(unsigned fields) const { return (dirty_ & fields) != 0; }
 
 		//! Set the "changed" flag of the Snapshot
 		/*!
-		 * \param state State to which the "changed" flag is set
+		 * \param state State to which the "changed" flag of all fields is set
+		 */
+		void Changed(bool state)
+		{
+			dirty_ = state ? static_cast<unsigned>(AllFields) : 0u;
+			if(state)
+				++revision_;
+		}
+
+		//! Get the revision of the snapshot data.
+		/*!
+		 * \return Counter which changes whenever a field is flagged as 
+		 *         modified, e.g. through a non-const accessor.
+		 *
+		 * Unlike HasChanged() the revision is not reset by the hook, so 
+		 * results derived from the snapshot can tell whether they are 
+		 * still current.
+		 */
+		size_t GetRevision() const { return revision_; }
+
+		//! Attach a cache for intermediates shared between CVs.
+		/*!
+		 * \param cache Cache, owned by the caller. Null to detach.
+		 */
+		void SetCache(ExpressionCache* cache) { cache_ = cache; }
+
+		//! Get the cache for intermediates shared between CVs.
+		/*!
+		 * \return Attached cache, or null if there is none.
+		 */
+		ExpressionCache* GetCache() const { return cache_; }
+
+		//! Flag fields of the Snapshot as modified
+		/*!
+		 * \param fields Bitmask of Snapshot::Field values.
+		 *
+		 * Needed only if data was modified without a non-const accessor, 
+		 * e.g. through a pointer kept from an earlier step.
 		 */
-		void Changed(bool state) { changed_ = state; }
+		void MarkChanged(unsigned fields) { Modify(fields); }
 
 		//! Return the serialized positions across all local cores
 		std::vector<double> SerializePositions()
@@ -0,0 +1,195 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <mpi.h>
+#include <boost/mpi.hpp>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Fused communication buffer for a round of small collectives.
+	/*!
+	 * Clients reserve segments of doubles, fill in their local
+	 * contributions and read back the results once Execute() has been
+	 * called. All segments reserved between two calls to Execute() are
+	 * combined into a single MPI_Allreduce.
+	 *
+	 * Two kinds of segments are supported:
+	 *
+	 * * Sum segments are added up element-wise across ranks.
+	 * * Gather segments provide one slot per rank. Each rank writes its
+	 *   own slot and the other slots stay zero, so the sum yields the
+	 *   gathered data on every rank.
+	 *
+	 * Segment handles are only valid for the round they were reserved in.
+	 * Results of the previous round remain readable while the next round
+	 * is being set up.
+	 *
+	 * \note Every rank must reserve the same segments in the same order.
+	 */
+	class CommPlan
+	{
+	private:
+		//! Segment of the fused buffer.
+		struct Segment
+		{
+			size_t offset; //!< Start of segment.
+			size_t size; //!< Number of doubles per slot.
+			bool gather; //!< \c TRUE if segment has one slot per rank.
+		};
+
+		//! Communicator.
+		boost::mpi::communicator comm_;
+
+		//! Segments and local contributions of the pending round.
+		std::vector<Segment> segments_;
+		std::vector<double> send_;
+
+		//! Segments and results of the last executed round.
+		std::vector<Segment> rsegments_;
+		std::vector<double> recv_;
+
+		//! Number of executed collectives.
+		size_t ncalls_;
+
+		//! Append a zeroed segment.
+		size_t Reserve(size_t n, bool gather)
+		{
+			auto len = gather ? n*comm_.size() : n;
+			segments_.push_back({send_.size(), n, gather});
+			send_.resize(send_.size() + len, 0);
+			return segments_.size() - 1;
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param comm Communicator over which data is combined.
+		 */
+		CommPlan(const boost::mpi::communicator& comm) :
+		comm_(comm), segments_(), send_(), rsegments_(), recv_(), ncalls_(0)
+		{}
+
+		//! Reserve a segment which is summed over all ranks.
+		/*!
+		 * \param n Number of doubles.
+		 * \return Handle of the segment.
+		 */
+		size_t ReserveSum(size_t n)
+		{
+			return Reserve(n, false);
+		}
+
+		//! Reserve a segment which is gathered from all ranks.
+		/*!
+		 * \param n Number of doubles contributed by each rank.
+		 * \return Handle of the segment.
+		 */
+		size_t ReserveGather(size_t n)
+		{
+			return Reserve(n, true);
+		}
+
+		//! Access local contribution to a pending segment.
+		/*!
+		 * \param handle Segment handle.
+		 * \return Pointer to the local slot of the segment.
+		 */
+		double* Local(size_t handle)
+		{
+			auto& s = segments_[handle];
+			return send_.data() + s.offset + (s.gather ? s.size*comm_.rank() : 0);
+		}
+
+		//! Access the combined data of an executed segment.
+		/*!
+		 * \param handle Segment handle from the last executed round.
+		 * \return Pointer to the segment. Gather segments hold the slot of
+		 *         rank r at offset r*n.
+		 */
+		const double* Result(size_t handle) const
+		{
+			return recv_.data() + rsegments_[handle].offset;
+		}
+
+		//! Combine all pending segments in a single collective.
+		/*!
+		 * The pending segments become the results and a new round begins.
+		 * Nothing is communicated if no segment was reserved.
+		 */
+		void Execute()
+		{
+			recv_.resize(send_.size());
+			if(send_.size())
+			{
+				MPI_Allreduce(send_.data(), recv_.data(), send_.size(), MPI_DOUBLE, MPI_SUM, comm_);
+				++ncalls_;
+			}
+
+			rsegments_.swap(segments_);
+			segments_.clear();
+			send_.clear();
+		}
+
+		//! Combine the pending segments of several plans in a single collective.
+		/*!
+		 * \param plans Plans over the same communicator.
+		 *
+		 * Behaves as if every plan called Execute(), but communicates only
+		 * once. This allows independent clients to fill separate plans
+		 * concurrently.
+		 */
+		static void ExecuteAll(const std::vector<CommPlan*>& plans)
+		{
+			if(plans.empty())
+				return;
+
+			std::vector<double> send, recv;
+			for(auto* p : plans)
+				send.insert(send.end(), p->send_.begin(), p->send_.end());
+
+			recv.resize(send.size());
+			if(send.size())
+				MPI_Allreduce(send.data(), recv.data(), send.size(), MPI_DOUBLE, MPI_SUM, plans[0]->comm_);
+
+			size_t offset = 0;
+			for(auto* p : plans)
+			{
+				auto n = p->send_.size();
+				p->recv_.assign(recv.begin() + offset, recv.begin() + offset + n);
+				offset += n;
+
+				if(send.size())
+					++p->ncalls_;
+
+				p->rsegments_.swap(p->segments_);
+				p->segments_.clear();
+				p->send_.clear();
+			}
+		}
+
+		//! Get the number of collectives executed so far.
+		size_t GetCalls() const { return ncalls_; }
+
+		//! Get the communicator.
+		const boost::mpi::communicator& GetCommunicator() const { return comm_; }
+	};
+}
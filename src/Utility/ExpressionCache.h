@@ -0,0 +1,272 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "../Snapshot.h"
+#include "CommPlan.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Per-step cache of intermediates shared between CVs.
+	/*!
+	 * CVs over overlapping atom groups often need the same local index
+	 * lists and centers of mass. The cache holds one record per atom group,
+	 * keyed by the atom IDs, so each quantity is computed once per step
+	 * no matter how many CVs request it.
+	 *
+	 * Local index lists are kept until the snapshot index map changes.
+	 * Centers of mass are valid for one snapshot iteration and revision
+	 * (see Snapshot::GetRevision()) and are computed in CommPlan rounds:
+	 * a group requested while setting up round \c r is ready after round
+	 * \c r+1, i.e. two rounds later, like GroupCenterOfMass. Whoever runs
+	 * the rounds calls Prepare() before and Complete() after each
+	 * collective. All groups requested in the same round share their
+	 * segments.
+	 *
+	 * Requests may be made concurrently. Prepare() and Complete() must be
+	 * called by a single thread, in the same way on all ranks.
+	 */
+	class ExpressionCache
+	{
+	public:
+		//! Cached quantities of an atom group.
+		struct Group
+		{
+			//! Local indices of the group atoms.
+			Label indices;
+
+			//! Local index of the first group atom, or -1.
+			int anchor;
+
+			//! Center of mass, once computed.
+			Vector3 com;
+
+			//! Total mass, once computed.
+			double mass;
+
+			//! Default constructor.
+			Group() :
+			indices(), anchor(-1), com(Vector3::Zero()), mass(0), version(0),
+			mapped(false), iteration(0), revision(0), state(Idle)
+			{}
+
+		private:
+			friend class ExpressionCache;
+
+			//! Progress of the center of mass computation.
+			enum State { Idle, Requested, InFlight, Ready };
+
+			size_t version; //!< Index map version of the indices.
+			bool mapped; //!< \c TRUE once indices were looked up.
+			int iteration; //!< Iteration of the center of mass.
+			size_t revision; //!< Snapshot revision of the center of mass.
+			State state; //!< Center of mass state.
+		};
+
+	private:
+		//! Groups requested together, sharing their segments.
+		struct Batch
+		{
+			std::vector<Group*> groups; //!< Groups of the batch.
+			int phase; //!< 0: references pending, 1: set up sums, 2: sums pending.
+			size_t handle; //!< Pending CommPlan segment.
+		};
+
+		//! Records by atom IDs.
+		std::map<Label, Group> groups_;
+
+		//! Batches in flight.
+		std::vector<Batch> batches_;
+
+		//! Guards requests.
+		std::mutex mutex_;
+
+		size_t hits_; //!< Number of requests served from the cache.
+		size_t misses_; //!< Number of requests computed.
+
+		//! Look up the record of a group and refresh its indices.
+		Group& Lookup(const Snapshot& snapshot, const Label& ids)
+		{
+			auto& group = groups_[ids];
+			auto version = snapshot.GetIndexMapVersion();
+			if(!group.mapped || group.version != version)
+			{
+				group.indices.clear();
+				snapshot.GetLocalIndices(ids, &group.indices);
+				group.anchor = ids.size() ? snapshot.GetLocalIndex(ids[0]) : -1;
+				group.version = version;
+				group.mapped = true;
+			}
+			return group;
+		}
+
+	public:
+		//! Constructor.
+		ExpressionCache() :
+		groups_(), batches_(), mutex_(), hits_(0), misses_(0)
+		{}
+
+		//! Get the local indices of a group of atoms.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param ids Atom IDs of the group.
+		 * \return Local indices, valid until the index map changes.
+		 */
+		const Label& GetIndices(const Snapshot& snapshot, const Label& ids)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return Lookup(snapshot, ids).indices;
+		}
+
+		//! Request the center of mass of a group of atoms.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param ids Atom IDs of the group.
+		 * \return Group record. Its center of mass and mass are valid
+		 *         after the next two rounds.
+		 *
+		 * Groups whose center of mass is already known or under way for
+		 * the current snapshot are not computed again.
+		 */
+		const Group* RequestCenterOfMass(const Snapshot& snapshot, const Label& ids)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto& group = Lookup(snapshot, ids);
+			if(group.state != Group::Idle &&
+			   group.iteration == snapshot.GetIteration() &&
+			   group.revision == snapshot.GetRevision())
+			{
+				++hits_;
+				return &group;
+			}
+
+			++misses_;
+			group.iteration = snapshot.GetIteration();
+			group.revision = snapshot.GetRevision();
+			group.state = Group::Requested;
+			return &group;
+		}
+
+		//! Reserve the segments of the next round.
+		/*!
+		 * \param snapshot Current simulation snapshot.
+		 * \param plan Communication plan of the round.
+		 */
+		void Prepare(const Snapshot& snapshot, CommPlan& plan)
+		{
+			for(auto& batch : batches_)
+			{
+				if(batch.phase != 1)
+					continue;
+
+				auto n = batch.groups.size();
+				batch.handle = plan.ReserveSum(4*n);
+				auto* sums = plan.Local(batch.handle);
+				for(size_t i = 0; i < n; ++i)
+				{
+					auto& g = *batch.groups[i];
+					snapshot.GetGroupSums(g.indices, g.com, sums + 4*i);
+				}
+				batch.phase = 2;
+			}
+
+			// Groups are visited in key order, which is the same on all ranks.
+			Batch batch{{}, 0, 0};
+			for(auto& entry : groups_)
+			{
+				if(entry.second.state != Group::Requested)
+					continue;
+
+				entry.second.state = Group::InFlight;
+				batch.groups.push_back(&entry.second);
+			}
+
+			if(batch.groups.empty())
+				return;
+
+			auto n = batch.groups.size();
+			batch.handle = plan.ReserveSum(4*n);
+			auto* slots = plan.Local(batch.handle);
+			for(size_t i = 0; i < n; ++i)
+				snapshot.GetAnchorReference(batch.groups[i]->anchor, slots + 4*i);
+			batches_.push_back(batch);
+		}
+
+		//! Read back the results of a round.
+		/*!
+		 * \param plan Communication plan of the round, after execution.
+		 */
+		void Complete(const CommPlan& plan)
+		{
+			for(auto& batch : batches_)
+			{
+				if(batch.phase == 1)
+					continue;
+
+				auto* data = plan.Result(batch.handle);
+				for(size_t i = 0; i < batch.groups.size(); ++i, data += 4)
+				{
+					auto& g = *batch.groups[i];
+					if(batch.phase == 0)
+						g.com = Snapshot::SelectAnchorReference(data);
+					else
+					{
+						g.mass = data[3];
+						if(g.mass != 0)
+							g.com += Vector3{data[0], data[1], data[2]}/g.mass;
+						g.state = Group::Ready;
+					}
+				}
+				++batch.phase;
+			}
+
+			batches_.erase(
+				std::remove_if(batches_.begin(), batches_.end(),
+					[](const Batch& b) { return b.phase > 2; }),
+				batches_.end()
+			);
+		}
+
+		//! Discard all cached centers of mass.
+		/*!
+		 * Local index lists are kept, since they are tied to the index map.
+		 */
+		void Invalidate()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for(auto& entry : groups_)
+				entry.second.state = Group::Idle;
+			batches_.clear();
+		}
+
+		//! Check whether centers of mass are still being computed.
+		bool IsPending() const { return !batches_.empty(); }
+
+		//! Get the number of requests served from the cache.
+		size_t GetHits() const { return hits_; }
+
+		//! Get the number of requests which were computed.
+		size_t GetMisses() const { return misses_; }
+	};
+}
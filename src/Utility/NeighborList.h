@@ -0,0 +1,238 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "../Snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Verlet list of pairs between two sets of positions.
+	/*!
+	 * Pairs are found with a cell list built on the fractional coordinates
+	 * of the snapshot box, so triclinic boxes are supported. The list holds
+	 * all pairs within the cutoff plus a skin. It is only rebuilt once an
+	 * atom has moved by more than half the skin or the box has changed.
+	 * Without a skin the list is rebuilt on every update.
+	 *
+	 * The caller must keep the order of both sets fixed between updates
+	 * and call Invalidate() whenever the atoms in a set change.
+	 *
+	 * A single set may also be paired with itself. Each pair is then
+	 * listed once, with i < j.
+	 */
+	class NeighborList
+	{
+	private:
+		double cutoff_; //!< Interaction cutoff.
+		double skin_; //!< Verlet skin.
+
+		std::vector<std::pair<int, int>> pairs_; //!< Pairs (a, b).
+
+		std::vector<Vector3> refa_; //!< Positions of set A at last build.
+		std::vector<Vector3> refb_; //!< Positions of set B at last build.
+		Matrix3 H_; //!< Box at last build.
+		bool valid_; //!< \c TRUE if the list may be reused.
+		bool self_; //!< \c TRUE if the list pairs a set with itself.
+		size_t nbuilds_; //!< Number of builds.
+
+		std::vector<int> head_; //!< First atom of set B in each cell.
+		std::vector<int> next_; //!< Next atom of set B in the same cell.
+
+		//! Check whether any atom moved by more than half the skin.
+		bool Moved(const std::vector<Vector3>& x, const std::vector<Vector3>& ref) const
+		{
+			auto lim2 = 0.25*skin_*skin_;
+			for(size_t i = 0; i < x.size(); ++i)
+				if((x[i] - ref[i]).squaredNorm() > lim2)
+					return true;
+			return false;
+		}
+
+		//! Rebuild the pair list.
+		void Build(const Snapshot& snapshot, const std::vector<Vector3>& a, const std::vector<Vector3>& b, bool self)
+		{
+			const auto& H = snapshot.GetHMatrix();
+			const auto& origin = snapshot.GetOrigin();
+			const auto& periodic = snapshot.IsPeriodic();
+			const Matrix3 Hinv = H.inverse();
+			const auto rc = cutoff_ + skin_;
+
+			// Cells are at least rc wide perpendicular to each face. Their
+			// total number is limited to keep sparse sets cheap.
+			int nc[3];
+			auto vol = std::abs(H.determinant());
+			for(int d = 0; d < 3; ++d)
+			{
+				auto w = vol/H.col((d+1)%3).cross(H.col((d+2)%3)).norm();
+				nc[d] = std::max(1, static_cast<int>(w/rc));
+			}
+
+			double maxcells = std::max<double>(27, 2*b.size());
+			double ncells = double(nc[0])*nc[1]*nc[2];
+			if(ncells > maxcells)
+			{
+				auto f = std::cbrt(maxcells/ncells);
+				for(int d = 0; d < 3; ++d)
+					nc[d] = std::max(1, static_cast<int>(nc[d]*f));
+			}
+
+			// Cell coordinates. Atoms outside of non-periodic boundaries
+			// are placed in the outermost cells.
+			auto cell = [&](const Vector3& x, int* c)
+			{
+				Vector3 s = Hinv*(x - origin);
+				for(int d = 0; d < 3; ++d)
+				{
+					auto sd = periodic[d] ? s[d] - std::floor(s[d]) : s[d];
+					c[d] = std::min(nc[d] - 1, std::max(0, static_cast<int>(std::floor(sd*nc[d]))));
+				}
+			};
+
+			head_.assign(nc[0]*nc[1]*nc[2], -1);
+			next_.assign(b.size(), -1);
+			int c[3];
+			for(size_t j = 0; j < b.size(); ++j)
+			{
+				cell(b[j], c);
+				auto k = (c[0]*nc[1] + c[1])*nc[2] + c[2];
+				next_[j] = head_[k];
+				head_[k] = j;
+			}
+
+			// Neighboring cells along each dimension. Small dimensions
+			// are searched entirely to avoid visiting cells twice.
+			auto neighbors = [&](int d, int cd, std::vector<int>& list)
+			{
+				list.clear();
+				if(nc[d] < 3)
+				{
+					for(int k = 0; k < nc[d]; ++k)
+						list.push_back(k);
+					return;
+				}
+
+				for(int k = cd - 1; k <= cd + 1; ++k)
+				{
+					if(periodic[d])
+						list.push_back((k + nc[d]) % nc[d]);
+					else if(k >= 0 && k < nc[d])
+						list.push_back(k);
+				}
+			};
+
+			pairs_.clear();
+			std::vector<int> n0, n1, n2;
+			for(size_t i = 0; i < a.size(); ++i)
+			{
+				cell(a[i], c);
+				neighbors(0, c[0], n0);
+				neighbors(1, c[1], n1);
+				neighbors(2, c[2], n2);
+				for(auto& cx : n0)
+					for(auto& cy : n1)
+						for(auto& cz : n2)
+							for(int j = head_[(cx*nc[1] + cy)*nc[2] + cz]; j != -1; j = next_[j])
+							{
+								if(self && j <= static_cast<int>(i))
+									continue;
+
+								Vector3 rij = a[i] - b[j];
+								snapshot.ApplyMinimumImage(&rij);
+								if(rij.squaredNorm() <= rc*rc)
+									pairs_.emplace_back(i, j);
+							}
+			}
+
+			refa_ = a;
+			refb_ = b;
+			H_ = H;
+			valid_ = true;
+			self_ = self;
+			++nbuilds_;
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param cutoff Interaction cutoff.
+		 * \param skin Verlet skin added to the cutoff.
+		 */
+		NeighborList(double cutoff, double skin = 0) :
+		cutoff_(cutoff), skin_(skin), pairs_(), refa_(), refb_(),
+		H_(Matrix3::Zero()), valid_(false), self_(false), nbuilds_(0), head_(), next_()
+		{}
+
+		//! Force a rebuild on the next update.
+		void Invalidate() { valid_ = false; }
+
+		//! Update the pair list if necessary.
+		/*!
+		 * \param snapshot Snapshot providing the box.
+		 * \param a Positions of the first set.
+		 * \param b Positions of the second set.
+		 * \return \c TRUE if the list was rebuilt.
+		 */
+		bool Update(const Snapshot& snapshot, const std::vector<Vector3>& a, const std::vector<Vector3>& b)
+		{
+			if(valid_ && !self_ && skin_ > 0 &&
+			   a.size() == refa_.size() && b.size() == refb_.size() &&
+			   snapshot.GetHMatrix() == H_ && !Moved(a, refa_) && !Moved(b, refb_))
+				return false;
+
+			Build(snapshot, a, b, false);
+			return true;
+		}
+
+		//! Update the pairs within a single set if necessary.
+		/*!
+		 * \param snapshot Snapshot providing the box.
+		 * \param a Positions of the set.
+		 * \return \c TRUE if the list was rebuilt.
+		 */
+		bool Update(const Snapshot& snapshot, const std::vector<Vector3>& a)
+		{
+			if(valid_ && self_ && skin_ > 0 && a.size() == refa_.size() &&
+			   snapshot.GetHMatrix() == H_ && !Moved(a, refa_))
+				return false;
+
+			Build(snapshot, a, a, true);
+			return true;
+		}
+
+		//! Get the pairs within cutoff plus skin.
+		/*!
+		 * \return List of index pairs into the first and second set.
+		 */
+		const std::vector<std::pair<int, int>>& GetPairs() const { return pairs_; }
+
+		//! Get the interaction cutoff.
+		double GetCutoff() const { return cutoff_; }
+
+		//! Get the Verlet skin.
+		double GetSkin() const { return skin_; }
+
+		//! Get the number of times the list was built.
+		size_t GetBuilds() const { return nbuilds_; }
+	};
+}
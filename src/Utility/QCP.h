@@ -0,0 +1,161 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "../types.h"
+#include <Eigen/Eigenvalues>
+#include <cmath>
+
+namespace SSAGES
+{
+	//! Optimal superposition by the quaternion characteristic polynomial.
+	/*!
+	 * Implements the QCP method of Theobald, Acta Cryst. A61: 478-480,
+	 * 2005. Given the correlation matrix \f$S = \sum_i y_i x_i^T\f$ of two
+	 * centered structures, the largest eigenvalue of the 4x4 quaternion key
+	 * matrix is found by Newton iteration on its characteristic polynomial.
+	 * The minimum squared deviation is then
+	 * \f$\sum_i |x_i - U y_i|^2 = G_x + G_y - 2\lambda_{max}\f$, where
+	 * \f$G\f$ are the inner products of the structures.
+	 */
+	class QCP
+	{
+	private:
+		//! Build the quaternion key matrix.
+		static Eigen::Matrix4d KeyMatrix(const Matrix3& S)
+		{
+			Eigen::Matrix4d K;
+			K << S(0,0) + S(1,1) + S(2,2), S(1,2) - S(2,1), S(2,0) - S(0,2), S(0,1) - S(1,0),
+			     S(1,2) - S(2,1), S(0,0) - S(1,1) - S(2,2), S(0,1) + S(1,0), S(2,0) + S(0,2),
+			     S(2,0) - S(0,2), S(0,1) + S(1,0), -S(0,0) + S(1,1) - S(2,2), S(1,2) + S(2,1),
+			     S(0,1) - S(1,0), S(2,0) + S(0,2), S(1,2) + S(2,1), -S(0,0) - S(1,1) + S(2,2);
+			return K;
+		}
+
+		//! Check whether the largest eigenvalue is (nearly) degenerate.
+		/*!
+		 * The derivative of the characteristic polynomial is the product of
+		 * the gaps to the other eigenvalues, which all lie within 
+		 * \f$\pm\lambda\f$. Newton iteration stalls and the cofactors 
+		 * vanish as it goes to zero.
+		 */
+		static bool Degenerate(double c2, double c1, double lambda)
+		{
+			auto dp = (4.*lambda*lambda + 2.*c2)*lambda + c1;
+			return std::abs(dp) <= 1e-3*std::abs(lambda*lambda*lambda);
+		}
+
+	public:
+		//! Compute the largest eigenvalue of the key matrix.
+		/*!
+		 * \param S Correlation matrix of the centered structures.
+		 * \param E0 Half the sum of the inner products, an upper bound.
+		 * \return Largest eigenvalue.
+		 */
+		static double MaxEigenvalue(const Matrix3& S, double E0)
+		{
+			// Characteristic polynomial l^4 + c2 l^2 + c1 l + c0.
+			const auto c2 = -2.*S.squaredNorm();
+			const auto c1 = -8.*S.determinant();
+			const auto c0 = KeyMatrix(S).determinant();
+
+			// Newton iteration converges from above onto the largest root.
+			auto lambda = E0;
+			for(int i = 0; i < 50; ++i)
+			{
+				const auto l2 = lambda*lambda;
+				const auto p = (l2 + c2)*l2 + c1*lambda + c0;
+				const auto dp = (4.*l2 + 2.*c2)*lambda + c1;
+				if(dp == 0)
+					break;
+
+				const auto delta = p/dp;
+				lambda -= delta;
+				if(std::abs(delta) <= 1e-11*std::abs(lambda))
+					break;
+			}
+
+			// Multiple roots are limited by roundoff.
+			if(Degenerate(c2, c1, lambda))
+			{
+				Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> es(KeyMatrix(S), Eigen::EigenvaluesOnly);
+				lambda = es.eigenvalues()[3];
+			}
+
+			return lambda;
+		}
+
+		//! Compute the optimal rotation.
+		/*!
+		 * \param S Correlation matrix of the centered structures.
+		 * \param lambda Largest eigenvalue of the key matrix.
+		 * \return Rotation U minimizing \f$\sum_i |x_i - U y_i|^2\f$.
+		 *
+		 * The quaternion is taken from the cofactors of the shifted key
+		 * matrix. Degenerate cases fall back to a full eigensolver.
+		 */
+		static Matrix3 Rotation(const Matrix3& S, double lambda)
+		{
+			Eigen::Matrix4d K = KeyMatrix(S);
+			Eigen::Matrix4d B = K - lambda*Eigen::Matrix4d::Identity();
+
+			// Any non-vanishing row of the adjugate is the eigenvector.
+			Eigen::Vector4d q = Eigen::Vector4d::Zero();
+			auto degenerate = Degenerate(-2.*S.squaredNorm(), -8.*S.determinant(), lambda);
+			for(int r = 0; r < 4 && !degenerate; ++r)
+			{
+				Eigen::Vector4d c;
+				for(int j = 0; j < 4; ++j)
+				{
+					Matrix3 minor;
+					for(int a = 0, ia = 0; a < 4; ++a)
+					{
+						if(a == r) continue;
+						for(int b = 0, ib = 0; b < 4; ++b)
+						{
+							if(b == j) continue;
+							minor(ia, ib++) = B(a, b);
+						}
+						++ia;
+					}
+					c[j] = ((r + j) % 2 ? -1. : 1.)*minor.determinant();
+				}
+
+				if(c.squaredNorm() > q.squaredNorm())
+					q = c;
+			}
+
+			if(degenerate)
+			{
+				Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> es(K);
+				q = es.eigenvectors().col(3);
+			}
+
+			q.normalize();
+			const auto q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+
+			Matrix3 U;
+			U << q0*q0 + q1*q1 - q2*q2 - q3*q3, 2.*(q1*q2 - q0*q3), 2.*(q1*q3 + q0*q2),
+			     2.*(q1*q2 + q0*q3), q0*q0 - q1*q1 + q2*q2 - q3*q3, 2.*(q2*q3 - q0*q1),
+			     2.*(q1*q3 - q0*q2), 2.*(q2*q3 + q0*q1), q0*q0 - q1*q1 - q2*q2 + q3*q3;
+			return U;
+		}
+	};
+}
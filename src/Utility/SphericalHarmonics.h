@@ -0,0 +1,193 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Real spherical harmonics of one degree, evaluated in batches.
+	/*!
+	 * Computes the 2l+1 orthonormal real spherical harmonics \f$ Y_{lm} \f$
+	 * of unit vectors through the real solid harmonics
+	 * \f$ S_{lm}(\mathbf{r}) = r^l Y_{lm}(\hat{\mathbf{r}}) \f$, which are
+	 * polynomials in x, y and z. This avoids angles and is well defined at
+	 * the poles. Rotational invariants such as \f$ \sum_m Y_{lm}^2 \f$ are
+	 * the same as for the complex harmonics.
+	 *
+	 * Component 0 is m = 0. Components 2m-1 and 2m hold the cosine and
+	 * sine parts of order m. Batches are stored component by component,
+	 * so the loops run over contiguous arrays of vectors and vectorize.
+	 */
+	class SphericalHarmonics
+	{
+	private:
+		int l_; //!< Degree.
+
+		//! Coefficients of the z polynomial of each order, highest power first.
+		std::vector<std::vector<double>> coeffs_;
+
+		//! Normalization of each order.
+		std::vector<double> norms_;
+
+		std::vector<double> A_, B_, A1_, B1_; //!< Work arrays.
+
+		//! Factorial as a double.
+		static double Factorial(int n)
+		{
+			double f = 1;
+			for(int i = 2; i <= n; ++i)
+				f *= i;
+			return f;
+		}
+
+		//! Binomial coefficient as a double.
+		static double Binomial(int n, int k)
+		{
+			return Factorial(n)/(Factorial(k)*Factorial(n - k));
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param l Degree.
+		 */
+		SphericalHarmonics(int l) :
+		l_(l), coeffs_(l + 1), norms_(l + 1), A_(), B_(), A1_(), B1_()
+		{
+			const double pi = std::acos(-1.);
+			for(int m = 0; m <= l; ++m)
+			{
+				auto scale = std::sqrt(Factorial(l - m)/Factorial(l + m))/std::pow(2., l);
+				for(int k = 0; 2*k <= l - m; ++k)
+				{
+					auto c = scale*Binomial(l, k)*Binomial(2*l - 2*k, l)*
+					         Factorial(l - 2*k)/Factorial(l - 2*k - m);
+					coeffs_[m].push_back(k % 2 ? -c : c);
+				}
+				norms_[m] = std::sqrt((2*l + 1)/((m ? 2. : 4.)*pi));
+			}
+		}
+
+		//! Get the degree.
+		int GetDegree() const { return l_; }
+
+		//! Get the number of components.
+		int GetSize() const { return 2*l_ + 1; }
+
+		//! Evaluate the harmonics of a batch of unit vectors.
+		/*!
+		 * \param n Number of vectors.
+		 * \param x,y,z Components of the unit vectors.
+		 * \param Y Harmonics, n values per component.
+		 * \param dx,dy,dz Gradients with respect to the vector, n values
+		 *        per component, or null to skip them.
+		 *
+		 * The gradients are those of \f$ Y_{lm}(\mathbf{r}/r) \f$ at
+		 * r = 1. Divide by r for other lengths.
+		 */
+		void Evaluate(size_t n, const double* x, const double* y, const double* z,
+		              double* Y, double* dx = nullptr, double* dy = nullptr, double* dz = nullptr)
+		{
+			// A_m + i B_m = (x + iy)^m.
+			A_.assign(n, 1.);
+			B_.assign(n, 0.);
+			A1_.assign(n, 0.);
+			B1_.assign(n, 0.);
+			bool grad = dx != nullptr;
+
+			for(int m = 0; m <= l_; ++m)
+			{
+				if(m > 0)
+				{
+					A1_.swap(A_);
+					B1_.swap(B_);
+					for(size_t p = 0; p < n; ++p)
+					{
+						A_[p] = x[p]*A1_[p] - y[p]*B1_[p];
+						B_[p] = x[p]*B1_[p] + y[p]*A1_[p];
+					}
+				}
+
+				// The z polynomial is Pi = sum_k c_k r^2k z^(t-2k) with t = l-m.
+				// On the unit sphere r = 1, but its derivative in r^2 
+				// remains. With s = z^2 all three sums are evaluated by 
+				// Horner's rule in s and multiplied by z if t is odd.
+				const auto* c = coeffs_[m].data();
+				const int nk = coeffs_[m].size();
+				const int t = l_ - m;
+				const bool odd = t % 2;
+				const auto N = norms_[m];
+				const auto mm = static_cast<double>(m);
+
+				double* Yc = Y + (m ? 2*m - 1 : 0)*n;
+				double* Ys = Y + 2*m*n;
+				for(size_t p = 0; p < n; ++p)
+				{
+					auto s = z[p]*z[p];
+					double Pi = 0, P1 = 0, Pz = 0;
+					for(int k = 0; k < nk; ++k)
+					{
+						Pi = Pi*s + c[k];
+						P1 = P1*s + k*c[k];
+						// Pz holds the derivative without its z factors.
+						if(odd || k < nk - 1)
+							Pz = Pz*s + (t - 2*k)*c[k];
+					}
+
+					auto zf = odd ? z[p] : 1.;
+					Pi *= zf;
+					P1 *= zf;
+					Pz *= odd ? 1. : z[p];
+
+					auto Sc = N*Pi*A_[p];
+					Yc[p] = Sc;
+					if(m)
+						Ys[p] = N*Pi*B_[p];
+
+					if(!grad)
+						continue;
+
+					// Gradient of the solid harmonic, projected onto the 
+					// tangent plane of the sphere.
+					auto gz = 2*z[p]*P1 + Pz;
+					auto gx = N*(2*x[p]*P1*A_[p] + Pi*mm*A1_[p]);
+					auto gy = N*(2*y[p]*P1*A_[p] - Pi*mm*B1_[p]);
+					gz *= N*A_[p];
+					dx[(Yc - Y) + p] = gx - l_*Sc*x[p];
+					dy[(Yc - Y) + p] = gy - l_*Sc*y[p];
+					dz[(Yc - Y) + p] = gz - l_*Sc*z[p];
+
+					if(m)
+					{
+						auto Ss = Ys[p];
+						gz = (2*z[p]*P1 + Pz)*N*B_[p];
+						gx = N*(2*x[p]*P1*B_[p] + Pi*mm*B1_[p]);
+						gy = N*(2*y[p]*P1*B_[p] + Pi*mm*A1_[p]);
+						dx[(Ys - Y) + p] = gx - l_*Ss*x[p];
+						dy[(Ys - Y) + p] = gy - l_*Ss*y[p];
+						dz[(Ys - Y) + p] = gz - l_*Ss*z[p];
+					}
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,163 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Fixed-size pool of threads for fork-join loops.
+	/*!
+	 * The calling thread takes part in every loop, so a pool of n threads
+	 * spawns n-1 workers. With a single thread all work runs serially on
+	 * the caller.
+	 *
+	 * \note Tasks must not call MPI. Collectives are funneled through the
+	 *       calling thread between loops.
+	 */
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> workers_; //!< Worker threads.
+		std::mutex mutex_; //!< Protects the loop state.
+		std::condition_variable start_; //!< Signals new tasks.
+		std::condition_variable done_; //!< Signals completion of a loop.
+
+		const std::function<void(size_t)>* task_; //!< Loop body.
+		size_t ntasks_; //!< Number of iterations.
+		size_t next_; //!< Next iteration to hand out.
+		size_t pending_; //!< Iterations not yet completed.
+		std::exception_ptr error_; //!< First exception thrown by a task.
+		bool stop_; //!< \c TRUE if workers should exit.
+
+		//! Run iterations of the current loop until none are left.
+		/*!
+		 * \param lock Lock on mutex_, held on entry and exit.
+		 */
+		void RunTasks(std::unique_lock<std::mutex>& lock)
+		{
+			while(next_ < ntasks_)
+			{
+				auto i = next_++;
+				auto* task = task_;
+				lock.unlock();
+
+				std::exception_ptr error;
+				try
+				{
+					(*task)(i);
+				}
+				catch(...)
+				{
+					error = std::current_exception();
+				}
+
+				lock.lock();
+				if(error && !error_)
+					error_ = error;
+				if(--pending_ == 0)
+					done_.notify_all();
+			}
+		}
+
+		//! Worker thread loop.
+		void Work()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while(true)
+			{
+				start_.wait(lock, [this]{ return stop_ || next_ < ntasks_; });
+				if(stop_)
+					return;
+				RunTasks(lock);
+			}
+		}
+
+	public:
+		//! Constructor.
+		/*!
+		 * \param nthreads Total number of threads including the caller.
+		 */
+		explicit ThreadPool(size_t nthreads) :
+		workers_(), mutex_(), start_(), done_(), task_(nullptr), ntasks_(0),
+		next_(0), pending_(0), error_(), stop_(false)
+		{
+			for(size_t i = 1; i < nthreads; ++i)
+				workers_.emplace_back(&ThreadPool::Work, this);
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		//! Get the total number of threads including the caller.
+		size_t GetThreads() const { return workers_.size() + 1; }
+
+		//! Run a loop body for every index in [0, n) and wait for completion.
+		/*!
+		 * \param n Number of iterations.
+		 * \param f Loop body taking the iteration index.
+		 *
+		 * If any iteration throws, the first exception is rethrown once all
+		 * iterations have finished.
+		 */
+		void ParallelFor(size_t n, const std::function<void(size_t)>& f)
+		{
+			if(workers_.empty() || n < 2)
+			{
+				for(size_t i = 0; i < n; ++i)
+					f(i);
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			task_ = &f;
+			ntasks_ = n;
+			next_ = 0;
+			pending_ = n;
+			error_ = nullptr;
+			start_.notify_all();
+
+			RunTasks(lock);
+			done_.wait(lock, [this]{ return pending_ == 0; });
+
+			task_ = nullptr;
+			ntasks_ = next_ = 0;
+			if(error_)
+				std::rethrow_exception(error_);
+		}
+
+		//! Destructor.
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			start_.notify_all();
+			for(auto& w : workers_)
+				w.join();
+		}
+	};
+}
@@ -0,0 +1,191 @@
+/**
+ * This file is part of
+ * SSAGES - Suite for Advanced Generalized Ensemble Simulations
+ *
+ * Copyright 2016 Hythem Sidky <hsidky@nd.edu>
+ *
+ * SSAGES is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SSAGES is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SSAGES.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "../types.h"
+#include <algorithm>
+#include <vector>
+
+namespace SSAGES
+{
+	//! Per-atom array of three-dimensional vectors.
+	/*!
+	 * Behaves like a std::vector<Vector3> but can alternatively act as a
+	 * view over external memory holding contiguous xyz triplets of
+	 * doubles. This allows a Snapshot to operate directly on the arrays
+	 * of an MD engine without copying them.
+	 *
+	 * Operations which change the size of a view first detach it, i.e.
+	 * copy its contents into owned storage. Copies of an array always own
+	 * their storage.
+	 */
+	class Vector3Array
+	{
+	private:
+		std::vector<Vector3> data_; //!< Owned storage.
+		Vector3* ptr_; //!< Active storage.
+		size_t size_; //!< Number of elements.
+		bool mapped_; //!< \c TRUE if viewing external memory.
+
+		static_assert(sizeof(Vector3) == 3*sizeof(double),
+			"Vector3 must be layout compatible with double[3].");
+
+		//! Point to owned storage.
+		void Own()
+		{
+			ptr_ = data_.data();
+			size_ = data_.size();
+			mapped_ = false;
+		}
+
+	public:
+		//! Iterator type.
+		using iterator = Vector3*;
+
+		//! Const iterator type.
+		using const_iterator = const Vector3*;
+
+		//! Constructor.
+		/*!
+		 * \param n Number of elements.
+		 * \param v Initial value of the elements.
+		 */
+		explicit Vector3Array(size_t n = 0, const Vector3& v = Vector3{0,0,0}) :
+		data_(n, v), ptr_(nullptr), size_(0), mapped_(false)
+		{
+			Own();
+		}
+
+		//! Copy constructor.
+		Vector3Array(const Vector3Array& other) :
+		data_(other.begin(), other.end()), ptr_(nullptr), size_(0), mapped_(false)
+		{
+			Own();
+		}
+
+		//! Copy assignment.
+		Vector3Array& operator=(const Vector3Array& other)
+		{
+			if(this != &other)
+			{
+				data_.assign(other.begin(), other.end());
+				Own();
+			}
+			return *this;
+		}
+
+		//! View external memory.
+		/*!
+		 * \param xyz Pointer to n contiguous xyz triplets.
+		 * \param n Number of elements.
+		 *
+		 * The memory must outlive the view. Owned storage is retained and
+		 * becomes active again on Unmap().
+		 */
+		void Map(double* xyz, size_t n)
+		{
+			ptr_ = reinterpret_cast<Vector3*>(xyz);
+			size_ = n;
+			mapped_ = true;
+		}
+
+		//! Stop viewing external memory without reading from it.
+		/*!
+		 * The previously owned storage becomes active again.
+		 */
+		void Unmap()
+		{
+			Own();
+		}
+
+		//! Copy the contents of a view into owned storage.
+		void Detach()
+		{
+			if(!mapped_)
+				return;
+
+			data_.assign(ptr_, ptr_ + size_);
+			Own();
+		}
+
+		//! Check whether the array views external memory.
+		bool IsMapped() const { return mapped_; }
+
+		//! Change the number of elements.
+		/*!
+		 * \param n Number of elements.
+		 * \param v Value of appended elements.
+		 */
+		void resize(size_t n, const Vector3& v = Vector3{0,0,0})
+		{
+			if(mapped_ && n == size_)
+				return;
+
+			Detach();
+			data_.resize(n, v);
+			Own();
+		}
+
+		//! Append an element.
+		void push_back(const Vector3& v)
+		{
+			Detach();
+			data_.push_back(v);
+			Own();
+		}
+
+		//! Remove all elements.
+		void clear()
+		{
+			data_.clear();
+			Own();
+		}
+
+		//! Number of elements.
+		size_t size() const { return size_; }
+
+		//! Check whether the array is empty.
+		bool empty() const { return size_ == 0; }
+
+		//! Element access.
+		Vector3& operator[](size_t i) { return ptr_[i]; }
+
+		//! Const element access.
+		const Vector3& operator[](size_t i) const { return ptr_[i]; }
+
+		//! Pointer to the first element.
+		Vector3* data() { return ptr_; }
+
+		//! Const pointer to the first element.
+		const Vector3* data() const { return ptr_; }
+
+		//! Iterator to the first element.
+		iterator begin() { return ptr_; }
+
+		//! Iterator past the last element.
+		iterator end() { return ptr_ + size_; }
+
+		//! Const iterator to the first element.
+		const_iterator begin() const { return ptr_; }
+
+		//! Const iterator past the last element.
+		const_iterator end() const { return ptr_ + size_; }
+	};
+}
@@ -6,6 +6,7 @@
 #define protected public
 #include "../src/Methods/ABF.h"
 #include "../src/CVs/MockCV.h"
+#include "../src/ChainRule.h"
 
 using namespace SSAGES;
 
@@ -230,8 +231,13 @@ TEST_F(ABFTest,CV_outofboundscheck)
 	// The only bias force should be from CV restraints.
 	double bias = (CV3->GetValue()+1.5)*10;
 
-	for(size_t i = 0; i < Method->biases_[0].size() ; ++i)
-		EXPECT_NEAR(-Method->biases_[0][i], bias*CV3->GetGradient()[0][i], eps);
+	EXPECT_NEAR(Method->derivatives_[0], 0, eps);
+	EXPECT_NEAR(Method->derivatives_[1], 0, eps);
+	EXPECT_NEAR(Method->derivatives_[2], bias, eps);
+
+	ChainRule::Apply(cvlist, Method->GetBiasDerivatives(), snapshot1);
+	for(size_t i = 0; i < snapshot1->GetForces()[0].size() ; ++i)
+		EXPECT_NEAR(-snapshot1->GetForces()[0][i], bias*CV3->GetGradient()[0][i], eps);
 }
 TEST_F(ABFTest,MD_steps_inboundscheck)
 {
@@ -261,12 +267,13 @@ TEST_F(ABFTest,MD_steps_inboundscheck)
 	EXPECT_TRUE(Method->_F[2*dim+1] == -20.4);
 	EXPECT_TRUE(Method->_F[2*dim+2] == -32.8);
 
-	// Check that the biases are accurate
-	EXPECT_NEAR(Method->biases_[0][0], 1.6, eps);
-	EXPECT_NEAR(Method->biases_[0][1], 4.08, eps);
-	EXPECT_NEAR(Method->biases_[0][2], 6.56, eps);
+	// Check that the bias derivatives are accurate
+	EXPECT_NEAR(Method->derivatives_[0], -1.6, eps);
+	EXPECT_NEAR(Method->derivatives_[1], -4.08, eps);
+	EXPECT_NEAR(Method->derivatives_[2], -6.56, eps);
 
 	// Check that the biases added to forces correctly
+	ChainRule::Apply(cvlist, Method->GetBiasDerivatives(), snapshot3);
 	EXPECT_NEAR(snapshot3->GetForces()[0][0], 1.6, eps);
 	EXPECT_NEAR(snapshot3->GetForces()[0][1], 4.08, eps);
 	EXPECT_NEAR(snapshot3->GetForces()[0][2], 6.56, eps);
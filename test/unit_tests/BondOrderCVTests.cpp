@@ -0,0 +1,251 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include <random>
+#include "json/json.h"
+#include "../src/CVs/BondOrderCV.h"
+
+using namespace SSAGES;
+
+class BondOrderCVTest : public ::testing::Test
+{
+protected:
+	boost::mpi::communicator comm;
+	std::shared_ptr<Snapshot> snapshot;
+	Label ids_;
+
+	// Fill the box with a cubic lattice of 3x3x3 unit cells, with
+	// atoms spread over the processors.
+	void Lattice(const std::vector<Vector3>& basis, double a, double noise = 0)
+	{
+		Matrix3 H = 3.*a*Matrix3::Identity();
+		snapshot = std::make_shared<Snapshot>(comm, 0);
+		snapshot->SetHMatrix(H);
+
+		std::mt19937 gen(7);
+		std::uniform_real_distribution<double> d(-noise, noise);
+
+		auto& pos = snapshot->GetPositions();
+		auto& ids = snapshot->GetAtomIDs();
+		auto& masses = snapshot->GetMasses();
+		ids_.clear();
+		int id = 0;
+		for(int x = 0; x < 3; ++x)
+			for(int y = 0; y < 3; ++y)
+				for(int z = 0; z < 3; ++z)
+					for(auto& b : basis)
+					{
+						Vector3 r = a*(Vector3{double(x), double(y), double(z)} + b) + Vector3{d(gen), d(gen), d(gen)};
+						ids_.push_back(++id);
+						if(id % comm.size() != comm.rank())
+							continue;
+
+						pos.push_back(r);
+						ids.push_back(id);
+						masses.push_back(1.0);
+					}
+		snapshot->SetNumAtoms(ids.size());
+	}
+
+	// All atom IDs.
+	const Label& All() const
+	{
+		return ids_;
+	}
+
+	// Switching function counting the first shell of the lattices below.
+	static SwitchingFunction FirstShell()
+	{
+		return SwitchingFunction(0., 1.2, 6, 12, 1.3);
+	}
+
+	// All components of the CV.
+	static std::vector<size_t> AllComponents()
+	{
+		return {Q4, Q6, q4, q6, aq4, aq6, nsolid, density};
+	}
+
+	const std::vector<Vector3> fcc = {{0, 0, 0}, {0.5, 0.5, 0}, {0.5, 0, 0.5}, {0, 0.5, 0.5}};
+};
+
+TEST(SphericalHarmonicsTest, AdditionTheorem)
+{
+	std::mt19937 gen(3);
+	std::normal_distribution<double> d;
+	const double pi = std::acos(-1.);
+
+	for(int l : {2, 4, 6})
+	{
+		SphericalHarmonics sh(l);
+		auto M = sh.GetSize();
+		for(int k = 0; k < 5; ++k)
+		{
+			Vector3 r{d(gen), d(gen), d(gen)};
+			Vector3 u = r.normalized();
+			std::vector<double> Y(M), dx(M), dy(M), dz(M);
+			sh.Evaluate(1, &u[0], &u[1], &u[2], Y.data(), dx.data(), dy.data(), dz.data());
+
+			// Sum of squares does not depend on the direction.
+			double sum = 0;
+			for(auto& y : Y)
+				sum += y*y;
+			EXPECT_NEAR(sum, (2*l + 1)/(4*pi), 1e-12);
+
+			// Gradients of Y(r/|r|) against finite differences.
+			const double h = 1e-6;
+			for(int a = 0; a < 3; ++a)
+			{
+				Vector3 rp = r, rm = r;
+				rp[a] += h;
+				rm[a] -= h;
+				Vector3 up = rp.normalized(), um = rm.normalized();
+				std::vector<double> Yp(M), Ym(M);
+				sh.Evaluate(1, &up[0], &up[1], &up[2], Yp.data());
+				sh.Evaluate(1, &um[0], &um[1], &um[2], Ym.data());
+
+				const auto& dY = a == 0 ? dx : (a == 1 ? dy : dz);
+				for(int m = 0; m < M; ++m)
+					EXPECT_NEAR(dY[m]/r.norm(), (Yp[m] - Ym[m])/(2*h), 1e-7);
+			}
+		}
+	}
+}
+
+TEST_F(BondOrderCVTest, Lattices)
+{
+	// Face centered cubic.
+	Lattice(fcc, 1.5);
+	BondOrderCV cv(All(), FirstShell(), AllComponents());
+	cv.Initialize(*snapshot);
+	cv.Evaluate(*snapshot);
+
+	EXPECT_NEAR(cv.GetComponentValue(Q4), 0.190941, 1e-6);
+	EXPECT_NEAR(cv.GetComponentValue(Q6), 0.574524, 1e-6);
+	EXPECT_NEAR(cv.GetComponentValue(q6), 0.574524, 1e-6);
+	EXPECT_NEAR(cv.GetComponentValue(aq6), 0.574524, 1e-6);
+	EXPECT_NEAR(cv.GetValue(), cv.GetComponentValue(Q4), 1e-12);
+	EXPECT_GT(cv.GetComponentValue(nsolid), 0.99*108);
+
+	double df;
+	auto w = FirstShell().Evaluate(1.5/std::sqrt(2.), df);
+	EXPECT_NEAR(cv.GetComponentValue(density), 12*w, 1e-10);
+
+	// A perfect lattice is in equilibrium.
+	for(auto& g : cv.GetComponentGradient(Q6).values)
+		EXPECT_NEAR(g.norm(), 0, 1e-10);
+
+	// Simple cubic.
+	Lattice({{0, 0, 0}}, 1.0);
+	BondOrderCV sc(All(), FirstShell(), {Q4, Q6});
+	sc.Evaluate(*snapshot);
+	EXPECT_NEAR(sc.GetComponentValue(Q4), 0.763763, 1e-6);
+	EXPECT_NEAR(sc.GetComponentValue(Q6), 0.353553, 1e-6);
+}
+
+TEST_F(BondOrderCVTest, Gradients)
+{
+	if(comm.size() > 1)
+		return;
+
+	Lattice(fcc, 1.5, 0.1);
+	auto& pos = snapshot->GetPositions();
+	auto components = AllComponents();
+
+	// A wide bond threshold so that nsolid varies.
+	BondOrderCV cv(All(), FirstShell(), components, 0.2, 0.7, 0.1, 6.5, 1.0);
+	cv.Evaluate(*snapshot);
+
+	std::vector<std::vector<Vector3>> grads(components.size(), std::vector<Vector3>(pos.size(), Vector3::Zero()));
+	for(auto& c : components)
+	{
+		const auto& g = cv.GetComponentGradient(c);
+		for(size_t k = 0; k < g.size(); ++k)
+			grads[c][g.indices[k]] += g.values[k];
+	}
+
+	// Finite differences on a few atoms.
+	const double h = 1e-5;
+	for(int i : {0, 17, 53})
+		for(int a = 0; a < 3; ++a)
+		{
+			auto x = pos[i][a];
+			pos[i][a] = x + h;
+			cv.Evaluate(*snapshot);
+			std::vector<double> fp;
+			for(auto& c : components)
+				fp.push_back(cv.GetComponentValue(c));
+
+			pos[i][a] = x - h;
+			cv.Evaluate(*snapshot);
+			for(auto& c : components)
+				EXPECT_NEAR(grads[c][i][a], (fp[c] - cv.GetComponentValue(c))/(2*h), 1e-6)
+					<< "component " << cv.GetComponentName(c);
+			pos[i][a] = x;
+		}
+
+	// Box gradient against a uniform strain of box and atoms.
+	cv.Evaluate(*snapshot);
+	Matrix3 boxgrad = cv.GetComponentBoxGradient(Q6);
+	auto ref = pos;
+	auto H = snapshot->GetHMatrix();
+	Matrix3 E;
+	E << 0.3, 0.1, 0.0,
+	     0.2, -0.1, 0.4,
+	     0.0, 0.5, 0.2;
+
+	std::vector<double> f;
+	for(double s : {h, -h})
+	{
+		Matrix3 D = Matrix3::Identity() + s*E;
+		snapshot->SetHMatrix(D*H);
+		for(size_t i = 0; i < pos.size(); ++i)
+			pos[i] = D*ref[i];
+		cv.Evaluate(*snapshot);
+		f.push_back(cv.GetComponentValue(Q6));
+	}
+	EXPECT_NEAR((f[0] - f[1])/(2*h), (boxgrad.array()*E.array()).sum(), 1e-6);
+}
+
+TEST_F(BondOrderCVTest, BuildAndSerialize)
+{
+	Lattice(fcc, 1.5, 0.05);
+
+	Json::Value json;
+	Json::Reader reader;
+	reader.parse(R"({
+		"type" : "BondOrder",
+		"switching" : {"type" : "rational", "r0" : 1.2, "dmax" : 1.3},
+		"components" : ["q6", "nsolid"],
+		"skin" : 0.2
+	})", json);
+	for(auto& id : All())
+		json["atom_ids"].append(id);
+
+	std::unique_ptr<CollectiveVariable> cv(CollectiveVariable::BuildCV(json, "#/CVs"));
+	cv->Initialize(*snapshot);
+	cv->Evaluate(*snapshot);
+
+	BondOrderCV ref(All(), FirstShell(), {q6, nsolid}, 0.2);
+	ref.Evaluate(*snapshot);
+	EXPECT_NEAR(cv->GetValue(), ref.GetComponentValue(q6), 1e-10);
+
+	Json::Value out;
+	cv->Serialize(out);
+	EXPECT_EQ(out["component"].asString(), "q6");
+	EXPECT_EQ(out["atom_ids"].size(), 108u);
+
+	std::unique_ptr<CollectiveVariable> copy(CollectiveVariable::BuildCV(out, "#/CVs"));
+	copy->Evaluate(*snapshot);
+	EXPECT_NEAR(copy->GetValue(), cv->GetValue(), 1e-10);
+
+	json["component"] = "Q8";
+	EXPECT_THROW(CollectiveVariable::BuildCV(json, "#/CVs"), BuildException);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
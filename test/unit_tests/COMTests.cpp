@@ -77,6 +77,10 @@ protected:
 
 		auto& m = cubic->GetMasses();
 		m = masses;
+
+		auto& ids = cubic->GetAtomIDs();
+		for(auto& idx : indices)
+			ids.push_back(idx + (comm.size() == 2 ? 4*comm.rank() : 0));
 	}
 };
 
@@ -90,6 +94,62 @@ TEST_F(COMTest, ZeroCOMTest)
 	EXPECT_NEAR(com[2], 10.0, eps);
 }
 
+TEST_F(COMTest, PartialGroupTest)
+{
+	// Only the first two atoms on the first rank, which straddle 
+	// the z boundary. Other ranks contribute no atoms.
+	Label sub;
+	if(comm.rank() == 0)
+		sub = {0, 1};
+
+	auto com = cubic->CenterOfMass(sub);
+	EXPECT_NEAR(com[0], 8.0, eps);
+	EXPECT_NEAR(com[1], 8.0, eps);
+	EXPECT_NEAR(com[2], 10.0, eps);
+
+	// Provided total mass must give the same result.
+	com = cubic->CenterOfMass(sub, 2.0);
+	EXPECT_NEAR(com[0], 8.0, eps);
+	EXPECT_NEAR(com[1], 8.0, eps);
+	EXPECT_NEAR(com[2], 10.0, eps);
+}
+
+TEST_F(COMTest, MultiGroupTest)
+{
+	// Whole cube, a pair straddling z anchored at its second atom, a pair spanning 
+	// both ranks and an empty group.
+	std::vector<Label> groups = {{0, 1, 2, 3, 4, 5, 6, 7}, {1, 0}, {3, 7}, {}};
+
+	std::vector<Label> idx;
+	Label anchors;
+	cubic->GetGroupIndices(groups, &idx, &anchors);
+	ASSERT_EQ(idx.size(), groups.size());
+	ASSERT_EQ(anchors.size(), groups.size());
+	EXPECT_EQ(anchors[3], -1);
+
+	std::vector<double> m;
+	auto coms = cubic->CentersOfMass(idx, anchors, &m);
+	ASSERT_EQ(coms.size(), groups.size());
+	for(size_t i = 0; i < 3; ++i)
+	{
+		// Results may differ by a box vector from the single group 
+		// version, which picks its reference differently.
+		Vector3 d = coms[i] - cubic->CenterOfMass(idx[i]);
+		cubic->ApplyMinimumImage(&d);
+		EXPECT_NEAR(d.norm(), 0, eps);
+		EXPECT_NEAR(m[i], groups[i].size(), eps);
+	}
+
+	EXPECT_NEAR(coms[1][0], 8.0, eps);
+	EXPECT_NEAR(coms[1][1], 8.0, eps);
+	EXPECT_NEAR(coms[1][2], 0.0, eps);
+	EXPECT_NEAR(coms[2][0], 10.0, eps);
+	EXPECT_NEAR(coms[2][1], 2.0, eps);
+	EXPECT_NEAR(coms[2][2], 2.0, eps);
+	EXPECT_NEAR(m[3], 0, eps);
+	EXPECT_NEAR(coms[3].norm(), 0, eps);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include "json/json.h"
+#include "../src/CVs/CombinationCV.h"
+#include "../src/CVs/BoxVolumeCV.h"
+#include "../src/CVs/ParticlePositionCV.h"
+#include "../src/CVs/ParticleSeparationCV.h"
+
+using namespace SSAGES;
+
+// Test up to accuracy of 10^-10
+const double eps = 1e-10;
+
+class CombinationCVTest : public ::testing::Test
+{
+protected:
+	boost::mpi::communicator comm;
+	std::shared_ptr<Snapshot> snapshot;
+
+	virtual void SetUp()
+	{
+		Matrix3 H;
+		H << 10.0,    0,    0,
+		        0, 10.0,    0,
+		        0,    0, 10.0;
+
+		snapshot = std::make_shared<Snapshot>(comm, 0);
+		snapshot->SetHMatrix(H);
+		snapshot->SetNumAtoms(3);
+
+		auto& pos = snapshot->GetPositions();
+		pos.push_back({1.0, 2.0, 2.0});
+		pos.push_back({4.0, 2.0, 6.0});
+		pos.push_back({1.0, 1.0, 1.0});
+		snapshot->GetMasses() = {1.0, 1.0, 1.0};
+		snapshot->GetAtomIDs() = {1, 2, 3};
+	}
+
+	// Distance of atom 1 from the origin, 3.
+	CollectiveVariable* Position()
+	{
+		return new ParticlePositionCV({1}, {0, 0, 0}, true, true, true);
+	}
+
+	// Distance between atoms 1 and 2, 5.
+	CollectiveVariable* Separation()
+	{
+		return new ParticleSeparationCV({1}, {2});
+	}
+
+	// Check a gradient against a combination of reference gradients.
+	void ExpectGradient(const CollectiveVariable& cv, const std::vector<Vector3>& ref)
+	{
+		const auto& grad = cv.GetGradient();
+		ASSERT_EQ(grad.size(), ref.size());
+		for(size_t i = 0; i < ref.size(); ++i)
+			for(int d = 0; d < 3; ++d)
+				EXPECT_NEAR(grad[i][d], ref[i][d], eps);
+	}
+};
+
+TEST_F(CombinationCVTest, Linear)
+{
+	std::unique_ptr<CollectiveVariable> x1(Position()), x2(Separation());
+	x1->Evaluate(*snapshot);
+	x2->Evaluate(*snapshot);
+
+	CombinationCV<LinearForm> cv({Position(), Separation()}, {{2., -1.}, 1.});
+	EXPECT_EQ(cv.GetCommStages(), 2);
+	cv.Evaluate(*snapshot);
+	EXPECT_NEAR(cv.GetValue(), 2.*3. - 5. + 1., eps);
+
+	std::vector<Vector3> ref(3);
+	for(size_t i = 0; i < 3; ++i)
+		ref[i] = 2.*x1->GetGradient()[i] - x2->GetGradient()[i];
+	ExpectGradient(cv, ref);
+
+	// Atom 1 appears in both CVs.
+	EXPECT_EQ(cv.GetSparseGradient().size(), 3u);
+}
+
+TEST_F(CombinationCVTest, ProductAndQuotient)
+{
+	std::unique_ptr<CollectiveVariable> x1(Position()), x2(Separation());
+	x1->Evaluate(*snapshot);
+	x2->Evaluate(*snapshot);
+	const auto& g1 = x1->GetGradient();
+	const auto& g2 = x2->GetGradient();
+
+	CombinationCV<ProductForm> prod({Position(), Separation()}, {0.5});
+	prod.Evaluate(*snapshot);
+	EXPECT_NEAR(prod.GetValue(), 0.5*3.*5., eps);
+
+	std::vector<Vector3> ref(3);
+	for(size_t i = 0; i < 3; ++i)
+		ref[i] = 0.5*(5.*g1[i] + 3.*g2[i]);
+	ExpectGradient(prod, ref);
+
+	CombinationCV<QuotientForm> quot({Position(), Separation()}, {1.});
+	quot.Evaluate(*snapshot);
+	EXPECT_NEAR(quot.GetValue(), 3./5., eps);
+
+	for(size_t i = 0; i < 3; ++i)
+		ref[i] = g1[i]/5. - 3./25.*g2[i];
+	ExpectGradient(quot, ref);
+
+	// Derivatives of a product with a vanishing factor.
+	std::vector<double> dfdx(3);
+	ProductForm form{2.};
+	EXPECT_DOUBLE_EQ(form.Evaluate({3., 0., 4.}, dfdx), 0.);
+	EXPECT_DOUBLE_EQ(dfdx[0], 0.);
+	EXPECT_DOUBLE_EQ(dfdx[1], 24.);
+	EXPECT_DOUBLE_EQ(dfdx[2], 0.);
+}
+
+TEST_F(CombinationCVTest, Polynomial)
+{
+	std::unique_ptr<CollectiveVariable> x(Separation());
+	x->Evaluate(*snapshot);
+
+	// 1 - 2x + x^2 = (x - 1)^2.
+	CombinationCV<PolynomialForm> cv({Separation()}, {{1., -2., 1.}});
+	cv.Evaluate(*snapshot);
+	EXPECT_NEAR(cv.GetValue(), 16., eps);
+
+	std::vector<Vector3> ref(3);
+	for(size_t i = 0; i < 3; ++i)
+		ref[i] = 8.*x->GetGradient()[i];
+	ExpectGradient(cv, ref);
+}
+
+TEST_F(CombinationCVTest, Unstaged)
+{
+	// CVs which are not staged make the whole combination unstaged.
+	CombinationCV<LinearForm> cv({Position(), new BoxVolumeCV()}, {{1., 0.001}, 0.});
+	EXPECT_EQ(cv.GetCommStages(), 0);
+	cv.Evaluate(*snapshot);
+	EXPECT_NEAR(cv.GetValue(), 3. + 1., eps);
+	EXPECT_NEAR(cv.GetBoxGradient()(0,0), comm.rank() == 0 ? 1. : 0., eps);
+}
+
+TEST_F(CombinationCVTest, BuildAndSerialize)
+{
+	Json::Value json;
+	Json::Reader reader;
+	reader.parse(R"({
+		"type" : "Combination",
+		"form" : "linear",
+		"coefficients" : [1, -1],
+		"cvs" : [
+			{"type" : "ParticleSeparation", "group1" : [1], "group2" : [2]},
+			{"type" : "ParticleSeparation", "group1" : [1], "group2" : [3]}
+		]
+	})", json);
+
+	std::unique_ptr<CollectiveVariable> cv(CollectiveVariable::BuildCV(json, "#/CVs"));
+	cv->Initialize(*snapshot);
+	cv->Evaluate(*snapshot);
+	EXPECT_NEAR(cv->GetValue(), 5. - std::sqrt(2.), eps);
+
+	Json::Value out;
+	cv->Serialize(out);
+	EXPECT_EQ(out["form"].asString(), "linear");
+	EXPECT_EQ(out["cvs"].size(), 2u);
+
+	std::unique_ptr<CollectiveVariable> copy(CollectiveVariable::BuildCV(out, "#/CVs"));
+	copy->Evaluate(*snapshot);
+	EXPECT_NEAR(copy->GetValue(), cv->GetValue(), eps);
+
+	// Quotients need exactly two CVs.
+	json["form"] = "quotient";
+	json["cvs"].append(json["cvs"][0]);
+	EXPECT_THROW(CollectiveVariable::BuildCV(json, "#/CVs"), BuildException);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
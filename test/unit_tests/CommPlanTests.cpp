@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include "../src/Utility/CommPlan.h"
+
+using namespace SSAGES;
+
+TEST(CommPlanTest, FusedRounds)
+{
+	boost::mpi::communicator comm;
+	CommPlan plan(comm);
+	auto rank = comm.rank(), size = comm.size();
+
+	// Two sum segments and a gather segment in one round.
+	auto h1 = plan.ReserveSum(2);
+	auto h2 = plan.ReserveGather(3);
+	auto h3 = plan.ReserveSum(1);
+
+	plan.Local(h1)[0] = 1.;
+	plan.Local(h1)[1] = rank;
+	for(int i = 0; i < 3; ++i)
+		plan.Local(h2)[i] = 10*rank + i;
+	plan.Local(h3)[0] = 2.;
+
+	plan.Execute();
+	EXPECT_EQ(plan.GetCalls(), 1u);
+
+	EXPECT_DOUBLE_EQ(plan.Result(h1)[0], size);
+	EXPECT_DOUBLE_EQ(plan.Result(h1)[1], size*(size-1)/2.);
+	for(int r = 0; r < size; ++r)
+		for(int i = 0; i < 3; ++i)
+			EXPECT_DOUBLE_EQ(plan.Result(h2)[3*r+i], 10*r + i);
+	EXPECT_DOUBLE_EQ(plan.Result(h3)[0], 2.*size);
+
+	// Results stay readable while the next round is set up.
+	auto h4 = plan.ReserveSum(1);
+	plan.Local(h4)[0] = plan.Result(h3)[0];
+	plan.Execute();
+	EXPECT_DOUBLE_EQ(plan.Result(h4)[0], 2.*size*size);
+
+	// Empty rounds do not communicate.
+	plan.Execute();
+	EXPECT_EQ(plan.GetCalls(), 2u);
+}
+
+TEST(CommPlanTest, FusedPlans)
+{
+	boost::mpi::communicator comm;
+	CommPlan p1(comm), p2(comm), p3(comm);
+	auto rank = comm.rank(), size = comm.size();
+
+	auto h1 = p1.ReserveSum(1);
+	auto h2 = p2.ReserveGather(1);
+	p1.Local(h1)[0] = 1.;
+	p2.Local(h2)[0] = rank;
+
+	// Plans without segments take part as well.
+	CommPlan::ExecuteAll({&p1, &p2, &p3});
+	EXPECT_EQ(p1.GetCalls(), 1u);
+	EXPECT_EQ(p3.GetCalls(), 1u);
+
+	EXPECT_DOUBLE_EQ(p1.Result(h1)[0], size);
+	for(int r = 0; r < size; ++r)
+		EXPECT_DOUBLE_EQ(p2.Result(h2)[r], r);
+
+	// Plans remain usable on their own.
+	auto h3 = p2.ReserveSum(1);
+	p2.Local(h3)[0] = p2.Result(h2)[size-1];
+	p2.Execute();
+	EXPECT_DOUBLE_EQ(p2.Result(h3)[0], size*(size-1.));
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
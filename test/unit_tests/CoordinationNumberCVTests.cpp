@@ -2,6 +2,7 @@
 #include "../src/Snapshot.h"
 #include "gtest/gtest.h"
 #include <boost/mpi.hpp>
+#include <random>
 
 using namespace SSAGES;
 
@@ -144,6 +145,178 @@ TEST_F(CoordinationNumberCVTest, DefaultBehavior)
     EXPECT_NEAR(grad2[2][2], grad1[2][2], eps);
 }
 
+TEST_F(CoordinationNumberCVTest, NeighborListTest)
+{
+    // Random atoms in a periodic triclinic box.
+    if(comm.size() > 1)
+        return;
+
+    Matrix3 H;
+    H << 8.0, 1.0, 0.5,
+         0.0, 7.0, 1.5,
+         0.0, 0.0, 9.0;
+    snapshot->SetHMatrix(H);
+
+    int n = 300;
+    auto& ids = snapshot->GetAtomIDs();
+    auto& pos = snapshot->GetPositions();
+    ids.resize(n);
+    pos.resize(n);
+    snapshot->SetNumAtoms(n);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> u(0, 1), d(-0.05, 0.05);
+    for(int i = 0; i < n; ++i)
+    {
+        ids[i] = i + 1;
+        pos[i] = H*Vector3{u(gen), u(gen), u(gen)};
+    }
+
+    Label group1, group2;
+    for(int i = 1; i <= n; ++i)
+        (i % 4 ? group2 : group1).push_back(i);
+
+    SwitchingFunction sf(0.2, 1.0, 6, 12, 2.0);
+    CoordinationNumberCV cv(group1, group2, SwitchingFunction(0.2, 1.0, 6, 12, 2.0), 0.4);
+    cv.Initialize(*snapshot);
+
+    for(int step = 0; step < 5; ++step)
+    {
+        // Reference by brute force.
+        double ref = 0, df;
+        for(auto& i : group1)
+            for(auto& j : group2)
+            {
+                Vector3 rij = pos[i-1] - pos[j-1];
+                snapshot->ApplyMinimumImage(&rij);
+                ref += sf.Evaluate(rij.norm(), df);
+            }
+
+        cv.Evaluate(*snapshot);
+        EXPECT_NEAR(cv.GetValue(), ref, eps);
+
+        // Displacements smaller than half the skin.
+        for(auto& p : pos)
+            p += Vector3{d(gen), d(gen), d(gen)};
+    }
+}
+
+TEST_F(CoordinationNumberCVTest, UntruncatedTest)
+{
+    // Without a cutoff all pairs are visited directly.
+    if(comm.size() > 1)
+        return;
+
+    snapshot->SetHMatrix(6.0*Matrix3::Identity());
+
+    int n = 60;
+    auto& ids = snapshot->GetAtomIDs();
+    auto& pos = snapshot->GetPositions();
+    ids.resize(n);
+    pos.resize(n);
+    snapshot->SetNumAtoms(n);
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> u(0, 6.0);
+    for(int i = 0; i < n; ++i)
+    {
+        ids[i] = i + 1;
+        pos[i] = {u(gen), u(gen), u(gen)};
+    }
+
+    Label group1, group2;
+    for(int i = 1; i <= n; ++i)
+        (i % 3 ? group2 : group1).push_back(i);
+
+    SwitchingFunction sf(0, 1.5, 6, 12);
+    EXPECT_FALSE(sf.IsTruncated());
+    CoordinationNumberCV cv(group1, group2, SwitchingFunction(0, 1.5, 6, 12));
+    cv.Initialize(*snapshot);
+    cv.Evaluate(*snapshot);
+
+    double ref = 0, df;
+    for(auto& i : group1)
+        for(auto& j : group2)
+        {
+            Vector3 rij = pos[i-1] - pos[j-1];
+            snapshot->ApplyMinimumImage(&rij);
+            ref += sf.Evaluate(rij.norm(), df);
+        }
+
+    EXPECT_GT(ref, 0);
+    EXPECT_NEAR(cv.GetValue(), ref, eps);
+}
+
+TEST(SwitchingFunctionTest, Forms)
+{
+    std::vector<SwitchingFunction> sfs = {
+        SwitchingFunction(0, 1.5, 6, 12),
+        SwitchingFunction(0, 1.5, 8, 16, 4.0),
+        SwitchingFunction(0, 1.5, 4, 10),
+        SwitchingFunction(0.3, 1.2, 5, 9),
+        SwitchingFunction(0.3, 1.2, 0, 0, 5.0, SwitchingFunction::Exponential),
+        SwitchingFunction(0, 1.2, 0, 0, 5.0, SwitchingFunction::Gaussian),
+        SwitchingFunction(0.3, 1.2, 0, 0, 5.0, SwitchingFunction::Gaussian)
+    };
+
+    std::vector<double> r = {0.4, 0.9, 1.3, 2.1, 3.7, 4.5};
+    std::vector<double> r2, f(r.size()), dfr(r.size());
+    for(auto& x : r)
+        r2.push_back(x*x);
+
+    for(auto& sf : sfs)
+    {
+        sf.Evaluate(r2.data(), r2.size(), f.data(), dfr.data());
+        for(size_t i = 0; i < r.size(); ++i)
+        {
+            // Batched and scalar evaluation agree.
+            double df;
+            EXPECT_NEAR(sf.Evaluate(r[i], df), f[i], eps);
+            EXPECT_NEAR(df, dfr[i]*r[i], eps);
+
+            // Derivative matches finite differences.
+            double h = 1e-6, d1, d2;
+            auto fd = (sf.Evaluate(r[i] + h, d1) - sf.Evaluate(r[i] - h, d2))/(2*h);
+            if(!sf.IsTruncated() || r[i] < sf.GetCutoff())
+                EXPECT_NEAR(df, fd, 1e-6);
+            else
+                EXPECT_EQ(f[i], 0);
+        }
+    }
+
+    // Original rational form.
+    double df;
+    auto x = 1.3/1.5;
+    EXPECT_NEAR(sfs[0].Evaluate(1.3, df), (1 - std::pow(x, 6))/(1 - std::pow(x, 12)), eps);
+}
+
+TEST(SwitchingFunctionTest, Tabulated)
+{
+    SwitchingFunction exact(0, 1.0, 6, 12, 3.0);
+    SwitchingFunction table(0, 1.0, 6, 12, 3.0);
+    table.Tabulate(20000);
+
+    // The table vanishes at the cutoff.
+    double df, shift = exact.Evaluate(3.0, df);
+    EXPECT_NEAR(table.Evaluate(3.0 - 1e-9, df), 0, 1e-8);
+
+    for(double r = 0.05; r < 3.0; r += 0.1)
+    {
+        double dfe, dft;
+        EXPECT_NEAR(table.Evaluate(r, dft), exact.Evaluate(r, dfe) - shift, 1e-4);
+        EXPECT_NEAR(dft, dfe, 1e-3);
+    }
+
+    EXPECT_THROW(SwitchingFunction(0, 1.0, 6, 12).Tabulate(100), BuildException);
+
+    // Only a truncated function writes its cutoff.
+    Json::Value json;
+    SwitchingFunction(0, 1.0, 6, 12).Serialize(json);
+    EXPECT_FALSE(json.isMember("dmax"));
+    table.Serialize(json);
+    EXPECT_DOUBLE_EQ(json["dmax"].asDouble(), 3.0);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include "../src/CVs/ParticlePositionCV.h"
+#include "../src/CVs/ParticleSeparationCV.h"
+#include "../src/Utility/ExpressionCache.h"
+
+using namespace SSAGES;
+
+// Test up to accuracy of 10^-10
+const double eps = 1e-10;
+
+class ExpressionCacheTest : public ::testing::Test
+{
+protected:
+	boost::mpi::communicator comm;
+	std::shared_ptr<Snapshot> snapshot;
+
+	virtual void SetUp()
+	{
+		Matrix3 H;
+		H << 10.0,    0,    0,
+		        0, 10.0,    0,
+		        0,    0, 10.0;
+
+		snapshot = std::make_shared<Snapshot>(comm, 0);
+		snapshot->SetHMatrix(H);
+		snapshot->SetNumAtoms(4);
+
+		// Group {1,2} straddles the periodic boundary.
+		auto& pos = snapshot->GetPositions();
+		pos.push_back({9.5, 1.0, 1.0});
+		pos.push_back({0.5, 1.0, 1.0});
+		pos.push_back({3.0, 4.0, 5.0});
+		pos.push_back({4.0, 4.0, 5.0});
+		snapshot->GetMasses() = {1.0, 3.0, 2.0, 2.0};
+		snapshot->GetAtomIDs() = {1, 2, 3, 4};
+	}
+};
+
+TEST_F(ExpressionCacheTest, SharedCenterOfMass)
+{
+	ParticlePositionCV pos({1, 2}, {0, 0, 0}, true, true, true);
+	ParticleSeparationCV sep({1, 2}, {3, 4});
+
+	// Reference values without a cache.
+	pos.Evaluate(*snapshot);
+	sep.Evaluate(*snapshot);
+	auto pval = pos.GetValue(), sval = sep.GetValue();
+	EXPECT_NEAR(pval, std::sqrt(0.25*0.25 + 2.), eps);
+
+	ExpressionCache cache;
+	snapshot->SetCache(&cache);
+
+	// Group {1,2} is computed once and shared.
+	pos.Evaluate(*snapshot);
+	sep.Evaluate(*snapshot);
+	EXPECT_NEAR(pos.GetValue(), pval, eps);
+	EXPECT_NEAR(sep.GetValue(), sval, eps);
+	EXPECT_EQ(cache.GetMisses(), 2u);
+	EXPECT_EQ(cache.GetHits(), 1u);
+	EXPECT_FALSE(cache.IsPending());
+
+	// Gradients see the same local indices.
+	EXPECT_EQ(pos.GetSparseGradient().size(), 2u);
+	EXPECT_EQ(sep.GetSparseGradient().size(), 4u);
+
+	// Modified positions invalidate the results.
+	snapshot->GetPositions()[2][0] = 2.0;
+	sep.Evaluate(*snapshot);
+	EXPECT_EQ(cache.GetMisses(), 4u);
+	EXPECT_NEAR(sep.GetValue(), std::sqrt(2.75*2.75 + 9. + 16.), eps);
+
+	// So does a new iteration.
+	snapshot->SetIteration(1);
+	pos.Evaluate(*snapshot);
+	EXPECT_EQ(cache.GetMisses(), 5u);
+	EXPECT_NEAR(pos.GetValue(), pval, eps);
+
+	snapshot->SetCache(nullptr);
+}
+
+TEST_F(ExpressionCacheTest, LocalIndices)
+{
+	ExpressionCache cache;
+	const auto& idx = cache.GetIndices(*snapshot, {4, 2});
+	ASSERT_EQ(idx.size(), 2u);
+	EXPECT_EQ(idx[0], 3);
+	EXPECT_EQ(idx[1], 1);
+
+	// Re-sorting the atoms refreshes the indices.
+	snapshot->GetAtomIDs() = {4, 3, 2, 1};
+	const auto& idx2 = cache.GetIndices(*snapshot, {4, 2});
+	EXPECT_EQ(idx2[0], 0);
+	EXPECT_EQ(idx2[1], 2);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
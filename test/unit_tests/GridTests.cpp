@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include "json/json.h"
+#include "../src/Grids/Grid.h"
+#include "../src/Grids/Histogram.h"
+#include "../src/Utility/ThreadPool.h"
+
+using namespace SSAGES;
+
+class GridTest : public ::testing::Test
+{
+protected:
+	// 2d grid, periodic in the second dimension.
+	Grid<int> grid{{10, 4}, {0.0, -1.0}, {1.0, 1.0}, {false, true}};
+	Grid<int, 2> fixed{{10, 4}, {0.0, -1.0}, {1.0, 1.0}, {false, true}};
+
+	virtual void SetUp()
+	{
+		for(size_t i = 0; i < grid.size(); ++i)
+		{
+			grid.data()[i] = i;
+			fixed.data()[i] = i;
+		}
+	}
+};
+
+typedef Grid<int, 2>::Indices Indices2;
+typedef Grid<int, 2>::Point Point2;
+
+TEST_F(GridTest, Lookup)
+{
+	// First dimension runs fastest.
+	EXPECT_EQ((grid.at({3, 2})), 23);
+	EXPECT_EQ((fixed.at(Indices2{{3, 2}})), 23);
+	EXPECT_EQ((fixed.GetFlatIndex(Indices2{{3, 2}})), 23u);
+
+	// Points, with wrapping in the periodic dimension.
+	EXPECT_EQ((grid[{0.35, 0.3}]), 23);
+	EXPECT_EQ((fixed[Point2{{0.35, 0.3}}]), 23);
+	EXPECT_EQ((fixed[Point2{{0.35, -1.7}}]), 23);
+	EXPECT_EQ((grid[{0.35, 2.3}]), 23);
+
+	auto idx = fixed.GetIndices(Point2{{0.95, -0.9}});
+	EXPECT_EQ(idx[0], 9);
+	EXPECT_EQ(idx[1], 0);
+	EXPECT_EQ(grid.GetIndex(1, 1.2), 0);
+
+	auto x = fixed.GetCoordinates(Indices2{{3, 2}});
+	EXPECT_DOUBLE_EQ(x[0], 0.35);
+	EXPECT_DOUBLE_EQ(x[1], 0.25);
+	EXPECT_DOUBLE_EQ((grid.GetCoordinates({3, 2})[0]), 0.35);
+
+	// Outside of the non-periodic dimension.
+	EXPECT_EQ(fixed.GetIndices(Point2{{-0.1, 0.0}})[0], -1);
+	EXPECT_EQ(fixed.GetIndices(Point2{{1.1, 0.0}})[0], 10);
+	EXPECT_THROW(fixed.at(Point2{{1.1, 0.0}}), std::out_of_range);
+	EXPECT_THROW(grid.at({10, 0}), std::out_of_range);
+	EXPECT_THROW(grid.at({1, 1, 1}), std::invalid_argument);
+}
+
+TEST_F(GridTest, Histogram)
+{
+	// Under- and overflow bins in the non-periodic dimension only.
+	Histogram<int> hist({10, 4}, {0.0, -1.0}, {1.0, 1.0}, {false, true});
+	EXPECT_EQ(hist.size(), 12u*4u);
+
+	hist.at({-1, 0}) = 1;
+	hist.at({10, 3}) = 2;
+	EXPECT_EQ(hist.data()[0], 1);
+	EXPECT_EQ(hist.data()[hist.size() - 1], 2);
+	EXPECT_EQ((hist[{1.5, 0.9}]), 2);
+	EXPECT_THROW(hist.at({11, 0}), std::out_of_range);
+}
+
+TEST_F(GridTest, Cells)
+{
+	// Storage order, with indices and coordinates along.
+	size_t n = 0;
+	for(auto it = grid.cell_begin(); it != grid.cell_end(); ++it, ++n)
+	{
+		EXPECT_EQ(*it, int(n));
+		EXPECT_EQ((grid.at(it.indices())), int(n));
+		EXPECT_DOUBLE_EQ(it.coordinate(0), grid.GetCoordinates(it.indices())[0]);
+		EXPECT_DOUBLE_EQ(it.coordinate(1), grid.GetCoordinates(it.indices())[1]);
+	}
+	EXPECT_EQ(n, grid.size());
+
+	// Histograms include the under- and overflow bins.
+	Histogram<int> hist({10, 4}, {0.0, -1.0}, {1.0, 1.0}, {false, true});
+	auto it = hist.cell_begin();
+	EXPECT_EQ(it.index(0), -1);
+	EXPECT_TRUE(it.isUnderOverflowBin());
+	EXPECT_DOUBLE_EQ(it.coordinate(0), -0.05);
+	for(int i = 0; i < 12; ++i)
+		++it;
+	EXPECT_EQ(it.index(0), -1);
+	EXPECT_EQ(it.index(1), 1);
+	++it;
+	EXPECT_FALSE(it.isUnderOverflowBin());
+
+	// Threads each visit a part of the grid.
+	ThreadPool pool(3);
+	grid.for_each_cell([](Grid<int>::cell_iterator& it)
+	{
+		*it = 10*it.index(1) + it.index(0);
+	}, &pool);
+	EXPECT_EQ((grid.at({3, 2})), 23);
+	EXPECT_EQ((grid.at({9, 3})), 39);
+
+	int sum = 0;
+	const Grid<int>& cgrid = grid;
+	cgrid.for_each_cell([&](Grid<int>::const_cell_iterator& it) { sum += *it; });
+	EXPECT_EQ(sum, 4*45 + 10*60);
+}
+
+TEST_F(GridTest, Build)
+{
+	Json::Value json;
+	Json::Reader reader;
+	reader.parse(R"({
+		"lower" : [0.0, -1.0],
+		"upper" : [1.0, 1.0],
+		"number_points" : [10, 4],
+		"periodic" : [false, true]
+	})", json);
+
+	std::unique_ptr<Grid<int, 2>> g(Grid<int, 2>::BuildGrid(json));
+	EXPECT_EQ(g->GetDimension(), 2u);
+	EXPECT_EQ(g->size(), 40u);
+
+	EXPECT_THROW((Grid<int, 3>::BuildGrid(json)), BuildException);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
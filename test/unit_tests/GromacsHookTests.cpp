@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+
+#define private public
+#define protected public
+#include "../../hooks/gromacs/GromacsHook.cpp"
+
+using namespace SSAGES;
+
+class GromacsHookTest : public ::testing::Test
+{
+protected:
+	boost::mpi::communicator comm;
+	std::shared_ptr<Snapshot> snapshot;
+
+	// Local Gromacs arrays of four atoms.
+	int indices[4] = {0, 1, 2, 3};
+	int types[4] = {1, 1, 1, 1};
+	double masses[4] = {1., 2., 3., 4.};
+	double positions[4][3] = {{0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}};
+	double velocities[4][3] = {};
+	double forces[4][3] = {};
+	double box[3][3] = {{10, 0, 0}, {0, 10, 0}, {0, 0, 10}};
+
+	virtual void SetUp()
+	{
+		snapshot = std::make_shared<Snapshot>(comm, 0);
+		GromacsHook::Instance().SetSnapshot(snapshot.get());
+	}
+
+	void Pull(int iteration)
+	{
+		GromacsHook::Instance().PullToSSAGES(
+			iteration, 4, indices, types, masses, positions,
+			velocities, forces, box, 300., 0., 1.);
+	}
+};
+
+TEST_F(GromacsHookTest, FullToPartialSync)
+{
+	if(comm.size() > 1)
+		return;
+
+	auto& hook = GromacsHook::Instance();
+	hook.fullsync_ = true;
+	Pull(0);
+	EXPECT_EQ(snapshot->GetNumAtoms(), 4);
+	EXPECT_EQ(hook.engineids_.size(), hook.engineidx_.size());
+
+	// Only the atoms of the CVs after the pre-simulation hook.
+	hook.fullsync_ = false;
+	hook.syncids_ = {2, 4};
+	Pull(1);
+	ASSERT_EQ(snapshot->GetNumAtoms(), 2);
+	EXPECT_EQ(snapshot->GetAtomIDs()[0], 2);
+	EXPECT_EQ(snapshot->GetAtomIDs()[1], 4);
+	EXPECT_DOUBLE_EQ(snapshot->GetMasses()[1], 4.);
+
+	// Forces go back to the synchronized atoms only.
+	snapshot->GetForces()[0] = {1, 0, 0};
+	snapshot->GetForces()[1] = {2, 0, 0};
+	double virial[3][3] = {};
+	hook.PushToGromacs(4, indices, types, masses, positions, velocities, forces, virial);
+	EXPECT_DOUBLE_EQ(forces[0][0], 0.);
+	EXPECT_DOUBLE_EQ(forces[1][0], 1.);
+	EXPECT_DOUBLE_EQ(forces[3][0], 2.);
+
+	// Atoms which moved locally are found again.
+	std::swap(indices[1], indices[2]);
+	std::swap(masses[1], masses[2]);
+	Pull(2);
+	ASSERT_EQ(snapshot->GetNumAtoms(), 2);
+	EXPECT_EQ(snapshot->GetAtomIDs()[0], 2);
+	EXPECT_DOUBLE_EQ(snapshot->GetMasses()[0], 2.);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
@@ -79,6 +79,44 @@ TEST_F(GyrationTensorCVTests, CompareRg)
     EXPECT_NEAR(cv->GetGradient()[2][2], 0.2222222222, eps);
 }
 
+TEST_F(GyrationTensorCVTests, Components)
+{
+    auto& pos = snapshot1->GetPositions();
+    pos[1] = {1.2, 0.7, 1.1};
+    auto& mass = snapshot1->GetMasses();
+    mass[2] = 2.;
+
+    GyrationTensorCV multi({1,2,3}, {Rg, asphericity, shapeaniso});
+    ComponentCV aview(&multi, asphericity);
+    ComponentCV sview(&multi, shapeaniso);
+    EXPECT_EQ(aview.GetSource(), &multi);
+    EXPECT_FALSE(multi.IsEnabled(principal2));
+
+    multi.Initialize(*snapshot1);
+    multi.Evaluate(*snapshot1);
+    aview.Collect(*snapshot1);
+    sview.Collect(*snapshot1);
+
+    // Each component matches a CV computing it alone.
+    std::vector<std::pair<CollectiveVariable*, GyrationTensor>> checks = {
+        {&multi, Rg}, {&aview, asphericity}, {&sview, shapeaniso}
+    };
+    for(auto& check : checks)
+    {
+        GyrationTensorCV single({1,2,3}, check.second);
+        single.Initialize(*snapshot1);
+        single.Evaluate(*snapshot1);
+
+        EXPECT_NEAR(check.first->GetValue(), single.GetValue(), eps);
+        EXPECT_NEAR(multi.GetComponentValue(check.second), single.GetValue(), eps);
+        for(int i = 0; i < 3; ++i)
+            for(int d = 0; d < 3; ++d)
+                EXPECT_NEAR(check.first->GetGradient()[i][d], single.GetGradient()[i][d], eps);
+    }
+
+    EXPECT_ANY_THROW(ComponentCV(&multi, 7));
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
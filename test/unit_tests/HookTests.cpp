@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include "../src/Hook.h"
+#include "../src/Snapshot.h"
+#include "../src/CVs/CollectiveVariable.h"
+
+using namespace SSAGES;
+
+// Hook which does not talk to an engine.
+class TestHook : public Hook
+{
+protected:
+	void SyncToEngine() override {}
+	void SyncToSnapshot() override {}
+
+public:
+	using Hook::IsActive;
+};
+
+// CV counting its evaluations, with a unit gradient on atom 0.
+class CountingCV : public CollectiveVariable
+{
+public:
+	int evaluations = 0;
+
+	bool GetAtomSet(Label& ids) const override
+	{
+		ids.push_back(1);
+		return true;
+	}
+
+	void Evaluate(const Snapshot& snapshot) override
+	{
+		++evaluations;
+		val_ = snapshot.GetIteration();
+		ClearGradient(snapshot.GetNumAtoms());
+		AddGradient(0, {1, 0, 0});
+	}
+
+	void Serialize(Json::Value&) const override {}
+};
+
+// Listener with a unit bias derivative on every CV.
+class ConstantBias : public EventListener
+{
+public:
+	ConstantBias(unsigned int frequency) : EventListener(frequency) {}
+
+	void PreSimulation(Snapshot*, const CVList&) override {}
+	void PostSimulation(Snapshot*, const CVList&) override {}
+	void PostIntegration(Snapshot*, const CVList& cvs) override
+	{
+		derivatives_.assign(cvs.size(), 1.);
+	}
+};
+
+class HookTest : public ::testing::Test
+{
+protected:
+	boost::mpi::communicator comm;
+	std::shared_ptr<Snapshot> snapshot;
+	TestHook hook;
+	CountingCV cv;
+
+	virtual void SetUp()
+	{
+		snapshot = std::make_shared<Snapshot>(comm, 0);
+		snapshot->SetNumAtoms(1);
+		snapshot->GetPositions().push_back({0, 0, 0});
+		snapshot->GetForces().push_back({0, 0, 0});
+		snapshot->GetMasses() = {1.0};
+		snapshot->GetAtomIDs() = {1};
+
+		hook.SetSnapshot(snapshot.get());
+		hook.AddCV(&cv);
+	}
+
+	// Run an iteration and return the bias force on atom 0.
+	double Step(int iteration)
+	{
+		snapshot->SetIteration(iteration);
+		snapshot->GetForces()[0] = Vector3::Zero();
+		hook.PostIntegrationHook();
+		return snapshot->GetForces()[0][0];
+	}
+};
+
+TEST_F(HookTest, SkipInactiveSteps)
+{
+	ConstantBias bias(2);
+	hook.AddListener(&bias);
+	hook.PreSimulationHook();
+	EXPECT_EQ(cv.evaluations, 1);
+
+	EXPECT_FALSE(hook.IsActive(1));
+	EXPECT_TRUE(hook.IsActive(2));
+
+	EXPECT_DOUBLE_EQ(Step(1), 0.);
+	EXPECT_DOUBLE_EQ(Step(2), -1.);
+	EXPECT_DOUBLE_EQ(Step(3), 0.);
+	EXPECT_EQ(cv.evaluations, 2);
+	EXPECT_DOUBLE_EQ(cv.GetValue(), 2.);
+}
+
+TEST_F(HookTest, ImpulseStride)
+{
+	ConstantBias bias(1);
+	hook.AddListener(&bias);
+	cv.SetStride(3);
+	hook.PreSimulationHook();
+
+	EXPECT_DOUBLE_EQ(Step(1), 0.);
+	EXPECT_DOUBLE_EQ(Step(2), 0.);
+	EXPECT_DOUBLE_EQ(Step(3), -3.);
+	EXPECT_DOUBLE_EQ(Step(4), 0.);
+	EXPECT_EQ(cv.evaluations, 2);
+
+	// Without impulse scaling the force is applied as is.
+	cv.SetStride(3, false);
+	EXPECT_DOUBLE_EQ(Step(6), -1.);
+	EXPECT_EQ(cv.evaluations, 3);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
@@ -0,0 +1,241 @@
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#define private public
+#define protected public
+#include "../src/Methods/Meta.h"
+#include "../src/CVs/MockCV.h"
+
+using namespace SSAGES;
+
+// CV with a settable value, optionally periodic on [-1, 1).
+class ValueCV : public MockCV
+{
+public:
+	bool periodic;
+
+	ValueCV(bool periodic = false) :
+	MockCV(0, {0, 0, 0}, -1, 1), periodic(periodic)
+	{}
+
+	void SetValue(double v) { val_ = v; }
+
+	double GetPeriodicValue(double x) const override
+	{
+		return periodic ? x - 2*std::floor((x + 1)/2) : x;
+	}
+
+	double GetDifference(double x) const override
+	{
+		return periodic ? GetPeriodicValue(val_ - x) : val_ - x;
+	}
+};
+
+class MetaTest : public ::testing::Test
+{
+protected:
+	boost::mpi::communicator world, comm;
+
+	// Metadynamics with unit hills, optionally well-tempered.
+	Meta* Build(Grid<Vector>* grid, double cutoff, size_t n = 0,
+	            double biasfactor = 0., double temperature = 0.)
+	{
+		n = grid ? grid->GetDimension() : n;
+		return new Meta(world, comm, 1.0, std::vector<double>(n, 0.1),
+		                std::vector<double>(n, -10.), std::vector<double>(n, 10.),
+		                std::vector<double>(n, 0.), std::vector<double>(n, 0.),
+		                grid, 1, 1, cutoff, biasfactor, temperature);
+	}
+
+	// Derivative of a hill along x.
+	static double Derivative(double dx, double sigma)
+	{
+		return -dx/(sigma*sigma)*std::exp(-dx*dx/(2*sigma*sigma));
+	}
+};
+
+TEST_F(MetaTest, PeriodicDeposition)
+{
+	// Hill close to the upper edge of a periodic grid.
+	Grid<Vector> grid({40}, {-1.}, {1.}, {true});
+	std::unique_ptr<Meta> meta(Build(&grid, 6.));
+	meta->DepositHill(Hill({0.97}, {0.1}, 1.0));
+
+	// Grid points across the boundary see the nearest image.
+	EXPECT_NEAR(grid[{-0.975}][0], Derivative(0.055, 0.1), 1e-12);
+	EXPECT_NEAR(grid[{0.925}][0], Derivative(-0.045, 0.1), 1e-12);
+
+	// Nothing beyond the cutoff.
+	EXPECT_EQ(grid[{0.275}][0], 0.);
+	EXPECT_EQ(grid[{-0.325}][0], 0.);
+}
+
+TEST_F(MetaTest, Cutoff)
+{
+	// Compare against a cutoff larger than the grid.
+	Grid<Vector> grid({30, 20, 10}, {0., -1., 0.}, {1., 1., 2.}, {false, true, false});
+	Grid<Vector> full({30, 20, 10}, {0., -1., 0.}, {1., 1., 2.}, {false, true, false});
+	std::unique_ptr<Meta> meta(Build(&grid, 6.));
+	std::unique_ptr<Meta> ref(Build(&full, 100.));
+
+	for(auto& hill : {Hill({0.3, 0.9, 1.0}, {0.1, 0.2, 0.3}, 0.5),
+	                  Hill({0.02, -0.95, 1.9}, {0.05, 0.1, 0.2}, 1.0),
+	                  Hill({1.2, 0.0, 0.5}, {0.1, 0.1, 0.1}, 1.0)})
+	{
+		meta->DepositHill(hill);
+		ref->DepositHill(hill);
+	}
+
+	double norm = 0;
+	for(size_t i = 0; i < grid.size(); ++i)
+	{
+		for(int d = 0; d < 3; ++d)
+			EXPECT_NEAR(grid.data()[i][d], full.data()[i][d], 1e-6);
+		norm += full.data()[i].norm();
+	}
+	EXPECT_GT(norm, 1.);
+
+	// A hill outside of the non-periodic bounds does not reach the grid.
+	auto copy = grid.data()[0];
+	meta->DepositHill(Hill({3.0, 0.0, 1.0}, {0.1, 0.1, 0.1}, 1.0));
+	EXPECT_EQ(grid.data()[0], copy);
+}
+
+TEST_F(MetaTest, HillStore)
+{
+	ValueCV a, b(true);
+	CVList cvs{&a, &b};
+	HillStore store({0.1, 0.05}, 6.);
+
+	std::mt19937 gen(11);
+	std::uniform_real_distribution<double> x(-3, 3), y(-1, 1), h(0.5, 1.5);
+	std::vector<Hill> hills;
+	for(int i = 0; i < 2000; ++i)
+	{
+		// A few hills wider than the bins.
+		double s = i % 100 ? 1. : 2.5;
+		hills.emplace_back(std::vector<double>{x(gen), y(gen)},
+		                   std::vector<double>{0.1*s, 0.05*s}, h(gen));
+		store.Add(hills.back());
+	}
+	EXPECT_EQ(store.size(), 2000u);
+
+	// Against all hills, including across the periodic boundary.
+	for(auto& p : {std::make_pair(0.3, 0.2), std::make_pair(-1.1, 0.98),
+	               std::make_pair(2.5, -0.99), std::make_pair(5.0, 0.0)})
+	{
+		a.SetValue(p.first);
+		b.SetValue(p.second);
+
+		double bias = 0;
+		std::vector<double> ref(2, 0.);
+		for(auto& hill : hills)
+		{
+			double dx[2], g = hill.height;
+			bool inside = true;
+			for(int d = 0; d < 2; ++d)
+			{
+				dx[d] = cvs[d]->GetDifference(hill.center[d]);
+				inside &= std::abs(dx[d]) <= 6*hill.width[d];
+				g *= std::exp(-dx[d]*dx[d]/(2*hill.width[d]*hill.width[d]));
+			}
+			if(!inside)
+				continue;
+
+			bias += g;
+			for(int d = 0; d < 2; ++d)
+				ref[d] -= g*dx[d]/(hill.width[d]*hill.width[d]);
+		}
+
+		std::vector<double> der(2, 0.);
+		EXPECT_NEAR(store.Evaluate(cvs, der), bias, 1e-10);
+		EXPECT_NEAR(der[0], ref[0], 1e-8);
+		EXPECT_NEAR(der[1], ref[1], 1e-8);
+	}
+}
+
+TEST_F(MetaTest, GridConsistency)
+{
+	// The same hills with and without a grid.
+	Grid<Vector> grid({40, 20}, {-1., -1.}, {1., 1.}, {false, true});
+	std::unique_ptr<Meta> meta(Build(&grid, 4.));
+	ValueCV a, b(true);
+	CVList cvs{&a, &b};
+
+	for(auto& hill : {Hill({0.1, 0.95}, {0.2, 0.3}, 1.0),
+	                  Hill({-0.9, -0.5}, {0.1, 0.1}, 0.5)})
+	{
+		meta->hills_.Add(hill);
+		meta->DepositHill(hill);
+	}
+
+	for(auto it = grid.cell_begin(); it != grid.cell_end(); ++it)
+	{
+		a.SetValue(it.coordinate(0));
+		b.SetValue(it.coordinate(1));
+		std::vector<double> der(2, 0.);
+		meta->hills_.Evaluate(cvs, der);
+		EXPECT_NEAR(der[0], (*it)[0], 1e-12);
+		EXPECT_NEAR(der[1], (*it)[1], 1e-12);
+	}
+}
+
+TEST_F(MetaTest, WellTempered)
+{
+	if(world.size() > 1)
+		return;
+
+	ValueCV a;
+	CVList cvs{&a};
+	Snapshot snapshot(comm, 0);
+	snapshot.SetKb(1.0);
+
+	// Hills at a grid point, with and without a grid.
+	Grid<Vector> grid({10}, {-0.5}, {0.5}, {false});
+	std::unique_ptr<Meta> meta(Build(nullptr, 6., 1, 5., 2.));
+	std::unique_ptr<Meta> gridded(Build(&grid, 6., 1, 5., 2.));
+	a.SetValue(0.05);
+
+	// Heights decay with the bias already deposited.
+	double bias = 0;
+	for(int i = 0; i < 10; ++i)
+	{
+		auto height = std::exp(-bias/(2.*(5. - 1.)));
+		EXPECT_NEAR(meta->CalcBias(cvs), bias, 1e-12);
+		EXPECT_NEAR(gridded->CalcBias(cvs), bias, 1e-12);
+
+		meta->AddHill(cvs, snapshot);
+		gridded->AddHill(cvs, snapshot);
+		EXPECT_NEAR(meta->hills_.bins_[0].height[i], height, 1e-12);
+		EXPECT_NEAR(gridded->hills_.bins_[0].height[i], height, 1e-12);
+		bias += height;
+	}
+	EXPECT_LT(meta->hills_.bins_[0].height.back(), 0.5);
+
+	// The energy grid holds the bias of the hills.
+	for(auto it = grid.cell_begin(); it != grid.cell_end(); ++it)
+	{
+		a.SetValue(it.coordinate(0));
+		std::vector<double> der(1, 0.);
+		EXPECT_NEAR(gridded->energy_->at(it.indices()), meta->hills_.Evaluate(cvs, der), 1e-12);
+	}
+
+	// Off the grid, the hills give the bias.
+	a.SetValue(0.55);
+	EXPECT_NEAR(gridded->CalcBias(cvs), meta->CalcBias(cvs), 1e-12);
+	EXPECT_GT(gridded->CalcBias(cvs), 0.);
+
+	std::remove("hills.out");
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+
+	return ret;
+}
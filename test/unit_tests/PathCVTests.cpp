@@ -0,0 +1,183 @@
+#include "CVs/PathCV.h"
+#include "Snapshot.h"
+#include "gtest/gtest.h"
+#include <boost/mpi.hpp>
+#include <cstdio>
+#include <fstream>
+
+using namespace SSAGES; 
+
+class PathCVTests : public ::testing::Test { 
+protected:
+	virtual void SetUp()
+	{
+		// Frames bend a chain of six atoms progressively.
+		for(int k = 0; k < nframes; ++k)
+		{
+			std::ofstream file(Frame(k));
+			file.precision(15);
+			file << natoms << "\n";
+			file << "Frame " << k << "\n";
+			for(int i = 0; i < natoms; ++i)
+			{
+				auto y = Chain(i, 0.3*k);
+				file << i + 1 << " " << y[0] << " " << y[1] << " " << y[2] << "\n";
+			}
+		}
+
+		snapshot = new Snapshot(comm, 0);
+
+		Matrix3 H;
+		H << 100, 0, 0, 0, 100, 0, 0, 0, 100;
+		snapshot->SetHMatrix(H);
+		snapshot->SetNumAtoms(natoms);
+
+		auto& pos = snapshot->GetPositions();
+		auto& ids = snapshot->GetAtomIDs();
+		auto& mass = snapshot->GetMasses();
+		pos.resize(natoms);
+		ids.resize(natoms);
+		mass.resize(natoms);
+
+		// Between the second and third frame, rotated and displaced.
+		Matrix3 R = Eigen::AngleAxisd(0.4, Vector3{0.3, -1., 0.2}.normalized()).toRotationMatrix();
+		for(int i = 0; i < natoms; ++i)
+		{
+			pos[i] = R*Chain(i, 0.45) + Vector3{5., 3., -2.} + 0.05*Vector3{std::sin(i), std::cos(2.*i), 0.5*i - 1.};
+			ids[i] = i + 1;
+			mass[i] = 1. + 0.5*i;
+		}
+
+		for(int i = 0; i < natoms; ++i)
+			atomids.push_back(i + 1);
+		for(int k = 0; k < nframes; ++k)
+			frames.push_back(Frame(k));
+	}
+
+	virtual void TearDown()
+	{
+		for(int k = 0; k < nframes; ++k)
+			std::remove(Frame(k).c_str());
+		delete snapshot;
+	}
+
+	static std::string Frame(int k)
+	{
+		return "pathframe" + std::to_string(k) + ".xyz";
+	}
+
+	static Vector3 Chain(int i, double bend)
+	{
+		return {1.5*i, std::sin(bend*i), 0.2*i*bend};
+	}
+
+	static constexpr int natoms = 6;
+	static constexpr int nframes = 5;
+
+	Label atomids;
+	std::vector<std::string> frames;
+
+	boost::mpi::communicator comm;
+	Snapshot* snapshot;
+};
+
+TEST_F(PathCVTests, Values)
+{
+	double lambda = 2.;
+	PathCV s(atomids, frames, lambda, PathProgress);
+	PathCV z(atomids, frames, lambda, PathDistance);
+	RMSDCV rmsd(atomids, frames);
+
+	s.Initialize(*snapshot);
+	z.Initialize(*snapshot);
+	rmsd.Initialize(*snapshot);
+	s.Evaluate(*snapshot);
+	z.Evaluate(*snapshot);
+	rmsd.Evaluate(*snapshot);
+
+	// Compare to the definition using the RMSD to each frame.
+	double num = 0, den = 0;
+	for(int k = 0; k < nframes; ++k)
+	{
+		auto d = rmsd.GetRMSDs()[k]*rmsd.GetRMSDs()[k];
+		EXPECT_NEAR(s.GetFrameDistances()[k], d, 1e-10);
+		num += (k + 1)*std::exp(-lambda*d);
+		den += std::exp(-lambda*d);
+	}
+
+	EXPECT_NEAR(s.GetValue(), num/den, 1e-10);
+	EXPECT_NEAR(z.GetValue(), -std::log(den)/lambda, 1e-10);
+	EXPECT_NEAR(s.GetProgress(), z.GetProgress(), 1e-12);
+	EXPECT_GT(s.GetValue(), 2.);
+	EXPECT_LT(s.GetValue(), 4.);
+}
+
+TEST_F(PathCVTests, Gradient)
+{
+	for(auto component : {PathProgress, PathDistance})
+	{
+		PathCV cv(atomids, frames, 5., component);
+		cv.Initialize(*snapshot);
+		cv.Evaluate(*snapshot);
+		auto grad = cv.GetGradient();
+
+		// Compare to central differences.
+		auto& pos = snapshot->GetPositions();
+		const double h = 1e-6;
+		for(int i = 0; i < natoms; ++i)
+			for(int d = 0; d < 3; ++d)
+			{
+				pos[i][d] += h;
+				cv.Evaluate(*snapshot);
+				auto fp = cv.GetValue();
+				pos[i][d] -= 2*h;
+				cv.Evaluate(*snapshot);
+				auto fm = cv.GetValue();
+				pos[i][d] += h;
+
+				EXPECT_NEAR(grad[i][d], (fp - fm)/(2*h), 1e-6);
+			}
+	}
+}
+
+TEST_F(PathCVTests, NeighborScreening)
+{
+	PathCV full(atomids, frames, 50., PathProgress);
+	PathCV screened(atomids, frames, 50., PathProgress, 3, 2);
+	full.Initialize(*snapshot);
+	screened.Initialize(*snapshot);
+
+	// First evaluation considers all frames. 
+	screened.Evaluate(*snapshot);
+	full.Evaluate(*snapshot);
+	EXPECT_EQ(screened.GetActiveFrames().size(), 5u);
+	EXPECT_NEAR(screened.GetValue(), full.GetValue(), 1e-12);
+
+	// Then only the closest frames. The others carry little weight.
+	screened.Evaluate(*snapshot);
+	const auto& active = screened.GetActiveFrames();
+	ASSERT_EQ(active.size(), 3u);
+	EXPECT_EQ(active[0], 0u);
+	EXPECT_EQ(active[1], 1u);
+	EXPECT_EQ(active[2], 2u);
+	EXPECT_NEAR(screened.GetValue(), full.GetValue(), 1e-2);
+
+	// And all of them again after the refresh interval.
+	screened.Evaluate(*snapshot);
+	EXPECT_EQ(screened.GetActiveFrames().size(), 5u);
+}
+
+TEST_F(PathCVTests, BadInput)
+{
+	EXPECT_ANY_THROW(PathCV(atomids, {frames[0]}, 1., PathProgress));
+	EXPECT_ANY_THROW(PathCV(atomids, frames, 0., PathProgress));
+	EXPECT_ANY_THROW(PathCV(atomids, frames, 1., PathProgress, 2, 0));
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	boost::mpi::environment env(argc,argv);
+	int ret = RUN_ALL_TESTS();
+	return ret;
+}
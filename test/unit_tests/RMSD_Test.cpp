@@ -35,6 +35,7 @@ protected:
     	// Set up snapshot No. 1
         // Snapshot 1 contains three atoms
         snapshot1 = new Snapshot(comm, 0);
+        snapshot1->SetNumAtoms(3);
         
         Matrix3 H; 
         H << 100.0, 0.0, 0.0,
@@ -81,6 +82,7 @@ protected:
     }
 
     std::string filexyz1 = "test1.xyz";
+    std::string filexyz2 = "test2.xyz";
     RMSDCV *normal_RMSD;
     RMSDCV *no_range_RMSD;
 
@@ -92,15 +94,17 @@ protected:
 TEST_F(RMSDCVTest, compareRMSD)
 {
 	normal_RMSD->Initialize(*snapshot1);
+	normal_RMSD->Evaluate(*snapshot1);
 
-
-    EXPECT_NEAR(normal_RMSD->GetValue(), 0.29439202887, 1E-8);
+    EXPECT_NEAR(normal_RMSD->GetValue(), 0.10844593852, 1E-8);
 }
 
 TEST_F(RMSDCVTest, TestRange)
 {
 	normal_RMSD->Initialize(*snapshot1);
 	no_range_RMSD->Initialize(*snapshot1);
+	normal_RMSD->Evaluate(*snapshot1);
+	no_range_RMSD->Evaluate(*snapshot1);
 
 	EXPECT_EQ(normal_RMSD->GetValue(), no_range_RMSD->GetValue());
 }
@@ -108,10 +112,94 @@ TEST_F(RMSDCVTest, TestRange)
 TEST_F(RMSDCVTest, BadRange)
 {
 	EXPECT_ANY_THROW(new RMSDCV({1,2,3}, filexyz1, true));
+	EXPECT_ANY_THROW(new RMSDCV({3,1}, filexyz1, true));
+}
+
+TEST_F(RMSDCVTest, RigidMotion)
+{
+	// Rotated and translated reference has zero RMSD.
+	Matrix3 R = Eigen::AngleAxisd(0.7, Vector3{1., 2., -0.5}.normalized()).toRotationMatrix();
+	auto& pos = snapshot1->GetPositions();
+	pos[0] = R*Vector3{0.0, 2.2, 0.8} + Vector3{3., -1., 2.};
+	pos[1] = R*Vector3{1.3, 2.5, 0.5} + Vector3{3., -1., 2.};
+	pos[2] = R*Vector3{1.3, 1.2, 1.3} + Vector3{3., -1., 2.};
+
+	normal_RMSD->Initialize(*snapshot1);
+	normal_RMSD->Evaluate(*snapshot1);
+	EXPECT_NEAR(normal_RMSD->GetValue(), 0, 1e-7);
+
+	// Unequal masses shift the centers, but not the optimum.
+	auto& mass = snapshot1->GetMasses();
+	mass[0] = 12.;
+	mass[2] = 3.;
+	normal_RMSD->Initialize(*snapshot1);
+	normal_RMSD->Evaluate(*snapshot1);
+	EXPECT_NEAR(normal_RMSD->GetValue(), 0, 1e-7);
+}
+
+TEST_F(RMSDCVTest, Gradient)
+{
+	auto& mass = snapshot1->GetMasses();
+	mass[0] = 2.;
+	mass[1] = 0.5;
+
+	normal_RMSD->Initialize(*snapshot1);
+	normal_RMSD->Evaluate(*snapshot1);
+	auto grad = normal_RMSD->GetGradient();
+
+	// Compare to central differences.
+	auto& pos = snapshot1->GetPositions();
+	const double h = 1e-6;
+	for(int i = 0; i < 3; ++i)
+		for(int d = 0; d < 3; ++d)
+		{
+			pos[i][d] += h;
+			normal_RMSD->Evaluate(*snapshot1);
+			auto fp = normal_RMSD->GetValue();
+			pos[i][d] -= 2*h;
+			normal_RMSD->Evaluate(*snapshot1);
+			auto fm = normal_RMSD->GetValue();
+			pos[i][d] += h;
+
+			EXPECT_NEAR(grad[i][d], (fp - fm)/(2*h), 1e-6);
+		}
+}
+
+TEST_F(RMSDCVTest, MultipleReferences)
+{
+	// Second reference is a translated and rotated copy of the positions.
+	std::ofstream myfile(filexyz2);
+	Matrix3 R = Eigen::AngleAxisd(1.1, Vector3{0., 0., 1.}).toRotationMatrix();
+	const auto& pos = snapshot1->GetPositions();
+	myfile << "3\n";
+	myfile << "Comments here\n";
+	myfile.precision(15);
+	for(int i = 0; i < 3; ++i)
+	{
+		Vector3 y = R*pos[i] + Vector3{-1., 4., 0.5};
+		myfile << i + 1 << " " << y[0] << " " << y[1] << " " << y[2] << "\n";
+	}
+	myfile.close();
+
+	RMSDCV multi({1,2,3}, {filexyz1, filexyz2});
+	multi.Initialize(*snapshot1);
+	multi.Evaluate(*snapshot1);
+
+	normal_RMSD->Initialize(*snapshot1);
+	normal_RMSD->Evaluate(*snapshot1);
+
+	ASSERT_EQ(multi.GetRMSDs().size(), 2u);
+	EXPECT_NEAR(multi.GetRMSDs()[0], normal_RMSD->GetValue(), 1e-10);
+	EXPECT_NEAR(multi.GetRMSDs()[1], 0, 1e-7);
+	EXPECT_EQ(multi.GetClosestReference(), 1u);
+	EXPECT_NEAR(multi.GetValue(), 0, 1e-7);
+
+	std::remove(filexyz2.c_str());
 }
 
 int main(int argc, char *argv[])
 {
+    boost::mpi::environment env(argc,argv);
     ::testing::InitGoogleTest(&argc, argv);
     int ret = RUN_ALL_TESTS();
     return ret;
@@ -122,6 +122,40 @@ TEST_F(RouseModeCVTests, DefaultBehavior)
 
 }
 
+TEST_F(RouseModeCVTests, Modes)
+{
+    auto& pos = snapshot1->GetPositions();
+    pos[2][1] = 0.5;
+
+    RouseModeCV multi({{1},{2},{3},{4}}, {1, 0, 3});
+    ComponentCV view0(&multi, 0);
+    ComponentCV view3(&multi, 3);
+    EXPECT_FALSE(multi.IsEnabled(2));
+    EXPECT_EQ(multi.GetComponentName(3), "mode 3");
+
+    // Views evaluate their source on their own.
+    multi.Initialize(*snapshot1);
+    view3.Evaluate(*snapshot1);
+    view0.Collect(*snapshot1);
+
+    std::vector<std::pair<CollectiveVariable*, int>> checks = {
+        {&multi, 1}, {&view0, 0}, {&view3, 3}
+    };
+    for(auto& check : checks)
+    {
+        RouseModeCV single({{1},{2},{3},{4}}, check.second);
+        single.Initialize(*snapshot1);
+        single.Evaluate(*snapshot1);
+
+        EXPECT_NEAR(check.first->GetValue(), single.GetValue(), eps);
+        for(int i = 0; i < 4; ++i)
+            for(int d = 0; d < 3; ++d)
+                EXPECT_NEAR(check.first->GetGradient()[i][d], single.GetGradient()[i][d], eps);
+    }
+
+    EXPECT_ANY_THROW(RouseModeCV({{1},{2},{3},{4}}, 4));
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
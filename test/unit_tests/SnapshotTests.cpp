@@ -293,4 +293,116 @@ TEST_F(SnapshotTest, OriginCubicBoxTest)
 	EXPECT_NEAR(result2[0], 0.7, eps);
 	EXPECT_NEAR(result2[1], 0.6, eps);
 	EXPECT_NEAR(result2[2], 1.0, eps);
-}
\ No newline at end of file
+}
+TEST_F(SnapshotTest, LocalIndexTest)
+{
+	auto& ids = cubic->GetAtomIDs();
+	ids = {4, 8, 15, 16, 23, 42};
+
+	EXPECT_EQ(cubic->GetLocalIndex(4), 0);
+	EXPECT_EQ(cubic->GetLocalIndex(23), 4);
+	EXPECT_EQ(cubic->GetLocalIndex(7), -1);
+
+	Label indices;
+	cubic->GetLocalIndices({42, 7, 8}, &indices);
+	ASSERT_EQ(indices.size(), 2u);
+	EXPECT_EQ(indices[0], 5);
+	EXPECT_EQ(indices[1], 1);
+
+	// Swap two atoms, replace one and drop the tail.
+	auto& nids = cubic->GetAtomIDs();
+	nids = {4, 15, 8, 99, 23};
+
+	EXPECT_EQ(cubic->GetLocalIndex(8), 2);
+	EXPECT_EQ(cubic->GetLocalIndex(15), 1);
+	EXPECT_EQ(cubic->GetLocalIndex(99), 3);
+	EXPECT_EQ(cubic->GetLocalIndex(16), -1);
+	EXPECT_EQ(cubic->GetLocalIndex(42), -1);
+
+	// Grow the list again.
+	cubic->GetAtomIDs().push_back(42);
+	cubic->UpdateIndexMap();
+	EXPECT_EQ(cubic->GetLocalIndex(42), 5);
+	EXPECT_EQ(cubic->GetLocalIndex(4), 0);
+
+	// Version only changes along with the mapping.
+	auto v = cubic->GetIndexMapVersion();
+	cubic->GetAtomIDs();
+	EXPECT_EQ(cubic->GetIndexMapVersion(), v);
+	std::swap(cubic->GetAtomIDs()[0], cubic->GetAtomIDs()[1]);
+	EXPECT_NE(cubic->GetIndexMapVersion(), v);
+}
+
+TEST_F(SnapshotTest, ChangedFieldsTest)
+{
+	cubic->Changed(false);
+	EXPECT_FALSE(cubic->HasChanged());
+
+	// Read-only access flags nothing.
+	const Snapshot* csnapshot = cubic.get();
+	csnapshot->GetPositions();
+	csnapshot->GetForces();
+	EXPECT_FALSE(cubic->HasChanged());
+
+	// Write access flags only the field concerned.
+	cubic->GetForces();
+	EXPECT_TRUE(cubic->HasChanged());
+	EXPECT_TRUE(cubic->HasChanged(Snapshot::Forces));
+	EXPECT_FALSE(cubic->HasChanged(Snapshot::Positions | Snapshot::Velocities));
+
+	cubic->GetVirial();
+	cubic->MarkChanged(Snapshot::Charges);
+	EXPECT_TRUE(cubic->HasChanged(Snapshot::Virial));
+	EXPECT_TRUE(cubic->HasChanged(Snapshot::Charges));
+	EXPECT_FALSE(cubic->HasChanged(Snapshot::Masses));
+
+	cubic->Changed(true);
+	EXPECT_TRUE(cubic->HasChanged(Snapshot::Masses));
+	cubic->Changed(false);
+	EXPECT_FALSE(cubic->HasChanged(Snapshot::AllFields));
+}
+
+TEST_F(SnapshotTest, MappedStorageTest)
+{
+	// Engine-side xyz buffer of two atoms.
+	std::vector<double> x = {1, 2, 3, 4, 5, 6};
+
+	auto& pos = cubic->GetPositions();
+	pos.resize(1);
+	pos[0] = {7, 8, 9};
+
+	pos.Map(x.data(), 2);
+	EXPECT_TRUE(pos.IsMapped());
+	ASSERT_EQ(pos.size(), 2u);
+	EXPECT_EQ(pos[1][0], 4);
+	EXPECT_EQ(pos[1][2], 6);
+
+	// Writes go straight to the engine buffer.
+	pos[1][1] = 10;
+	for(auto& p : pos)
+		p[0] += 1;
+	EXPECT_EQ(x[0], 2);
+	EXPECT_EQ(x[3], 5);
+	EXPECT_EQ(x[4], 10);
+
+	// Copies own their storage.
+	Vector3Array copy(pos);
+	EXPECT_FALSE(copy.IsMapped());
+	copy[0][0] = -1;
+	EXPECT_EQ(x[0], 2);
+
+	// Unmapping restores the owned data.
+	pos.Unmap();
+	EXPECT_FALSE(pos.IsMapped());
+	ASSERT_EQ(pos.size(), 1u);
+	EXPECT_EQ(pos[0][0], 7);
+
+	// Resizing a view detaches it and keeps its contents.
+	pos.Map(x.data(), 2);
+	pos.resize(3);
+	EXPECT_FALSE(pos.IsMapped());
+	ASSERT_EQ(pos.size(), 3u);
+	EXPECT_EQ(pos[1][1], 10);
+	pos[1][1] = 0;
+	EXPECT_EQ(x[4], 10);
+}
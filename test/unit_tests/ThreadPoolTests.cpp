@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <stdexcept>
+#include "../src/Utility/ThreadPool.h"
+
+using namespace SSAGES;
+
+TEST(ThreadPoolTest, ParallelFor)
+{
+	for(size_t nthreads : {1, 4})
+	{
+		ThreadPool pool(nthreads);
+		EXPECT_EQ(pool.GetThreads(), nthreads);
+
+		// Every index is visited exactly once, over repeated loops.
+		for(int rep = 0; rep < 50; ++rep)
+		{
+			std::vector<int> visits(37, 0);
+			pool.ParallelFor(visits.size(), [&](size_t i){ ++visits[i]; });
+			for(auto& v : visits)
+				ASSERT_EQ(v, 1);
+		}
+
+		// Empty loops return immediately.
+		pool.ParallelFor(0, [](size_t){ FAIL(); });
+	}
+}
+
+TEST(ThreadPoolTest, Exceptions)
+{
+	ThreadPool pool(3);
+	std::atomic<int> count(0);
+
+	auto f = [&](size_t i)
+	{
+		++count;
+		if(i == 5)
+			throw std::runtime_error("failed");
+	};
+
+	// All iterations complete before the exception is rethrown.
+	EXPECT_THROW(pool.ParallelFor(20, f), std::runtime_error);
+	EXPECT_EQ(count, 20);
+
+	// The pool remains usable.
+	count = 0;
+	pool.ParallelFor(10, [&](size_t){ ++count; });
+	EXPECT_EQ(count, 10);
+}
+
+int main(int argc, char *argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
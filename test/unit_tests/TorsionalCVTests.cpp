@@ -123,6 +123,24 @@ TEST_F(TorsionalCVTest, DefaultBehavior)
 	EXPECT_NEAR(tortest3->GetValue(), 0, 0.01);
 }
 
+TEST_F(TorsionalCVTest, SparseGradient)
+{
+	tortest2->Initialize(*snapshot1);
+	tortest2->Evaluate(*snapshot1);
+
+	// Only the four dihedral atoms carry a gradient entry.
+	auto& sgrad = tortest2->GetSparseGradient();
+	ASSERT_EQ(sgrad.size(), 4u);
+
+	auto& grad = tortest2->GetGradient();
+	std::vector<Vector3> dense(grad.size(), Vector3{0, 0, 0});
+	for(size_t i = 0; i < sgrad.size(); ++i)
+		dense[sgrad.indices[i]] += sgrad.values[i];
+
+	for(size_t i = 0; i < grad.size(); ++i)
+		EXPECT_TRUE(dense[i].isApprox(grad[i]) || (dense[i].isZero() && grad[i].isZero()));
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);